@@ -0,0 +1,469 @@
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <random>
+#include <sstream>
+#include <streambuf>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "base_file.h"
+#include "commands.h"
+#include "json.h"
+#include "requests.h"
+#include "sphere.h"
+#include "transport_catalog.h"
+
+using namespace std;
+
+struct BenchmarkSettings {
+  size_t stop_count = 1000;
+  size_t bus_count = 100;
+  size_t bus_length = 20;
+  size_t company_count = 1000;
+  size_t rubric_count = 50;
+  size_t request_count = 10000;
+  size_t thread_count = 1;
+  string router_mode = "contraction_hierarchy";  // Floyd–Warshall is too slow for big cities
+  string dump_prefix;                            // the generated inputs go to <prefix>make_base.json and so on
+};
+
+static BenchmarkSettings ParseSettings(int argc, const char* argv[]) {
+  BenchmarkSettings settings;
+  for (auto [idx, field] : {pair{1, &settings.stop_count}, pair{2, &settings.bus_count},
+                            pair{3, &settings.bus_length}, pair{4, &settings.company_count},
+                            pair{5, &settings.rubric_count}, pair{6, &settings.request_count},
+                            pair{7, &settings.thread_count}}) {
+    if (argc > idx) {
+      *field = stoul(argv[idx]);
+    }
+  }
+  if (argc > 8) {
+    settings.router_mode = argv[8];
+  }
+  if (argc > 9) {
+    settings.dump_prefix = argv[9];
+  }
+  return settings;
+}
+
+static string GetStopName(size_t stop) { return "Stop " + to_string(stop); }
+static string GetBusName(size_t bus) { return "Bus " + to_string(bus); }
+static string GetCompanyName(size_t company) { return "Company " + to_string(company); }
+static string GetRubricName(size_t rubric) { return "Rubric " + to_string(rubric); }
+
+// Stops lie on a jittered grid about 500 meters apart, buses walk along the grid
+class CityGenerator {
+ public:
+  CityGenerator(const BenchmarkSettings& settings, mt19937& generator)
+      : settings_(settings),
+        generator_(generator),
+        grid_width_(static_cast<size_t>(ceil(sqrt(static_cast<double>(settings.stop_count))))) {}
+
+  string GenerateMakeBaseInput(const string& base_file_name) {
+    GenerateStops();
+    GenerateBuses();
+
+    string input;
+    Json::Writer writer(input);
+    writer.BeginDict();
+    writer.Key("serialization_settings").BeginDict().Key("file").Value(base_file_name).EndDict();
+    writer.Key("build_settings").BeginDict().Key("thread_count").Value(static_cast<int>(settings_.thread_count));
+    writer.EndDict();
+    writer.Key("routing_settings").BeginDict();
+    writer.Key("bus_wait_time").Value(6).Key("bus_velocity").Value(40).Key("pedestrian_velocity").Value(5);
+    writer.Key("router_mode").Value(settings_.router_mode);
+    writer.EndDict();
+    writer.Key("render_settings").BeginDict().Fields(RENDER_SETTINGS).EndDict();
+    WriteBaseRequests(writer);
+    WriteYellowPages(writer);
+    writer.EndDict();
+    return input;
+  }
+
+  // Requests of all types, skewed to the cheap lookups like real traffic
+  Json::Array GenerateStatRequests() {
+    Json::Array requests;
+    requests.reserve(settings_.request_count);
+    discrete_distribution<int> type_distribution({20, 20, 25, 5, 15, 15});
+    for (size_t request_idx = 0; request_idx < settings_.request_count; ++request_idx) {
+      Json::Dict request = {{"id", Json::Node(static_cast<int>(request_idx))}};
+      switch (type_distribution(generator_)) {
+        case 0:
+          request["type"] = Json::Node("Bus"s);
+          request["name"] = Json::Node(GetBusName(generator_() % settings_.bus_count));
+          break;
+        case 1:
+          request["type"] = Json::Node("Stop"s);
+          request["name"] = Json::Node(GetStopName(GetRandomStop()));
+          break;
+        case 2:
+          request["type"] = Json::Node("Route"s);
+          request["from"] = Json::Node(GetStopName(GetRandomStop()));
+          request["to"] = Json::Node(GetStopName(GetRandomStop()));
+          break;
+        case 3:
+          request["type"] = Json::Node("Map"s);
+          if (generator_() % 2 == 0) {
+            const int zoom = static_cast<int>(generator_() % 4);
+            request["tile"] = Json::Node(Json::Dict{{"zoom", Json::Node(zoom)},
+                                                    {"x", Json::Node(static_cast<int>(generator_() % (1 << zoom)))},
+                                                    {"y", Json::Node(static_cast<int>(generator_() % (1 << zoom)))}});
+          }
+          break;
+        case 4:
+          request["type"] = Json::Node("FindCompanies"s);
+          request.merge(GenerateCompaniesFilter());
+          break;
+        default:
+          request["type"] = Json::Node("RouteToCompany"s);
+          request["from"] = Json::Node(GetStopName(GetRandomStop()));
+          request["companies"] = Json::Node(GenerateCompaniesFilter());
+          request["datetime"] = Json::Node(Json::Array{Json::Node(static_cast<int>(generator_() % 7)),
+                                                       Json::Node(static_cast<int>(generator_() % 24)),
+                                                       Json::Node(static_cast<int>(generator_() % 60))});
+      }
+      requests.emplace_back(move(request));
+    }
+    return requests;
+  }
+
+ private:
+  static constexpr string_view RENDER_SETTINGS =
+      R"("width": 1500, "height": 950, "padding": 50, "outer_margin": 150, "stop_radius": 3, "company_radius": 5, )"
+      R"("line_width": 10, "company_line_width": 2, "bus_label_font_size": 18, "bus_label_offset": [7, 15], )"
+      R"("stop_label_font_size": 13, "stop_label_offset": [7, -3], "underlayer_color": [255, 255, 255, 0.85], )"
+      R"("underlayer_width": 3, "color_palette": ["red", "green", "blue", "brown", "orange"], )"
+      R"("layers": ["bus_lines", "company_lines", "bus_labels", "stop_points", "company_points", "stop_labels", )"
+      R"("company_labels"])";
+
+  size_t GetRandomStop() { return generator_() % settings_.stop_count; }
+
+  vector<size_t> GetGridNeighbours(size_t stop) const {
+    const size_t row = stop / grid_width_;
+    const size_t column = stop % grid_width_;
+    vector<size_t> neighbours;
+    if (column > 0) {
+      neighbours.push_back(stop - 1);
+    }
+    if (column + 1 < grid_width_ && stop + 1 < settings_.stop_count) {
+      neighbours.push_back(stop + 1);
+    }
+    if (row > 0) {
+      neighbours.push_back(stop - grid_width_);
+    }
+    if (stop + grid_width_ < settings_.stop_count) {
+      neighbours.push_back(stop + grid_width_);
+    }
+    return neighbours;
+  }
+
+  void GenerateStops() {
+    uniform_real_distribution<double> jitter(-0.3, 0.3);
+    positions_.reserve(settings_.stop_count);
+    for (size_t stop = 0; stop < settings_.stop_count; ++stop) {
+      positions_.push_back({55.6 + (static_cast<double>(stop / grid_width_) + jitter(generator_)) * 0.0045,
+                            37.4 + (static_cast<double>(stop % grid_width_) + jitter(generator_)) * 0.008});
+    }
+  }
+
+  // Random walks without going straight back, every segment gets a road distance a bit longer than the straight one
+  void GenerateBuses() {
+    uniform_real_distribution<double> detour(1.1, 1.5);
+    for (size_t bus = 0; bus < settings_.bus_count; ++bus) {
+      vector<size_t> stops = {GetRandomStop()};
+      while (stops.size() < settings_.bus_length) {
+        auto neighbours = GetGridNeighbours(stops.back());
+        if (stops.size() > 1 && neighbours.size() > 1) {
+          neighbours.erase(find(begin(neighbours), end(neighbours), stops[stops.size() - 2]));
+        }
+        if (neighbours.empty()) {
+          break;
+        }
+        stops.push_back(neighbours[generator_() % neighbours.size()]);
+      }
+      const bool is_roundtrip = stops.size() > 2 && stops.back() != stops.front() && generator_() % 2 == 0;
+      if (is_roundtrip) {
+        stops.push_back(stops.front());
+      }
+
+      for (size_t idx = 1; idx < stops.size(); ++idx) {
+        const auto segment = minmax(stops[idx - 1], stops[idx]);
+        if (segment.first != segment.second && !distances_.count(segment)) {
+          const double meters = Sphere::Distance(positions_[segment.first], positions_[segment.second]);
+          distances_[segment] = static_cast<int>(meters * detour(generator_)) + 1;
+        }
+      }
+      buses_.push_back({move(stops), is_roundtrip});
+    }
+  }
+
+  void WriteBaseRequests(Json::Writer& writer) const {
+    vector<vector<pair<size_t, int>>> stop_distances(settings_.stop_count);
+    for (const auto& [segment, meters] : distances_) {
+      stop_distances[segment.first].emplace_back(segment.second, meters);  // the other way round is the same
+    }
+
+    writer.Key("base_requests").BeginArray();
+    for (size_t stop = 0; stop < settings_.stop_count; ++stop) {
+      writer.BeginDict();
+      writer.Key("type").Value("Stop").Key("name").Value(GetStopName(stop));
+      writer.Key("latitude").Value(positions_[stop].latitude).Key("longitude").Value(positions_[stop].longitude);
+      writer.Key("road_distances").BeginDict();
+      for (const auto& [neighbour, meters] : stop_distances[stop]) {
+        writer.Key(GetStopName(neighbour)).Value(meters);
+      }
+      writer.EndDict();
+      writer.EndDict();
+    }
+    for (size_t bus = 0; bus < buses_.size(); ++bus) {
+      writer.BeginDict();
+      writer.Key("type").Value("Bus").Key("name").Value(GetBusName(bus));
+      writer.Key("stops").BeginArray();
+      for (const size_t stop : buses_[bus].stops) {
+        writer.Value(GetStopName(stop));
+      }
+      writer.EndArray();
+      writer.Key("is_roundtrip").Value(buses_[bus].is_roundtrip);
+      writer.EndDict();
+    }
+    writer.EndArray();
+  }
+
+  // A few rubrics hold most of the companies
+  size_t GetRandomRubric() {
+    if (!rubric_distribution_) {
+      vector<double> weights;
+      for (size_t rubric = 0; rubric < settings_.rubric_count; ++rubric) {
+        weights.push_back(1.0 / static_cast<double>(rubric + 1));
+      }
+      rubric_distribution_.emplace(begin(weights), end(weights));
+    }
+    return (*rubric_distribution_)(generator_) + 1;
+  }
+
+  void WriteWorkingTime(Json::Writer& writer) {
+    static const vector<string> WEEK_DAYS = {"MONDAY", "TUESDAY", "WEDNESDAY", "THURSDAY", "FRIDAY"};
+    const int opening = 7 * 60 + 30 * static_cast<int>(generator_() % 6);
+    const int closing = 17 * 60 + 30 * static_cast<int>(generator_() % 10);
+    auto write_interval = [&writer](const string& day, int minutes_from, int minutes_to) {
+      writer.BeginDict().Key("day").Value(day).Key("minutes_from").Value(minutes_from);
+      writer.Key("minutes_to").Value(minutes_to).EndDict();
+    };
+
+    writer.Key("working_time").BeginDict().Key("intervals").BeginArray();
+    switch (generator_() % 3) {
+      case 0:
+        break;  // round the clock
+      case 1:
+        write_interval("EVERYDAY", opening, closing);
+        break;
+      default:
+        for (const string& day : WEEK_DAYS) {
+          write_interval(day, opening, 13 * 60);
+          write_interval(day, 14 * 60, closing);
+        }
+    }
+    writer.EndArray().EndDict();
+  }
+
+  void WriteYellowPages(Json::Writer& writer) {
+    uniform_real_distribution<double> offset(-0.002, 0.002);
+    writer.Key("yellow_pages").BeginDict();
+    writer.Key("rubrics").BeginDict();
+    for (size_t rubric = 1; rubric <= settings_.rubric_count; ++rubric) {
+      writer.Key(to_string(rubric)).BeginDict().Key("name").Value(GetRubricName(rubric)).EndDict();
+    }
+    writer.EndDict();
+
+    writer.Key("companies").BeginArray();
+    for (size_t company = 0; company < settings_.company_count; ++company) {
+      const size_t stop = GetRandomStop();
+      const Sphere::Point position = {positions_[stop].latitude + offset(generator_),
+                                      positions_[stop].longitude + offset(generator_)};
+      writer.BeginDict();
+      writer.Key("names").BeginArray().BeginDict().Key("value").Value(GetCompanyName(company)).EndDict().EndArray();
+      if (settings_.rubric_count > 0) {
+        writer.Key("rubrics").BeginArray().Value(static_cast<int>(GetRandomRubric())).EndArray();
+      }
+      writer.Key("address").BeginDict().Key("coords").BeginDict();
+      writer.Key("lat").Value(to_string(position.latitude)).Key("lon").Value(to_string(position.longitude));
+      writer.EndDict().EndDict();
+      writer.Key("urls").BeginArray().BeginDict().Key("value").Value("http://company" + to_string(company) + ".ru");
+      writer.EndDict().EndArray();
+      writer.Key("phones").BeginArray().BeginDict().Key("type").Value("PHONE").Key("country_code").Value("7");
+      writer.Key("local_code").Value("495").Key("number").Value(to_string(1000000 + company)).EndDict().EndArray();
+
+      writer.Key("nearby_stops").BeginArray();
+      auto nearby_stops = GetGridNeighbours(stop);
+      nearby_stops.push_back(stop);
+      for (const size_t nearby_stop : nearby_stops) {
+        const int meters = static_cast<int>(Sphere::Distance(position, positions_[nearby_stop]) * 1.2) + 1;
+        writer.BeginDict().Key("name").Value(GetStopName(nearby_stop)).Key("meters").Value(meters).EndDict();
+      }
+      writer.EndArray();
+      WriteWorkingTime(writer);
+      writer.EndDict();
+    }
+    writer.EndArray();
+    writer.EndDict();
+  }
+
+  Json::Dict GenerateCompaniesFilter() {
+    if (settings_.rubric_count > 0 && generator_() % 2 == 0) {
+      return {{"rubrics", Json::Node(Json::Array{Json::Node(GetRubricName(GetRandomRubric()))})}};
+    }
+    const string name = GetCompanyName(generator_() % max<size_t>(settings_.company_count, 1));
+    if (generator_() % 2 == 0) {
+      return {{"names", Json::Node(Json::Array{Json::Node(name)})}};
+    }
+    return {{"names", Json::Node(Json::Array{Json::Node(name.substr(0, name.size() - 1))})},
+            {"match", Json::Node("prefix"s)}};
+  }
+
+  struct Bus {
+    vector<size_t> stops;
+    bool is_roundtrip;
+  };
+
+  const BenchmarkSettings& settings_;
+  mt19937& generator_;
+  const size_t grid_width_;
+  vector<Sphere::Point> positions_;  // in degrees, as in the input
+  vector<Bus> buses_;
+  map<pair<size_t, size_t>, int> distances_;  // by the stops of segments, the lesser one first
+  optional<discrete_distribution<size_t>> rubric_distribution_;
+};
+
+static size_t GetPeakResidentMemoryKb() {
+  rusage usage = {};
+  getrusage(RUSAGE_SELF, &usage);
+  return static_cast<size_t>(usage.ru_maxrss);  // in kilobytes on Linux
+}
+
+// Discards the responses, so that only producing them is measured
+class NullBuffer : public streambuf {
+ protected:
+  int_type overflow(int_type c) override { return traits_type::not_eof(c); }
+  streamsize xsputn(const char*, streamsize size) override { return size; }
+};
+
+static double ToMilliseconds(chrono::steady_clock::duration duration) {
+  return chrono::duration<double, milli>(duration).count();
+}
+
+static void WriteLatencies(Json::Writer& writer, vector<chrono::steady_clock::duration> durations) {
+  sort(begin(durations), end(durations));
+  auto percentile = [&durations](size_t percent) {
+    return chrono::duration<double, micro>(durations[(durations.size() - 1) * percent / 100]).count();
+  };
+  writer.BeginDict().Key("count").Value(static_cast<int>(durations.size()));
+  writer.Key("p50_us").Value(percentile(50)).Key("p90_us").Value(percentile(90)).Key("p99_us").Value(percentile(99));
+  writer.Key("max_us").Value(percentile(100)).EndDict();
+}
+
+// Prints a JSON report to stdout, the commands log their own stages to stderr
+int main(int argc, const char* argv[]) {
+  using namespace chrono;
+
+  const BenchmarkSettings settings = ParseSettings(argc, argv);
+  if (settings.stop_count == 0 || settings.bus_count == 0 || settings.bus_length == 0) {
+    cerr << "Usage: belts-catalog-benchmark [stop_count] [bus_count] [bus_length] [company_count] [rubric_count]"
+            " [request_count] [thread_count] [router_mode] [dump_prefix]\n";
+    return 5;
+  }
+  const string base_file_name = (filesystem::temp_directory_path() / "belts-catalog-benchmark.base").string();
+
+  const auto generate_start = steady_clock::now();
+  mt19937 generator(42);
+  CityGenerator city_generator(settings, generator);
+  const string make_base_input = city_generator.GenerateMakeBaseInput(base_file_name);
+  const Json::Array stat_requests = city_generator.GenerateStatRequests();
+  const auto generate_duration = steady_clock::now() - generate_start;
+
+  if (!settings.dump_prefix.empty()) {
+    ofstream(settings.dump_prefix + "make_base.json") << make_base_input;
+    ofstream process_requests_output(settings.dump_prefix + "process_requests.json");
+    Json::PrintValue(Json::Dict{{"serialization_settings",
+                                 Json::Node(Json::Dict{{"file", Json::Node(base_file_name)}})},
+                                {"stat_requests", Json::Node(stat_requests)}},
+                     process_requests_output);
+  }
+
+  const auto make_base_start = steady_clock::now();
+  {
+    istringstream input(make_base_input);
+    MakeBase(input);
+  }
+  const auto make_base_duration = steady_clock::now() - make_base_start;
+  const size_t make_base_peak_memory = GetPeakResidentMemoryKb();
+  const size_t base_size = filesystem::file_size(base_file_name);
+
+  const auto load_start = steady_clock::now();
+  const auto db = TransportCatalog::Deserialize(BaseFile::Reader::Open(base_file_name));
+  const auto load_duration = steady_clock::now() - load_start;
+
+  // One by one for latencies, then all together as process_requests does
+  map<string, vector<steady_clock::duration>> durations_by_type;
+  for (const auto& request : stat_requests) {
+    string response;
+    Json::Writer writer(response);
+    const auto start = steady_clock::now();
+    Requests::Process(db, request, writer);
+    durations_by_type[request.AsMap().at("type").AsString()].push_back(steady_clock::now() - start);
+  }
+
+  NullBuffer null_buffer;
+  ostream null_output(&null_buffer);
+  const auto process_start = steady_clock::now();
+  Requests::ProcessAll(db, stat_requests, null_output, settings.thread_count);
+  const auto process_duration = steady_clock::now() - process_start;
+
+  string report;
+  Json::Writer writer(report);
+  writer.BeginDict();
+  writer.Key("settings").BeginDict();
+  writer.Key("stop_count").Value(static_cast<int>(settings.stop_count));
+  writer.Key("bus_count").Value(static_cast<int>(settings.bus_count));
+  writer.Key("bus_length").Value(static_cast<int>(settings.bus_length));
+  writer.Key("company_count").Value(static_cast<int>(settings.company_count));
+  writer.Key("rubric_count").Value(static_cast<int>(settings.rubric_count));
+  writer.Key("request_count").Value(static_cast<int>(settings.request_count));
+  writer.Key("thread_count").Value(static_cast<int>(settings.thread_count));
+  writer.Key("router_mode").Value(settings.router_mode);
+  writer.EndDict();
+
+  writer.Key("stages_ms").BeginDict();
+  writer.Key("generate").Value(ToMilliseconds(generate_duration));
+  writer.Key("make_base").Value(ToMilliseconds(make_base_duration));
+  writer.Key("load_base").Value(ToMilliseconds(load_duration));
+  writer.Key("process_requests").Value(ToMilliseconds(process_duration));
+  writer.EndDict();
+
+  writer.Key("base_size_kb").Value(static_cast<int>(base_size / 1024));
+  writer.Key("peak_rss_kb").BeginDict();
+  writer.Key("make_base").Value(static_cast<int>(make_base_peak_memory));
+  writer.Key("total").Value(static_cast<int>(GetPeakResidentMemoryKb()));
+  writer.EndDict();
+
+  writer.Key("requests").BeginDict();
+  for (auto& [type, durations] : durations_by_type) {
+    writer.Key(type);
+    WriteLatencies(writer, move(durations));
+  }
+  writer.EndDict();
+  writer.EndDict();
+  cout << report << endl;
+
+  filesystem::remove(base_file_name);
+  return 0;
+}
@@ -0,0 +1,148 @@
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "contraction_hierarchy_router.h"
+#include "dijkstra_router.h"
+#include "graph.h"
+#include "precomputed_router.h"
+#include "router.h"
+
+using namespace std;
+
+using BusGraph = Graph::DirectedWeightedGraph<double>;
+using Query = pair<Graph::VertexId, Graph::VertexId>;
+
+// Floyd–Warshall takes hours and gigabytes beyond that
+const size_t MAX_PRECOMPUTED_VERTEX_COUNT = 10000;
+
+struct BenchmarkSettings {
+  size_t stop_count = 1000;
+  size_t bus_count = 100;
+  size_t bus_length = 20;
+  size_t query_count = 1000;
+  size_t thread_count = 1;  // for the precomputed table
+};
+
+static BenchmarkSettings ParseSettings(int argc, const char* argv[]) {
+  BenchmarkSettings settings;
+  for (auto [idx, field] : {pair{1, &settings.stop_count}, pair{2, &settings.bus_count},
+                            pair{3, &settings.bus_length}, pair{4, &settings.query_count},
+                            pair{5, &settings.thread_count}}) {
+    if (argc > idx) {
+      *field = stoul(argv[idx]);
+    }
+  }
+  return settings;
+}
+
+// Same shape as TransportRouter builds: in/out vertices per stop joined by a wait edge,
+// and an edge between every pair of stops of a bus
+static BusGraph GenerateTransportGraph(const BenchmarkSettings& settings, mt19937& generator) {
+  const double bus_wait_time = 6;
+  BusGraph graph(settings.stop_count * 2);
+  for (size_t stop = 0; stop < settings.stop_count; ++stop) {
+    graph.AddEdge({stop * 2 + 1, stop * 2, bus_wait_time});
+  }
+
+  uniform_int_distribution<size_t> stop_distribution(0, settings.stop_count - 1);
+  uniform_int_distribution<size_t> step_distribution(1, 10);
+  uniform_real_distribution<double> ride_time_distribution(1.0, 5.0);
+  for (size_t bus = 0; bus < settings.bus_count; ++bus) {
+    vector<size_t> stops = {stop_distribution(generator)};
+    vector<double> ride_times;
+    while (stops.size() < settings.bus_length) {
+      stops.push_back((stops.back() + step_distribution(generator)) % settings.stop_count);
+      ride_times.push_back(ride_time_distribution(generator));
+    }
+    for (size_t start_idx = 0; start_idx + 1 < stops.size(); ++start_idx) {
+      double total_time = 0;
+      for (size_t finish_idx = start_idx + 1; finish_idx < stops.size(); ++finish_idx) {
+        total_time += ride_times[finish_idx - 1];
+        graph.AddEdge({stops[start_idx] * 2, stops[finish_idx] * 2 + 1, total_time});
+      }
+    }
+  }
+
+  graph.Finalize();
+  return graph;
+}
+
+static size_t GetResidentMemory() {
+  ifstream statm("/proc/self/statm");
+  size_t total_pages = 0;
+  size_t resident_pages = 0;
+  statm >> total_pages >> resident_pages;
+  return resident_pages * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+}
+
+template <typename RouterFactory>
+static void RunBenchmark(const string& name, const BusGraph& graph, const vector<Query>& queries,
+                         RouterFactory make_router) {
+  using namespace chrono;
+
+  const size_t memory_before = GetResidentMemory();
+  const auto build_start = steady_clock::now();
+  const unique_ptr<Graph::Router<double>> router = make_router(graph);
+  const auto build_duration = steady_clock::now() - build_start;
+  const size_t memory_after = GetResidentMemory();
+
+  double checksum = 0;
+  const auto queries_start = steady_clock::now();
+  for (const auto& [from, to] : queries) {
+    if (const auto route = router->BuildRoute(from, to)) {
+      checksum += route->weight;
+      router->ReleaseRoute(route->id);
+    }
+  }
+  const auto queries_duration = steady_clock::now() - queries_start;
+
+  cout << name << ": build " << duration_cast<milliseconds>(build_duration).count() << " ms"
+       << ", memory " << (max(memory_after, memory_before) - memory_before) / 1024 << " KB"
+       << ", query " << duration_cast<nanoseconds>(queries_duration).count() / 1000.0 / max<size_t>(queries.size(), 1)
+       << " us"
+       << " (checksum " << checksum << ")" << endl;
+}
+
+int main(int argc, const char* argv[]) {
+  const BenchmarkSettings settings = ParseSettings(argc, argv);
+  if (settings.stop_count == 0 || settings.bus_length == 0) {
+    cerr << "Usage: belts-router-benchmark [stop_count] [bus_count] [bus_length] [query_count] [thread_count]\n";
+    return 5;
+  }
+
+  mt19937 generator(42);
+  const BusGraph graph = GenerateTransportGraph(settings, generator);
+  cout << "graph: " << graph.GetVertexCount() << " vertices, " << graph.GetEdgeCount() << " edges" << endl;
+
+  uniform_int_distribution<size_t> stop_distribution(0, settings.stop_count - 1);
+  vector<Query> queries(settings.query_count);
+  for (auto& [from, to] : queries) {
+    from = stop_distribution(generator) * 2 + 1;
+    to = stop_distribution(generator) * 2 + 1;
+  }
+
+  // Precomputed goes last: small footprints must not hide behind memory freed by the table
+  RunBenchmark("on_demand", graph, queries,
+               [](const BusGraph& graph) { return make_unique<Graph::DijkstraRouter<double>>(graph); });
+  RunBenchmark("contraction_hierarchy", graph, queries,
+               [](const BusGraph& graph) { return make_unique<Graph::ContractionHierarchyRouter<double>>(graph); });
+  if (graph.GetVertexCount() <= MAX_PRECOMPUTED_VERTEX_COUNT) {
+    RunBenchmark("precomputed", graph, queries,
+                 [&settings](const BusGraph& graph) {
+                   return make_unique<Graph::PrecomputedRouter<double>>(graph, settings.thread_count);
+                 });
+  } else {
+    cout << "precomputed: skipped, too many vertices" << endl;
+  }
+
+  return 0;
+}
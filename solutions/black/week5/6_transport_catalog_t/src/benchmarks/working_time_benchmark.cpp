@@ -0,0 +1,107 @@
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "datetime.h"
+
+using namespace std;
+
+struct BenchmarkSettings {
+  size_t company_count = 10000;
+  size_t query_count = 10000000;
+};
+
+static BenchmarkSettings ParseSettings(int argc, const char* argv[]) {
+  BenchmarkSettings settings;
+  for (auto [idx, field] : {pair{1, &settings.company_count}, pair{2, &settings.query_count}}) {
+    if (argc > idx) {
+      *field = stoul(argv[idx]);
+    }
+  }
+  return settings;
+}
+
+using Day = YellowPages::WorkingTimeInterval::Day;
+
+static void AddInterval(YellowPages::WorkingTime& working_time, Day day, int minutes_from, int minutes_to) {
+  auto& interval = *working_time.add_intervals();
+  interval.set_day(day);
+  interval.set_minutes_from(minutes_from);
+  interval.set_minutes_to(minutes_to);
+}
+
+// Schedules typical for yellow pages: round the clock, shops, offices with a lunch break, night bars
+static YellowPages::WorkingTime GenerateWorkingTime(mt19937& generator) {
+  YellowPages::WorkingTime working_time;
+  const int opening = 7 * 60 + 30 * static_cast<int>(generator() % 6);
+  const int closing = 17 * 60 + 30 * static_cast<int>(generator() % 10);
+  switch (generator() % 4) {
+    case 0:
+      AddInterval(working_time, Day::WorkingTimeInterval_Day_EVERYDAY, 0, 1440);
+      break;
+    case 1:
+      AddInterval(working_time, Day::WorkingTimeInterval_Day_EVERYDAY, opening, closing);
+      break;
+    case 2:
+      for (int day = Day::WorkingTimeInterval_Day_MONDAY; day <= Day::WorkingTimeInterval_Day_FRIDAY; ++day) {
+        AddInterval(working_time, static_cast<Day>(day), opening, 13 * 60);
+        AddInterval(working_time, static_cast<Day>(day), 14 * 60, closing);
+      }
+      AddInterval(working_time, Day::WorkingTimeInterval_Day_SATURDAY, opening, 15 * 60);
+      break;
+    default:
+      for (int day = Day::WorkingTimeInterval_Day_MONDAY; day <= Day::WorkingTimeInterval_Day_SUNDAY; ++day) {
+        AddInterval(working_time, static_cast<Day>(day), 0, 2 * 60);
+        AddInterval(working_time, static_cast<Day>(day), 18 * 60, 1440);
+      }
+  }
+  return working_time;
+}
+
+int main(int argc, const char* argv[]) {
+  using namespace chrono;
+
+  const BenchmarkSettings settings = ParseSettings(argc, argv);
+  if (settings.company_count == 0) {
+    cerr << "Usage: belts-working-time-benchmark [company_count] [query_count]\n";
+    return 5;
+  }
+
+  mt19937 generator(42);
+  vector<YellowPages::WorkingTime> working_times;
+  for (size_t company_idx = 0; company_idx < settings.company_count; ++company_idx) {
+    working_times.push_back(GenerateWorkingTime(generator));
+  }
+
+  const auto compile_start = steady_clock::now();
+  vector<WeeklySchedule> schedules(begin(working_times), end(working_times));
+  const auto compile_duration = steady_clock::now() - compile_start;
+  cout << "compile: " << duration_cast<microseconds>(compile_duration).count() << " us for "
+       << settings.company_count << " companies" << endl;
+
+  vector<pair<size_t, DateTime>> queries(settings.query_count);
+  uniform_int_distribution<size_t> company_distribution(0, settings.company_count - 1);
+  uniform_int_distribution<int> minute_distribution(0, WeeklySchedule::MINUTES_PER_WEEK - 1);
+  for (auto& [company_idx, dt] : queries) {
+    const int minute = minute_distribution(generator);
+    company_idx = company_distribution(generator);
+    dt = {minute / WeeklySchedule::MINUTES_PER_DAY, minute % WeeklySchedule::MINUTES_PER_DAY / 60, minute % 60};
+  }
+
+  const auto run = [&queries](const string& name, auto get_wait_time) {
+    long long checksum = 0;
+    const auto start = steady_clock::now();
+    for (const auto& [company_idx, dt] : queries) {
+      checksum += get_wait_time(company_idx, dt);
+    }
+    const auto duration = steady_clock::now() - start;
+    cout << name << ": " << duration_cast<nanoseconds>(duration).count() / max<double>(queries.size(), 1) << " ns"
+         << " (checksum " << checksum << ")" << endl;
+  };
+  run("scan", [&](size_t company_idx, DateTime dt) { return CalculateWaitTime(dt, working_times[company_idx]); });
+  run("weekly_schedule", [&](size_t company_idx, DateTime dt) { return schedules[company_idx].GetWaitTime(dt); });
+
+  return 0;
+}
@@ -0,0 +1,65 @@
+#include "base_file.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+
+using namespace std;
+
+namespace BaseFile {
+  string Writer::Finish(const google::protobuf::MessageLite& message) {
+    const Footer footer = {
+        .message_offset = data_.size(),
+        .message_size = message.ByteSizeLong(),
+        .magic = MAGIC,
+    };
+    message.AppendToString(&data_);
+    data_.append(reinterpret_cast<const char*>(&footer), sizeof(footer));
+    return move(data_);
+  }
+
+  shared_ptr<const Reader> Reader::Open(const string& file_name) {
+    const int fd = open(file_name.c_str(), O_RDONLY);
+    if (fd < 0) {
+      throw system_error(errno, generic_category(), "can't open " + file_name);
+    }
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) < 0) {
+      const int error = errno;
+      close(fd);
+      throw system_error(error, generic_category(), "can't stat " + file_name);
+    }
+    const size_t size = file_stat.st_size;
+    if (size < sizeof(Footer)) {
+      close(fd);
+      throw runtime_error("not a transport catalog base: " + file_name);
+    }
+    void* data = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    const int error = errno;
+    close(fd);  // the mapping stays valid
+    if (data == MAP_FAILED) {
+      throw system_error(error, generic_category(), "can't map " + file_name);
+    }
+    return shared_ptr<const Reader>(new Reader(data, size));  // ctor is private
+  }
+
+  Reader::Reader(const void* data, size_t size) : data_(static_cast<const char*>(data), size) {
+    Footer footer;
+    memcpy(&footer, data_.data() + data_.size() - sizeof(footer), sizeof(footer));
+    if (footer.magic != MAGIC || footer.message_offset + footer.message_size + sizeof(footer) != data_.size()) {
+      munmap(const_cast<char*>(data_.data()), data_.size());
+      throw runtime_error("not a transport catalog base");
+    }
+    message_data_ = data_.substr(footer.message_offset, footer.message_size);
+  }
+
+  Reader::~Reader() {
+    munmap(const_cast<char*>(data_.data()), data_.size());
+  }
+}  // namespace BaseFile
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#include <google/protobuf/message_lite.h>
+
+// Base file layout: flat arrays | protobuf message | footer.
+// Arrays are referenced from the message by offsets and are used right from the mapped file,
+// so their size does not affect startup, and processes reading one base share the page cache.
+namespace BaseFile {
+  struct Footer {
+    uint64_t message_offset;
+    uint64_t message_size;
+    uint64_t magic;
+  };
+
+  inline constexpr uint64_t MAGIC = 0x3130455341424354;  // "TCBASE01" in little-endian
+  inline constexpr size_t ARRAY_ALIGNMENT = alignof(std::max_align_t);
+
+  class Writer {
+   public:
+    // Returns the offset to store in the message
+    template <typename T>
+    uint64_t AppendArray(std::span<const T> items);
+
+    // Appends the message and the footer, the writer is left empty
+    std::string Finish(const google::protobuf::MessageLite& message);
+
+   private:
+    std::string data_;
+  };
+
+  // Read-only mapping of a whole base file
+  class Reader {
+   public:
+    static std::shared_ptr<const Reader> Open(const std::string& file_name);
+
+    Reader(const Reader&) = delete;
+    Reader& operator=(const Reader&) = delete;
+    ~Reader();
+
+    std::string_view GetMessageData() const { return message_data_; }
+
+    // Throws std::runtime_error if the array is misaligned or out of the file, as in a corrupt base
+    template <typename T>
+    std::span<const T> GetArray(uint64_t offset, size_t size) const;
+
+   private:
+    Reader(const void* data, size_t size);
+
+    std::string_view data_;
+    std::string_view message_data_;
+  };
+
+  template <typename T>
+  uint64_t Writer::AppendArray(std::span<const T> items) {
+    static_assert(alignof(T) <= ARRAY_ALIGNMENT);
+    data_.resize((data_.size() + ARRAY_ALIGNMENT - 1) / ARRAY_ALIGNMENT * ARRAY_ALIGNMENT);
+    const uint64_t offset = data_.size();
+    data_.append(reinterpret_cast<const char*>(items.data()), items.size_bytes());
+    return offset;
+  }
+
+  template <typename T>
+  std::span<const T> Reader::GetArray(uint64_t offset, size_t size) const {
+    if (offset % alignof(T) != 0 || offset > data_.size() || size > (data_.size() - offset) / sizeof(T)) {
+      throw std::runtime_error("corrupt base: bad array at offset " + std::to_string(offset));
+    }
+    return {reinterpret_cast<const T*>(data_.data() + offset), size};
+  }
+}  // namespace BaseFile
@@ -1,42 +1,321 @@
 #include "commands.h"
 
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
 #include <fstream>
+#include <memory>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <streambuf>
+#include <system_error>
+#include <thread>
+#include <vector>
 
+#include "base_file.h"
+#include "metrics.h"
+#include "profile.h"
 #include "requests.h"
+#include "response_cache.h"
 #include "transport_catalog.h"
+#include "utils.h"
 
 using namespace std;
 
-string ReadFileData(const string& file_name) {
-  ifstream file(file_name, ios::binary | ios::ate);
-  const ifstream::pos_type end_pos = file.tellg();
-  file.seekg(0, ios::beg);
+// Reads settings_key.thread_count, all the cores by default
+static size_t ReadThreadCount(const Json::Dict& input_map, const string& settings_key) {
+  if (input_map.count(settings_key) && input_map.at(settings_key).AsMap().count("thread_count")) {
+    return input_map.at(settings_key).AsMap().at("thread_count").AsInt();
+  }
+  return max(thread::hardware_concurrency(), 1u);
+}
+
+// Reads settings_key.response_cache_size in bytes, 0 turns the cache off
+static unique_ptr<ResponseCache> MakeResponseCache(const Json::Dict& input_map, const string& settings_key,
+                                                   size_t default_size) {
+  size_t max_size = default_size;
+  if (input_map.count(settings_key) && input_map.at(settings_key).AsMap().count("response_cache_size")) {
+    const int size = input_map.at(settings_key).AsMap().at("response_cache_size").AsInt();
+    if (size < 0) {
+      throw invalid_argument("negative " + settings_key + ".response_cache_size: " + to_string(size));
+    }
+    max_size = size;
+  }
+  return max_size > 0 ? make_unique<ResponseCache>(max_size) : nullptr;
+}
 
-  string data(end_pos, '\0');
-  file.read(&data[0], end_pos);
-  return data;
+// Writes the metrics to processing_settings.metrics_file, or to stderr without it
+static void ReportMetrics(const Json::Dict& input_map) {
+  if (input_map.count("processing_settings") && input_map.at("processing_settings").AsMap().count("metrics_file")) {
+    ofstream file(input_map.at("processing_settings").AsMap().at("metrics_file").AsString());
+    Metrics::Report(file);
+  } else {
+    Metrics::Report(cerr);
+  }
 }
 
 void ProcessRequests(istream& in, ostream& out) {
-  const auto input_doc = Json::Load(in);
-  const auto& input_map = input_doc.GetRoot().AsMap();
+  optional<Json::Document> input_doc;
+  {
+    METRICS_SPAN("process_requests: parsing");
+    input_doc.emplace(Json::Load(in));
+  }
+  const auto& input_map = input_doc->GetRoot().AsMap();
 
   const string& file_name = input_map.at("serialization_settings").AsMap().at("file").AsString();
-  const auto db = TransportCatalog::Deserialize(ReadFileData(file_name));
+  optional<TransportCatalog> db;
+  {
+    METRICS_SPAN("process_requests: base loading");
+    db.emplace(TransportCatalog::Deserialize(BaseFile::Reader::Open(file_name)));
+  }
 
-  Json::PrintValue(Requests::ProcessAll(db, input_map.at("stat_requests").AsArray()), out);
-  out << endl;
+  // A batch rarely repeats a request, so it gets a cache only when asked for one
+  const auto cache = MakeResponseCache(input_map, "processing_settings", 0);
+  {
+    METRICS_SPAN("process_requests: responses");
+    Requests::ProcessAll(*db, input_map.at("stat_requests").AsArray(), out,
+                         ReadThreadCount(input_map, "processing_settings"), cache.get());
+    out << endl;
+  }
+
+  if constexpr (Metrics::ENABLED) {
+    ReportMetrics(input_map);
+  }
 }
 
 void MakeBase(istream& in) {
-  const auto input_doc = Json::Load(in);
-  const auto& input_map = input_doc.GetRoot().AsMap();
+  Descriptions::BaseInput input;
+  {
+    LOG_DURATION("make_base: parsing");
+    const string input_data = Json::ReadAll(in);
+    Json::Parser parser(input_data);
+    input = Descriptions::ReadBaseInput(parser);
+  }
+  const auto& input_map = input.settings;
+
+  const size_t thread_count = ReadThreadCount(input_map, "build_settings");
 
-  const TransportCatalog db(Descriptions::ReadDescriptions(input_map.at("base_requests").AsArray()),
-                            Descriptions::ReadYellowPages(input_map.at("yellow_pages").AsMap()),
-                            input_map.at("routing_settings").AsMap(), input_map.at("render_settings").AsMap());
+  optional<TransportCatalog> db;
+  {
+    LOG_DURATION("make_base: build");
+    db.emplace(move(input.descriptions), move(input.yellow_pages), input_map.at("routing_settings").AsMap(),
+               input_map.at("render_settings").AsMap(), thread_count);
+  }
 
+  LOG_DURATION("make_base: serialization");
   const string& file_name = input_map.at("serialization_settings").AsMap().at("file").AsString();
-  ofstream file(file_name);
-  file << db.Serialize();
-}
\ No newline at end of file
+  ofstream file(file_name, ios::binary);
+  file << db->Serialize();
+}
+void UpdateBase(istream& in) {
+  Descriptions::BaseInput changes;
+  {
+    LOG_DURATION("update_base: parsing");
+    const string input_data = Json::ReadAll(in);
+    Json::Parser parser(input_data);
+    changes = Descriptions::ReadBaseChanges(parser);
+  }
+  const size_t thread_count = ReadThreadCount(changes.settings, "build_settings");
+  const string file_name = changes.settings.at("serialization_settings").AsMap().at("file").AsString();
+
+  string data;
+  {
+    optional<TransportCatalog> db;
+    {
+      LOG_DURATION("update_base: build");
+      db.emplace(TransportCatalog::Update(BaseFile::Reader::Open(file_name), move(changes), thread_count));
+    }
+    LOG_DURATION("update_base: serialization");
+    data = db->Serialize();
+  }  // the old base is unmapped before it is replaced
+
+  // Readers map the base, so it is written aside and renamed over the old one, which they keep
+  const string temp_file_name = file_name + ".tmp";
+  {
+    ofstream file(temp_file_name, ios::binary | ios::trunc);
+    file << data;
+    file.flush();
+    if (!file) {
+      throw runtime_error("can't write " + temp_file_name);
+    }
+  }
+  if (rename(temp_file_name.c_str(), file_name.c_str()) != 0) {
+    throw system_error(errno, generic_category(), "can't replace " + file_name);
+  }
+}
+
+namespace {
+  // Per-request processing times, reported as percentiles
+  class LatencyStats {
+   public:
+    void Add(chrono::steady_clock::duration duration) { durations_.push_back(duration); }
+
+    void Report(const string& name, ostream& output) {
+      if (durations_.empty()) {
+        return;
+      }
+      auto percentile = [this](size_t percent) {
+        auto it = durations_.begin() + (durations_.size() - 1) * percent / 100;
+        nth_element(durations_.begin(), it, durations_.end());
+        return chrono::duration_cast<chrono::microseconds>(*it).count();
+      };
+      ostringstream report;
+      report << name << ": " << durations_.size() << " requests, p50 " << percentile(50) << " us, p99 "
+             << percentile(99) << " us, max " << percentile(100) << " us" << endl;
+      output << report.str();
+    }
+
+   private:
+    vector<chrono::steady_clock::duration> durations_;
+  };
+
+  void ReportCacheStats(const ResponseCache* cache, ostream& output) {
+    if (!cache) {
+      return;
+    }
+    const auto stats = cache->GetStats();
+    ostringstream report;
+    report << "response cache: " << stats.hits << " hits, " << stats.misses << " misses, " << stats.entry_count
+           << " entries of " << stats.size << " bytes" << endl;
+    output << report.str();
+  }
+
+  // Answers every non-empty line of `in` with a line of `out`
+  void ServeStream(const TransportCatalog& db, ResponseCache* cache, istream& in, ostream& out, const string& name) {
+    LatencyStats stats;
+    for (string line; getline(in, line);) {
+      if (Strip(line).empty()) {
+        continue;
+      }
+      const auto start = chrono::steady_clock::now();
+      string response;
+      try {
+        istringstream request_input(line);
+        Json::Writer writer(response);
+        Requests::Process(db, Json::Load(request_input).GetRoot(), writer, cache);
+      } catch (const exception& e) {
+        response.clear();
+        Json::Writer(response).BeginDict().Key("error_message").Value(e.what()).EndDict();
+      }
+      out << response << endl;
+      if (!out) {
+        break;  // the client is gone
+      }
+      stats.Add(chrono::steady_clock::now() - start);
+    }
+    stats.Report(name, cerr);
+    ReportCacheStats(cache, cerr);
+  }
+
+  // Minimal stream buffer over a connected socket, enough for line-by-line exchange
+  class SocketBuffer : public streambuf {
+   public:
+    explicit SocketBuffer(int fd) : fd_(fd) { setg(input_.data(), input_.data(), input_.data()); }
+
+   protected:
+    int_type underflow() override {
+      const ssize_t size = read(fd_, input_.data(), input_.size());
+      if (size <= 0) {
+        return traits_type::eof();
+      }
+      setg(input_.data(), input_.data(), input_.data() + size);
+      return traits_type::to_int_type(input_.front());
+    }
+
+    // A client gone before its response is written fails the write, without SIGPIPE killing the server
+    streamsize xsputn(const char* data, streamsize size) override {
+      for (streamsize written = 0; written < size;) {
+        const ssize_t chunk = send(fd_, data + written, size - written, MSG_NOSIGNAL);
+        if (chunk <= 0) {
+          return written;
+        }
+        written += chunk;
+      }
+      return size;
+    }
+
+    int_type overflow(int_type c) override {
+      if (traits_type::eq_int_type(c, traits_type::eof())) {
+        return traits_type::not_eof(c);
+      }
+      const char ch = traits_type::to_char_type(c);
+      return xsputn(&ch, 1) == 1 ? c : traits_type::eof();
+    }
+
+   private:
+    int fd_;
+    array<char, 1 << 16> input_;
+  };
+
+  // Connection threads share the catalog and the cache, so they outlive this function if it throws
+  [[noreturn]] void ServeSocket(shared_ptr<const TransportCatalog> db, shared_ptr<ResponseCache> cache,
+                                const string& socket_path) {
+    const int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd < 0) {
+      throw system_error(errno, generic_category(), "can't create socket");
+    }
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (socket_path.size() >= sizeof(address.sun_path)) {
+      throw invalid_argument("socket path is too long: " + socket_path);
+    }
+    copy(socket_path.begin(), socket_path.end(), address.sun_path);
+    unlink(socket_path.c_str());
+    if (bind(listen_fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) < 0 ||
+        listen(listen_fd, SOMAXCONN) < 0) {
+      throw system_error(errno, generic_category(), "can't listen on " + socket_path);
+    }
+
+    for (size_t connection_idx = 0;; ++connection_idx) {
+      const int fd = accept(listen_fd, nullptr, nullptr);
+      if (fd < 0) {
+        const int error = errno;
+        if (error == EINTR || error == ECONNABORTED) {
+          continue;
+        }
+        if (error == EMFILE || error == ENFILE || error == ENOBUFS || error == ENOMEM) {
+          // Out of descriptors or memory until some connections close, so wait instead of spinning
+          cerr << "accept failed: " << generic_category().message(error) << ", retrying" << endl;
+          this_thread::sleep_for(100ms);
+          continue;
+        }
+        throw system_error(error, generic_category(), "can't accept on " + socket_path);
+      }
+      thread([db, cache, fd, connection_idx] {
+        SocketBuffer buffer(fd);
+        istream in(&buffer);
+        ostream out(&buffer);
+        ServeStream(*db, cache.get(), in, out, "connection " + to_string(connection_idx));
+        close(fd);
+      }).detach();
+    }
+  }
+}  // namespace
+
+void ServeRequests(istream& in, ostream& out) {
+  string settings_line;
+  getline(in, settings_line);
+  istringstream settings_input(settings_line);
+  const auto settings_doc = Json::Load(settings_input);
+  const auto& settings_map = settings_doc.GetRoot().AsMap();
+
+  const string& file_name = settings_map.at("serialization_settings").AsMap().at("file").AsString();
+  shared_ptr<const TransportCatalog> db;
+  {
+    LOG_DURATION("serve: base loading");
+    db = make_shared<const TransportCatalog>(TransportCatalog::Deserialize(BaseFile::Reader::Open(file_name)));
+  }
+
+  const shared_ptr<ResponseCache> cache = MakeResponseCache(settings_map, "serving_settings", 64 << 20);
+  if (settings_map.count("serving_settings") && settings_map.at("serving_settings").AsMap().count("socket")) {
+    ServeSocket(db, cache, settings_map.at("serving_settings").AsMap().at("socket").AsString());
+  }
+  ServeStream(*db, cache.get(), in, out, "stdin");
+}
@@ -1,4 +1,22 @@
 #include <iostream>
 
+// processing_settings.response_cache_size turns on a response cache of that many bytes, off by default.
+// Built with BELTS_METRICS, also reports hot path timings to processing_settings.metrics_file or to stderr.
 void ProcessRequests(std::istream &in, std::ostream &out);
-void MakeBase(std::istream &in);
\ No newline at end of file
+void MakeBase(std::istream &in);
+// Applies changes to the base named in serialization_settings.file, in place.
+// base_requests and yellow_pages.companies replace the stops, buses and companies with the same names or are added,
+// yellow_pages.rubrics replace the rubrics with the same ids, and removed_stops, removed_buses and removed_companies
+// list the names to remove. Companies go by their main names. routing_settings and render_settings,
+// if given, replace the stored ones. Changes that leave references to removed stops fail with
+// std::invalid_argument, and the base stays as it was. Parts the changes don't affect are taken from the base
+// or repaired rather than built anew, see TransportCatalog::Update.
+// The new base replaces the file atomically, so running readers keep the old one.
+void UpdateBase(std::istream &in);
+
+// Loads the base once and answers newline-delimited requests as they come.
+// The first line holds the settings: serialization_settings and optional serving_settings.socket
+// and serving_settings.response_cache_size (64 MiB by default, 0 turns the cache off).
+// With a socket, every connection is served in its own thread until its client goes away,
+// otherwise the rest of `in` is read.
+void ServeRequests(std::istream &in, std::ostream &out);
\ No newline at end of file
@@ -0,0 +1,598 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <queue>
+#include <span>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "graph.h"
+#include "graph.pb.h"
+#include "router.h"
+
+namespace Graph {
+
+  // Contraction hierarchies: vertices are contracted one by one in the order of importance,
+  // shortcuts keep distances between remaining vertices. A query is a bidirectional search
+  // that only goes up the hierarchy, so it explores a tiny part of the graph.
+  // The hierarchy is stored in the base file as flat arrays and used in place, like the graph.
+  template <typename Weight>
+  class ContractionHierarchyRouter : public Router<Weight> {
+   private:
+    using Base = Router<Weight>;
+    using typename Base::Graph;
+
+   public:
+    using typename Base::RouteInfo;
+    using typename Base::TargetCost;
+    using typename Base::TargetRouteInfo;
+
+    explicit ContractionHierarchyRouter(const Graph& graph);
+
+    void Serialize(GraphProto::Router& proto, BaseFile::Writer& base_file) const override;
+    // The arrays are used in place, so the base file must outlive the router
+    static std::unique_ptr<ContractionHierarchyRouter> Deserialize(const GraphProto::Router& proto,
+                                                                   const Graph& graph,
+                                                                   const BaseFile::Reader& base_file);
+
+    std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const override;
+    std::optional<Weight> GetWeight(VertexId from, VertexId to) const override;
+    // One upward search from `from` is shared by all the targets, each target adds only its own upward search
+    std::optional<TargetRouteInfo> BuildRouteToBestTarget(VertexId from, const std::vector<VertexId>& targets,
+                                                          const TargetCost& target_cost) const override;
+
+    size_t GetShortcutCount() const { return shortcuts_.size(); }
+
+   private:
+    ContractionHierarchyRouter(const Graph& graph, const GraphProto::ContractionHierarchy& proto,
+                               const BaseFile::Reader& base_file);
+
+    using StoredId = uint32_t;  // as in the graph
+
+    // Hierarchy edges are the graph edges followed by shortcuts, so graph edge ids stay valid.
+    // Stored in the base file as is, so the fields go without padding.
+    struct Shortcut {
+      StoredId from;
+      StoredId to;
+      StoredId lhs;  // hierarchy edges the shortcut goes through
+      StoredId rhs;
+      Weight weight;
+    };
+
+    VertexId GetEdgeFrom(EdgeId edge_id) const;
+    VertexId GetEdgeTo(EdgeId edge_id) const;
+    Weight GetEdgeWeight(EdgeId edge_id) const;
+    void UnpackEdge(EdgeId edge_id, std::vector<EdgeId>& edges) const;
+
+    class Contractor;
+
+    struct RouteInternalData {
+      Weight weight;
+      std::optional<EdgeId> prev_edge;
+    };
+    using SearchSpace = std::unordered_map<VertexId, RouteInternalData>;
+
+    struct SearchResult {
+      Weight weight;
+      VertexId middle;
+      SearchSpace forward;
+      SearchSpace backward;
+    };
+
+    using QueueItem = std::pair<Weight, VertexId>;
+    using Queue = std::priority_queue<QueueItem, std::vector<QueueItem>, std::greater<QueueItem>>;
+
+    // Relaxes the edges of a vertex just taken from the queue going up the hierarchy,
+    // unless a higher vertex reaches it cheaper
+    void SettleVertex(VertexId vertex, Weight weight, bool is_forward, SearchSpace& space, Queue& queue) const;
+    // Whole upward search space, in the direction of edges or against it
+    SearchSpace SearchUpward(VertexId origin, bool is_forward) const;
+    std::optional<SearchResult> FindShortestPath(VertexId from, VertexId to) const;
+
+    // Filled when built, empty when the arrays are read from a base file.
+    // Vectors keep their buffers when moved, so the spans stay valid.
+    std::vector<Shortcut> built_shortcuts_;
+    std::vector<StoredId> built_upward_offsets_;
+    std::vector<StoredId> built_upward_edges_;
+    std::vector<StoredId> built_downward_offsets_;
+    std::vector<StoredId> built_downward_edges_;
+
+    std::span<const Shortcut> shortcuts_;
+    // Edges to higher ranked vertices grouped by source, used by forward search
+    std::span<const StoredId> upward_offsets_;
+    std::span<const StoredId> upward_edges_;
+    // Edges from higher ranked vertices grouped by target, used by backward search
+    std::span<const StoredId> downward_offsets_;
+    std::span<const StoredId> downward_edges_;
+  };
+
+  // Preprocessing state, dropped as soon as the hierarchy is built
+  template <typename Weight>
+  class ContractionHierarchyRouter<Weight>::Contractor {
+   public:
+    explicit Contractor(ContractionHierarchyRouter& router)
+        : router_(router),
+          graph_(router.graph_),
+          out_edges_(graph_.GetVertexCount()),
+          in_edges_(graph_.GetVertexCount()),
+          contracted_(graph_.GetVertexCount(), false),
+          deleted_neighbours_(graph_.GetVertexCount(), 0),
+          depths_(graph_.GetVertexCount(), 0),
+          ranks_(graph_.GetVertexCount(), 0),
+          witness_weights_(graph_.GetVertexCount()) {
+      for (EdgeId edge_id = 0; edge_id < graph_.GetEdgeCount(); ++edge_id) {
+        const auto& edge = graph_.GetEdge(edge_id);
+        assert(edge.weight >= 0);
+        if (edge.from != edge.to) {
+          out_edges_[edge.from].push_back(edge_id);
+          in_edges_[edge.to].push_back(edge_id);
+        }
+      }
+    }
+
+    std::vector<size_t> ContractAll() {
+      using QueueItem = std::pair<int, VertexId>;
+      std::priority_queue<QueueItem, std::vector<QueueItem>, std::greater<QueueItem>> queue;
+      for (VertexId vertex = 0; vertex < graph_.GetVertexCount(); ++vertex) {
+        queue.push({ComputePriority(vertex, FindShortcuts(vertex)), vertex});
+      }
+
+      size_t next_rank = 0;
+      while (!queue.empty()) {
+        const VertexId vertex = queue.top().second;
+        queue.pop();
+        // Lazy update: priorities of the remaining vertices change as their neighbours get contracted
+        auto shortcuts = FindShortcuts(vertex);
+        const int priority = ComputePriority(vertex, shortcuts);
+        if (!queue.empty() && priority > queue.top().first) {
+          queue.push({priority, vertex});
+          continue;
+        }
+        Contract(vertex, std::move(shortcuts));
+        ranks_[vertex] = next_rank++;
+      }
+
+      return std::move(ranks_);
+    }
+
+   private:
+    // Witness search gives up after that many settled vertices and adds a possibly redundant shortcut
+    static constexpr size_t WITNESS_SEARCH_SETTLED_LIMIT = 500;
+
+    struct Neighbour {
+      VertexId vertex;
+      Weight weight;
+      EdgeId edge_id;
+    };
+
+    // Keeps the lightest of parallel edges to every uncontracted neighbour
+    template <typename GetNeighbour>
+    std::vector<Neighbour> CollectNeighbours(const std::vector<EdgeId>& edges, GetNeighbour get_neighbour) const {
+      std::vector<Neighbour> neighbours;
+      for (const EdgeId edge_id : edges) {
+        const VertexId neighbour = get_neighbour(edge_id);
+        if (!contracted_[neighbour]) {
+          neighbours.push_back({neighbour, router_.GetEdgeWeight(edge_id), edge_id});
+        }
+      }
+      std::sort(begin(neighbours), end(neighbours), [](const Neighbour& lhs, const Neighbour& rhs) {
+        return std::pair(lhs.vertex, lhs.weight) < std::pair(rhs.vertex, rhs.weight);
+      });
+      neighbours.erase(std::unique(begin(neighbours), end(neighbours),
+                                   [](const Neighbour& lhs, const Neighbour& rhs) { return lhs.vertex == rhs.vertex; }),
+                       end(neighbours));
+      return neighbours;
+    }
+
+    std::vector<Neighbour> CollectInNeighbours(VertexId vertex) const {
+      return CollectNeighbours(in_edges_[vertex], [this](EdgeId edge_id) { return router_.GetEdgeFrom(edge_id); });
+    }
+
+    std::vector<Neighbour> CollectOutNeighbours(VertexId vertex) const {
+      return CollectNeighbours(out_edges_[vertex], [this](EdgeId edge_id) { return router_.GetEdgeTo(edge_id); });
+    }
+
+    // Limited Dijkstra from `from` over uncontracted vertices except `skipped`
+    void RunWitnessSearch(VertexId from, VertexId skipped, Weight max_weight) {
+      for (const VertexId vertex : touched_vertices_) {
+        witness_weights_[vertex].reset();
+      }
+      touched_vertices_.clear();
+
+      using QueueItem = std::pair<Weight, VertexId>;
+      std::priority_queue<QueueItem, std::vector<QueueItem>, std::greater<QueueItem>> queue;
+      witness_weights_[from] = 0;
+      touched_vertices_.push_back(from);
+      queue.push({0, from});
+
+      size_t settled_count = 0;
+      while (!queue.empty() && settled_count < WITNESS_SEARCH_SETTLED_LIMIT) {
+        const auto [weight, vertex] = queue.top();
+        queue.pop();
+        if (*witness_weights_[vertex] < weight) {
+          continue;
+        }
+        if (weight > max_weight) {
+          break;
+        }
+        ++settled_count;
+        for (const EdgeId edge_id : out_edges_[vertex]) {
+          const VertexId target = router_.GetEdgeTo(edge_id);
+          if (target == skipped || contracted_[target]) {
+            continue;
+          }
+          const Weight candidate_weight = weight + router_.GetEdgeWeight(edge_id);
+          auto& target_weight = witness_weights_[target];
+          if (!target_weight || candidate_weight < *target_weight) {
+            if (!target_weight) {
+              touched_vertices_.push_back(target);
+            }
+            target_weight = candidate_weight;
+            queue.push({candidate_weight, target});
+          }
+        }
+      }
+    }
+
+    std::vector<Shortcut> FindShortcuts(VertexId vertex) {
+      const auto in_neighbours = CollectInNeighbours(vertex);
+      const auto out_neighbours = CollectOutNeighbours(vertex);
+      std::vector<Shortcut> shortcuts;
+      if (in_neighbours.empty() || out_neighbours.empty()) {
+        return shortcuts;
+      }
+
+      const Weight max_out_weight =
+          std::max_element(begin(out_neighbours), end(out_neighbours), [](const Neighbour& lhs, const Neighbour& rhs) {
+            return lhs.weight < rhs.weight;
+          })->weight;
+
+      for (const Neighbour& in : in_neighbours) {
+        RunWitnessSearch(in.vertex, vertex, in.weight + max_out_weight);
+        for (const Neighbour& out : out_neighbours) {
+          if (out.vertex == in.vertex) {
+            continue;
+          }
+          const Weight shortcut_weight = in.weight + out.weight;
+          const auto& witness_weight = witness_weights_[out.vertex];
+          if (!witness_weight || shortcut_weight < *witness_weight) {
+            shortcuts.push_back({static_cast<StoredId>(in.vertex), static_cast<StoredId>(out.vertex),
+                                 static_cast<StoredId>(in.edge_id), static_cast<StoredId>(out.edge_id),
+                                 shortcut_weight});
+          }
+        }
+      }
+      return shortcuts;
+    }
+
+    // Edge difference keeps the hierarchy sparse, contracted neighbours and depth spread contraction uniformly
+    int ComputePriority(VertexId vertex, const std::vector<Shortcut>& shortcuts) const {
+      const size_t removed_edge_count = CollectInNeighbours(vertex).size() + CollectOutNeighbours(vertex).size();
+      const int edge_difference = static_cast<int>(shortcuts.size()) - static_cast<int>(removed_edge_count);
+      return 2 * edge_difference + deleted_neighbours_[vertex] + depths_[vertex];
+    }
+
+    void Contract(VertexId vertex, std::vector<Shortcut> shortcuts) {
+      for (Shortcut& shortcut : shortcuts) {
+        const EdgeId edge_id = graph_.GetEdgeCount() + router_.built_shortcuts_.size();
+        if (edge_id >= std::numeric_limits<StoredId>::max()) {
+          throw std::length_error("contraction hierarchy is too large: " + std::to_string(edge_id) + " edges");
+        }
+        out_edges_[shortcut.from].push_back(edge_id);
+        in_edges_[shortcut.to].push_back(edge_id);
+        router_.built_shortcuts_.push_back(shortcut);
+      }
+      router_.shortcuts_ = router_.built_shortcuts_;  // the vector may have moved its buffer
+      contracted_[vertex] = true;
+      for (const auto& neighbours : {CollectInNeighbours(vertex), CollectOutNeighbours(vertex)}) {
+        for (const Neighbour& neighbour : neighbours) {
+          ++deleted_neighbours_[neighbour.vertex];
+          depths_[neighbour.vertex] = std::max(depths_[neighbour.vertex], depths_[vertex] + 1);
+        }
+      }
+    }
+
+    ContractionHierarchyRouter& router_;
+    const Graph& graph_;
+    std::vector<std::vector<EdgeId>> out_edges_;
+    std::vector<std::vector<EdgeId>> in_edges_;
+    std::vector<bool> contracted_;
+    std::vector<int> deleted_neighbours_;
+    std::vector<int> depths_;
+    std::vector<size_t> ranks_;
+
+    std::vector<std::optional<Weight>> witness_weights_;
+    std::vector<VertexId> touched_vertices_;
+  };
+
+  template <typename Weight>
+  ContractionHierarchyRouter<Weight>::ContractionHierarchyRouter(const Graph& graph) : Base(graph) {
+    const std::vector<size_t> ranks = Contractor(*this).ContractAll();
+
+    const size_t vertex_count = graph.GetVertexCount();
+    std::vector<std::vector<StoredId>> upward_lists(vertex_count);
+    std::vector<std::vector<StoredId>> downward_lists(vertex_count);
+    for (EdgeId edge_id = 0; edge_id < graph.GetEdgeCount() + shortcuts_.size(); ++edge_id) {
+      const VertexId from = GetEdgeFrom(edge_id);
+      const VertexId to = GetEdgeTo(edge_id);
+      if (from == to) {
+        continue;
+      } else if (ranks[from] < ranks[to]) {
+        upward_lists[from].push_back(static_cast<StoredId>(edge_id));
+      } else {
+        downward_lists[to].push_back(static_cast<StoredId>(edge_id));
+      }
+    }
+
+    for (auto [lists, offsets, edges] :
+         {std::tuple{&upward_lists, &built_upward_offsets_, &built_upward_edges_},
+          std::tuple{&downward_lists, &built_downward_offsets_, &built_downward_edges_}}) {
+      offsets->reserve(vertex_count + 1);
+      offsets->push_back(0);
+      for (const auto& list : *lists) {
+        edges->insert(end(*edges), begin(list), end(list));
+        offsets->push_back(edges->size());
+      }
+    }
+    upward_offsets_ = built_upward_offsets_;
+    upward_edges_ = built_upward_edges_;
+    downward_offsets_ = built_downward_offsets_;
+    downward_edges_ = built_downward_edges_;
+  }
+
+  template <typename Weight>
+  VertexId ContractionHierarchyRouter<Weight>::GetEdgeFrom(EdgeId edge_id) const {
+    const size_t graph_edge_count = this->graph_.GetEdgeCount();
+    return edge_id < graph_edge_count ? this->graph_.GetEdge(edge_id).from
+                                      : shortcuts_[edge_id - graph_edge_count].from;
+  }
+
+  template <typename Weight>
+  VertexId ContractionHierarchyRouter<Weight>::GetEdgeTo(EdgeId edge_id) const {
+    const size_t graph_edge_count = this->graph_.GetEdgeCount();
+    return edge_id < graph_edge_count ? this->graph_.GetEdge(edge_id).to : shortcuts_[edge_id - graph_edge_count].to;
+  }
+
+  template <typename Weight>
+  Weight ContractionHierarchyRouter<Weight>::GetEdgeWeight(EdgeId edge_id) const {
+    const size_t graph_edge_count = this->graph_.GetEdgeCount();
+    return edge_id < graph_edge_count ? this->graph_.GetEdge(edge_id).weight
+                                      : shortcuts_[edge_id - graph_edge_count].weight;
+  }
+
+  template <typename Weight>
+  void ContractionHierarchyRouter<Weight>::UnpackEdge(EdgeId edge_id, std::vector<EdgeId>& edges) const {
+    const size_t graph_edge_count = this->graph_.GetEdgeCount();
+    std::vector<EdgeId> stack = {edge_id};
+    while (!stack.empty()) {
+      const EdgeId current = stack.back();
+      stack.pop_back();
+      if (current < graph_edge_count) {
+        edges.push_back(current);
+      } else {
+        const Shortcut& shortcut = shortcuts_[current - graph_edge_count];
+        stack.push_back(shortcut.rhs);
+        stack.push_back(shortcut.lhs);
+      }
+    }
+  }
+
+  template <typename Weight>
+  void ContractionHierarchyRouter<Weight>::SettleVertex(VertexId vertex, Weight weight, bool is_forward,
+                                                        SearchSpace& space, Queue& queue) const {
+    // Stall-on-demand: a higher vertex reaches this one cheaper, so no shortest path goes up from here
+    const auto stall_offsets = is_forward ? downward_offsets_ : upward_offsets_;
+    const auto stall_edges = is_forward ? downward_edges_ : upward_edges_;
+    for (size_t idx = stall_offsets[vertex]; idx < stall_offsets[vertex + 1]; ++idx) {
+      const EdgeId edge_id = stall_edges[idx];
+      const VertexId higher_vertex = is_forward ? GetEdgeFrom(edge_id) : GetEdgeTo(edge_id);
+      const auto it = space.find(higher_vertex);
+      if (it != space.end() && it->second.weight + GetEdgeWeight(edge_id) < weight) {
+        return;
+      }
+    }
+
+    const auto offsets = is_forward ? upward_offsets_ : downward_offsets_;
+    const auto edges = is_forward ? upward_edges_ : downward_edges_;
+    for (size_t idx = offsets[vertex]; idx < offsets[vertex + 1]; ++idx) {
+      const EdgeId edge_id = edges[idx];
+      const VertexId neighbour = is_forward ? GetEdgeTo(edge_id) : GetEdgeFrom(edge_id);
+      const Weight candidate_weight = weight + GetEdgeWeight(edge_id);
+      const auto [it, inserted] = space.try_emplace(neighbour, RouteInternalData{candidate_weight, edge_id});
+      if (inserted || candidate_weight < it->second.weight) {
+        it->second = {candidate_weight, edge_id};
+        queue.push({candidate_weight, neighbour});
+      }
+    }
+  }
+
+  template <typename Weight>
+  typename ContractionHierarchyRouter<Weight>::SearchSpace ContractionHierarchyRouter<Weight>::SearchUpward(
+      VertexId origin, bool is_forward) const {
+    SearchSpace space = {{origin, {0, std::nullopt}}};
+    Queue queue;
+    queue.push({0, origin});
+    while (!queue.empty()) {
+      const auto [weight, vertex] = queue.top();
+      queue.pop();
+      if (space.at(vertex).weight < weight) {
+        continue;
+      }
+      SettleVertex(vertex, weight, is_forward, space, queue);
+    }
+    // Stalled vertices keep weights of real but longer paths, so they never win a meeting
+    return space;
+  }
+
+  template <typename Weight>
+  std::optional<typename ContractionHierarchyRouter<Weight>::SearchResult>
+  ContractionHierarchyRouter<Weight>::FindShortestPath(VertexId from, VertexId to) const {
+    SearchResult result{0, from, {{from, {0, std::nullopt}}}, {{to, {0, std::nullopt}}}};
+    std::optional<Weight> best_weight;
+    Queue forward_queue;
+    forward_queue.push({0, from});
+    Queue backward_queue;
+    backward_queue.push({0, to});
+
+    // Settles one vertex of the given direction and relaxes its edges going up the hierarchy
+    auto step = [&](bool is_forward) {
+      Queue& queue = is_forward ? forward_queue : backward_queue;
+      SearchSpace& space = is_forward ? result.forward : result.backward;
+      const SearchSpace& opposite_space = is_forward ? result.backward : result.forward;
+
+      const auto [weight, vertex] = queue.top();
+      queue.pop();
+      if (space.at(vertex).weight < weight) {
+        return;
+      }
+      if (auto it = opposite_space.find(vertex); it != opposite_space.end()) {
+        const Weight candidate_weight = weight + it->second.weight;
+        if (!best_weight || candidate_weight < *best_weight) {
+          best_weight = candidate_weight;
+          result.middle = vertex;
+        }
+      }
+      SettleVertex(vertex, weight, is_forward, space, queue);
+    };
+
+    // A direction is done when its queue can not improve the best meeting point anymore
+    auto is_active = [&best_weight](const Queue& queue) {
+      return !queue.empty() && (!best_weight || queue.top().first < *best_weight);
+    };
+
+    while (is_active(forward_queue) || is_active(backward_queue)) {
+      if (is_active(forward_queue)) {
+        step(true);
+      }
+      if (is_active(backward_queue)) {
+        step(false);
+      }
+    }
+
+    if (!best_weight) {
+      return std::nullopt;
+    }
+    result.weight = *best_weight;
+    return result;
+  }
+
+  template <typename Weight>
+  std::optional<typename ContractionHierarchyRouter<Weight>::RouteInfo>
+  ContractionHierarchyRouter<Weight>::BuildRoute(VertexId from, VertexId to) const {
+    const auto search_result = FindShortestPath(from, to);
+    if (!search_result) {
+      return std::nullopt;
+    }
+
+    std::vector<EdgeId> hierarchy_edges;
+    for (std::optional<EdgeId> edge_id = search_result->forward.at(search_result->middle).prev_edge; edge_id;
+         edge_id = search_result->forward.at(GetEdgeFrom(*edge_id)).prev_edge) {
+      hierarchy_edges.push_back(*edge_id);
+    }
+    std::reverse(std::begin(hierarchy_edges), std::end(hierarchy_edges));
+    for (std::optional<EdgeId> edge_id = search_result->backward.at(search_result->middle).prev_edge; edge_id;
+         edge_id = search_result->backward.at(GetEdgeTo(*edge_id)).prev_edge) {
+      hierarchy_edges.push_back(*edge_id);
+    }
+
+    std::vector<EdgeId> edges;
+    for (const EdgeId edge_id : hierarchy_edges) {
+      UnpackEdge(edge_id, edges);
+    }
+
+    return this->SaveRoute(search_result->weight, std::move(edges));
+  }
+
+  template <typename Weight>
+  std::optional<Weight> ContractionHierarchyRouter<Weight>::GetWeight(VertexId from, VertexId to) const {
+    const auto search_result = FindShortestPath(from, to);
+    if (!search_result) {
+      return std::nullopt;
+    }
+    return search_result->weight;
+  }
+
+  template <typename Weight>
+  std::optional<typename ContractionHierarchyRouter<Weight>::TargetRouteInfo>
+  ContractionHierarchyRouter<Weight>::BuildRouteToBestTarget(VertexId from, const std::vector<VertexId>& targets,
+                                                             const TargetCost& target_cost) const {
+    const SearchSpace forward = SearchUpward(from, true);
+    std::optional<std::pair<size_t, Weight>> best_target;
+    for (size_t target_idx = 0; target_idx < targets.size(); ++target_idx) {
+      // Shortest paths meet at their highest vertex, which both upward searches reach
+      std::optional<Weight> weight;
+      for (const auto& [vertex, backward_data] : SearchUpward(targets[target_idx], false)) {
+        if (const auto it = forward.find(vertex); it != forward.end()) {
+          const Weight candidate_weight = it->second.weight + backward_data.weight;
+          if (!weight || candidate_weight < *weight) {
+            weight = candidate_weight;
+          }
+        }
+      }
+      if (weight) {
+        const Weight cost = target_cost(target_idx, *weight);
+        if (!best_target || cost < best_target->second) {
+          best_target = {target_idx, cost};
+        }
+      }
+    }
+    if (!best_target) {
+      return std::nullopt;
+    }
+    const auto& [target_idx, cost] = *best_target;
+    return TargetRouteInfo{target_idx, cost, *BuildRoute(from, targets[target_idx])};
+  }
+
+  template <typename Weight>
+  void ContractionHierarchyRouter<Weight>::Serialize(GraphProto::Router& proto, BaseFile::Writer& base_file) const {
+    static_assert(std::is_same_v<Weight, double>, "Serialization is implemented only for double weights");
+    static_assert(std::endian::native == std::endian::little, "Arrays are stored in little-endian byte order");
+    static_assert(sizeof(Shortcut) == 4 * sizeof(StoredId) + sizeof(Weight), "Shortcuts are stored without padding");
+
+    auto& hierarchy_proto = *proto.mutable_contraction_hierarchy();
+    hierarchy_proto.set_shortcut_count(shortcuts_.size());
+    hierarchy_proto.set_upward_edge_count(upward_edges_.size());
+    hierarchy_proto.set_downward_edge_count(downward_edges_.size());
+    hierarchy_proto.set_shortcuts_offset(base_file.AppendArray(shortcuts_));
+    hierarchy_proto.set_upward_offsets_offset(base_file.AppendArray(upward_offsets_));
+    hierarchy_proto.set_upward_edges_offset(base_file.AppendArray(upward_edges_));
+    hierarchy_proto.set_downward_offsets_offset(base_file.AppendArray(downward_offsets_));
+    hierarchy_proto.set_downward_edges_offset(base_file.AppendArray(downward_edges_));
+  }
+
+  template <typename Weight>
+  ContractionHierarchyRouter<Weight>::ContractionHierarchyRouter(const Graph& graph,
+                                                                 const GraphProto::ContractionHierarchy& proto,
+                                                                 const BaseFile::Reader& base_file)
+      : Base(graph) {
+    static_assert(std::is_same_v<Weight, double>, "Serialization is implemented only for double weights");
+    static_assert(std::endian::native == std::endian::little, "Arrays are stored in little-endian byte order");
+
+    const size_t offset_count = graph.GetVertexCount() + 1;
+    shortcuts_ = base_file.GetArray<Shortcut>(proto.shortcuts_offset(), proto.shortcut_count());
+    upward_offsets_ = base_file.GetArray<StoredId>(proto.upward_offsets_offset(), offset_count);
+    upward_edges_ = base_file.GetArray<StoredId>(proto.upward_edges_offset(), proto.upward_edge_count());
+    downward_offsets_ = base_file.GetArray<StoredId>(proto.downward_offsets_offset(), offset_count);
+    downward_edges_ = base_file.GetArray<StoredId>(proto.downward_edges_offset(), proto.downward_edge_count());
+  }
+
+  template <typename Weight>
+  std::unique_ptr<ContractionHierarchyRouter<Weight>> ContractionHierarchyRouter<Weight>::Deserialize(
+      const GraphProto::Router& proto, const Graph& graph, const BaseFile::Reader& base_file) {
+    return std::unique_ptr<ContractionHierarchyRouter>(
+        new ContractionHierarchyRouter(graph, proto.contraction_hierarchy(), base_file));  // ctor is private
+  }
+
+}  // namespace Graph
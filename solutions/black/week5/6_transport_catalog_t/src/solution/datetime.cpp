@@ -1,5 +1,8 @@
 #include "datetime.h"
 
+#include <algorithm>
+#include <iterator>
+
 using namespace std;
 
 int DateTime::ToMinutesPoint() const { return hours * 60 + minutes; }
@@ -70,3 +73,43 @@ int CalculateWaitTime(DateTime dt, const YellowPages::WorkingTime& working_time)
     return CalculateRegularScheduleWaitTime(dt, working_time);
   }
 }
+
+WeeklySchedule::WeeklySchedule(const YellowPages::WorkingTime& working_time) {
+  for (const auto& interval : working_time.intervals()) {
+    if (interval.day() == YellowPages::WorkingTimeInterval::Day::WorkingTimeInterval_Day_EVERYDAY) {
+      for (int week_day = 0; week_day < 7; ++week_day) {
+        intervals_.push_back({week_day * MINUTES_PER_DAY + interval.minutes_from(),
+                              week_day * MINUTES_PER_DAY + interval.minutes_to()});
+      }
+    } else {
+      const int day_start = (interval.day() - 1) * MINUTES_PER_DAY;
+      intervals_.push_back({day_start + interval.minutes_from(), day_start + interval.minutes_to()});
+    }
+  }
+
+  sort(begin(intervals_), end(intervals_), [](Interval lhs, Interval rhs) { return lhs.from < rhs.from; });
+  vector<Interval> merged;
+  for (const Interval interval : intervals_) {
+    if (!merged.empty() && interval.from <= merged.back().to) {
+      merged.back().to = max(merged.back().to, interval.to);
+    } else {
+      merged.push_back(interval);
+    }
+  }
+  merged.shrink_to_fit();
+  intervals_ = move(merged);
+}
+
+int WeeklySchedule::GetWaitTime(DateTime dt) const {
+  if (intervals_.empty()) {
+    return 0;
+  }
+  const int start_minutes = dt.week_day * MINUTES_PER_DAY + dt.ToMinutesPoint();
+  const auto next_good_interval_it = partition_point(
+      begin(intervals_), end(intervals_), [start_minutes](Interval interval) { return interval.to <= start_minutes; });
+
+  if (next_good_interval_it == end(intervals_)) {
+    return MINUTES_PER_WEEK - start_minutes + intervals_.front().from;
+  }
+  return max(next_good_interval_it->from - start_minutes, 0);
+}
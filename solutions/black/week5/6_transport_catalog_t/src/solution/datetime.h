@@ -1,4 +1,6 @@
 #pragma once
+#include <vector>
+
 #include "working_time.pb.h"
 
 
@@ -11,4 +13,27 @@ struct DateTime {
 
 DateTime operator+(DateTime dt, int minutes);
 
+// Scans the schedule, see WeeklySchedule for repeated lookups
 int CalculateWaitTime(DateTime dt, const YellowPages::WorkingTime& working_time);
+
+// Working time compiled into disjoint sorted intervals of minutes from the week start,
+// so that a wait time takes a binary search
+class WeeklySchedule {
+ public:
+  static constexpr int MINUTES_PER_DAY = 24 * 60;
+  static constexpr int MINUTES_PER_WEEK = 7 * MINUTES_PER_DAY;
+
+  WeeklySchedule() = default;  // open all the time
+  explicit WeeklySchedule(const YellowPages::WorkingTime& working_time);
+
+  // Same as CalculateWaitTime with the compiled working time
+  int GetWaitTime(DateTime dt) const;
+
+ private:
+  struct Interval {
+    int from;
+    int to;  // exclusive
+  };
+
+  std::vector<Interval> intervals_;
+};
@@ -1,5 +1,10 @@
 #include "descriptions.h"
 
+#include <algorithm>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+
 using namespace std;
 
 namespace Descriptions {
@@ -13,8 +18,10 @@ namespace Descriptions {
                      },
                  .distances = {}};
     if (attrs.count("road_distances") > 0) {
-      for (const auto& [neighbour_stop, distance_node] : attrs.at("road_distances").AsMap()) {
-        stop.distances[neighbour_stop] = distance_node.AsInt();
+      const auto& distances = attrs.at("road_distances").AsMap();
+      stop.distances.reserve(distances.size());
+      for (const auto& [neighbour_stop, distance_node] : distances) {
+        stop.distances.emplace_back(neighbour_stop, distance_node.AsInt());
       }
     }
     return stop;
@@ -36,14 +43,6 @@ namespace Descriptions {
     return stops;
   }
 
-  size_t ComputeStopsDistance(const Stop& lhs, const Stop& rhs) {
-    if (auto it = lhs.distances.find(rhs.name); it != lhs.distances.end()) {
-      return it->second;
-    } else {
-      return rhs.distances.at(lhs.name);
-    }
-  }
-
   Bus Bus::ParseFrom(const Json::Dict& attrs) {
     const auto& name = attrs.at("name").AsString();
     const auto& stops = attrs.at("stops").AsArray();
@@ -60,31 +59,12 @@ namespace Descriptions {
     }
   }
 
-  void Bus::Serialize(TCProto::BusDescription& proto) const {
-    proto.set_name(name);
-    for (const string& stop : stops) {
-      proto.add_stops(stop);
-    }
-    for (const string& stop : endpoints) {
-      proto.add_endpoints(stop);
-    }
-  }
-
-  Bus Bus::Deserialize(const TCProto::BusDescription& proto) {
-    Bus bus;
-    bus.name = proto.name();
-
-    bus.stops.reserve(proto.stops_size());
-    for (const auto& stop : proto.stops()) {
-      bus.stops.push_back(stop);
-    }
-
-    bus.endpoints.reserve(proto.endpoints_size());
-    for (const auto& stop : proto.endpoints()) {
-      bus.endpoints.push_back(stop);
+  static InputQuery ReadDescription(const Json::Dict& attrs) {
+    if (attrs.at("type").AsString() == "Bus") {
+      return Bus::ParseFrom(attrs);
+    } else {
+      return Stop::ParseFrom(attrs);
     }
-
-    return bus;
   }
 
   vector<InputQuery> ReadDescriptions(const Json::Array& nodes) {
@@ -92,12 +72,7 @@ namespace Descriptions {
     result.reserve(nodes.size());
 
     for (const Json::Node& node : nodes) {
-      const auto& node_dict = node.AsMap();
-      if (node_dict.at("type").AsString() == "Bus") {
-        result.push_back(Bus::ParseFrom(node_dict));
-      } else {
-        result.push_back(Stop::ParseFrom(node_dict));
-      }
+      result.push_back(ReadDescription(node.AsMap()));
     }
 
     return result;
@@ -205,68 +180,329 @@ namespace Descriptions {
     return name;
   }
 
-  YellowPages::Database ReadYellowPages(const Json::Dict& attrs) {
-    YellowPages::Database db;
-    for (const auto& [id, rubric] : attrs.at("rubrics").AsMap()) {
+  static void ReadRubrics(const Json::Dict& attrs, YellowPages::Database& db) {
+    for (const auto& [id, rubric] : attrs) {
       YellowPages::Rubric r;
       *r.mutable_name() = rubric.AsMap().at("name").AsString();
       (*db.mutable_rubrics())[stoi(id)] = move(r);
     }
+  }
 
-    size_t id = 0;
+  // Full names are left for FillCompaniesFullNames, rubrics may be not read yet
+  static YellowPages::Company ReadCompany(const Json::Dict& dict, size_t id) {
+    YellowPages::Company company;
+    company.set_id(to_string(id));
+
+    {
+      YellowPages::Address addr;
+      const auto& attrs = dict.at("address").AsMap().at("coords").AsMap();
+      (*addr.mutable_coords()).set_lat(stod(attrs.at("lat").AsString()));
+      (*addr.mutable_coords()).set_lon(stod(attrs.at("lon").AsString()));
+      (*company.mutable_address()) = move(addr);
+    }
 
-    for (const auto& company_node : attrs.at("companies").AsArray()) {
-      YellowPages::Company company;
-      company.set_id(to_string(id++));
-      const auto& dict = company_node.AsMap();
-
-      {
-        YellowPages::Address addr;
-        const auto& attrs = dict.at("address").AsMap().at("coords").AsMap();
-        (*addr.mutable_coords()).set_lat(stod(attrs.at("lat").AsString()));
-        (*addr.mutable_coords()).set_lon(stod(attrs.at("lon").AsString()));
-        (*company.mutable_address()) = move(addr);
+    if (dict.count("rubrics")) {
+      for (const auto& rubric_id_node : dict.at("rubrics").AsArray()) {
+        company.add_rubrics(rubric_id_node.AsInt());
       }
+    }
+
+    for (const auto& name_node : dict.at("names").AsArray()) {
+      *company.add_names() = ReadName(name_node.AsMap());
+    }
 
-      if (dict.count("rubrics")) {
-        for (const auto& rubric_id_node : dict.at("rubrics").AsArray()) {
-          company.add_rubrics(rubric_id_node.AsInt());
-        }
+    (*company.mutable_cached_main_name()) = GetMainCompanyName(company);
+
+    if (dict.count("urls")) {
+      for (const auto& url_node : dict.at("urls").AsArray()) {
+        YellowPages::Url url;
+        url.set_value(url_node.AsMap().at("value").AsString());
+        *company.add_urls() = move(url);
       }
+    }
 
-      for (const auto& name_node : dict.at("names").AsArray()) {
-        *company.add_names() = ReadName(name_node.AsMap());
+    if (dict.count("phones")) {
+      for (const auto& phone_node : dict.at("phones").AsArray()) {
+        *company.add_phones() = ReadPhone(phone_node.AsMap());
       }
+    }
 
-      (*company.mutable_cached_main_name()) = GetMainCompanyName(company);
+    if (dict.count("nearby_stops")) {
+      for (const auto& stop_node : dict.at("nearby_stops").AsArray()) {
+        *company.add_nearby_stops() = ReadNearbyStop(stop_node.AsMap());
+      }
+    }
+
+    if(dict.count("working_time")) {
+      *company.mutable_working_time() = ReadWorkingTime(dict.at("working_time").AsMap());
+    }
+
+    return company;
+  }
+
+  static void FillCompaniesFullNames(YellowPages::Database& db) {
+    for (auto& company : *db.mutable_companies()) {
       (*company.mutable_cached_full_name()) = GetFullCompanyName(db, company);
+    }
+  }
+
+  YellowPages::Database ReadYellowPages(const Json::Dict& attrs) {
+    YellowPages::Database db;
+    ReadRubrics(attrs.at("rubrics").AsMap(), db);
+
+    size_t id = 0;
+    for (const auto& company_node : attrs.at("companies").AsArray()) {
+      *db.add_companies() = ReadCompany(company_node.AsMap(), id++);
+    }
+
+    FillCompaniesFullNames(db);
+    return db;
+  }
+
+  // Full names are left for FillCompaniesFullNames
+  static YellowPages::Database ReadYellowPages(Json::Parser& parser) {
+    YellowPages::Database db;
+    size_t id = 0;
+    parser.ParseDict([&](const string& key) {
+      if (key == "rubrics") {
+        ReadRubrics(parser.ParseNode().AsMap(), db);
+      } else if (key == "companies") {
+        parser.ParseArray([&] { *db.add_companies() = ReadCompany(parser.ParseNode().AsMap(), id++); });
+      } else {
+        parser.ParseNode();
+      }
+    });
+    return db;
+  }
+
+  BaseInput ReadBaseChanges(Json::Parser& parser) {
+    BaseInput input;
+    parser.ParseDict([&](string key) {
+      if (key == "base_requests") {
+        parser.ParseArray([&] { input.descriptions.push_back(ReadDescription(parser.ParseNode().AsMap())); });
+      } else if (key == "yellow_pages") {
+        input.yellow_pages = ReadYellowPages(parser);
+      } else {
+        input.settings.emplace(move(key), parser.ParseNode());
+      }
+    });
+    return input;
+  }
+
+  BaseInput ReadBaseInput(Json::Parser& parser) {
+    BaseInput input = ReadBaseChanges(parser);
+    FillCompaniesFullNames(input.yellow_pages);
+    return input;
+  }
 
-      if (dict.count("urls")) {
-        for (const auto& url_node : dict.at("urls").AsArray()) {
-          YellowPages::Url url;
-          url.set_value(url_node.AsMap().at("value").AsString());
-          *company.add_urls() = move(url);
-        }
+  template <typename Object>
+  static void UpdateByNames(vector<Object>& objects, vector<Object> changes, const vector<string>& removed_names) {
+    map<string, Object> objects_by_name;
+    for (auto* source : {&objects, &changes}) {
+      for (Object& object : *source) {
+        string name = object.name;
+        objects_by_name.insert_or_assign(move(name), move(object));
       }
+    }
+    for (const string& name : removed_names) {
+      objects_by_name.erase(name);
+    }
 
-      if (dict.count("phones")) {
-        for (const auto& phone_node : dict.at("phones").AsArray()) {
-          *company.add_phones() = ReadPhone(phone_node.AsMap());
-        }
+    objects.clear();
+    objects.reserve(objects_by_name.size());
+    for (auto& [_, object] : objects_by_name) {
+      objects.push_back(move(object));
+    }
+  }
+
+  void BaseSources::Update(vector<InputQuery> changes, const vector<string>& removed_stops,
+                           const vector<string>& removed_buses) {
+    vector<Stop> changed_stops;
+    vector<Bus> changed_buses;
+    for (auto& item : changes) {
+      if (auto* stop = get_if<Stop>(&item)) {
+        changed_stops.push_back(move(*stop));
+      } else if (auto* bus = get_if<Bus>(&item)) {
+        changed_buses.push_back(move(*bus));
       }
+    }
+    UpdateByNames(stops, move(changed_stops), removed_stops);
+    UpdateByNames(buses, move(changed_buses), removed_buses);
+  }
+
+  static string PrintSettings(const Json::Dict& settings) {
+    ostringstream output;
+    output.precision(17);  // doubles are read back exactly
+    Json::PrintValue(settings, output);
+    return output.str();
+  }
+
+  static Json::Dict LoadSettings(const string& json) {
+    istringstream input(json);
+    return Json::Load(input).GetRoot().AsMap();
+  }
 
-      if (dict.count("nearby_stops")) {
-        for (const auto& stop_node : dict.at("nearby_stops").AsArray()) {
-          *company.add_nearby_stops() = ReadNearbyStop(stop_node.AsMap());
-        }
+  void BaseSources::Serialize(TCProto::BaseSources& proto) const {
+    for (const Stop& stop : stops) {
+      auto& stop_proto = *proto.add_stops();
+      stop_proto.set_name(stop.name);
+      stop_proto.set_latitude(stop.position.latitude);
+      stop_proto.set_longitude(stop.position.longitude);
+      for (const auto& [neighbour, distance] : stop.distances) {
+        stop_proto.add_neighbours(neighbour);
+        stop_proto.add_distances(distance);
       }
+    }
+    for (const Bus& bus : buses) {
+      auto& bus_proto = *proto.add_buses();
+      bus_proto.set_name(bus.name);
+      bus_proto.mutable_stops()->Add(begin(bus.stops), end(bus.stops));
+      bus_proto.mutable_endpoints()->Add(begin(bus.endpoints), end(bus.endpoints));
+    }
+    proto.set_routing_settings(PrintSettings(routing_settings));
+    proto.set_render_settings(PrintSettings(render_settings));
+  }
 
-      if(dict.count("working_time")) {
-        *company.mutable_working_time() = ReadWorkingTime(dict.at("working_time").AsMap());
+  BaseSources BaseSources::Deserialize(const TCProto::BaseSources& proto) {
+    BaseSources sources;
+    sources.stops.reserve(proto.stops_size());
+    for (const auto& stop_proto : proto.stops()) {
+      Stop& stop = sources.stops.emplace_back();
+      stop.name = stop_proto.name();
+      stop.position = {stop_proto.latitude(), stop_proto.longitude()};
+      stop.distances.reserve(stop_proto.neighbours_size());
+      for (int idx = 0; idx < stop_proto.neighbours_size(); ++idx) {
+        stop.distances.emplace_back(stop_proto.neighbours(idx), stop_proto.distances(idx));
       }
+    }
+    sources.buses.reserve(proto.buses_size());
+    for (const auto& bus_proto : proto.buses()) {
+      sources.buses.push_back({bus_proto.name(),
+                               {begin(bus_proto.stops()), end(bus_proto.stops())},
+                               {begin(bus_proto.endpoints()), end(bus_proto.endpoints())}});
+    }
+    sources.routing_settings = LoadSettings(proto.routing_settings());
+    sources.render_settings = LoadSettings(proto.render_settings());
+    return sources;
+  }
+
+  bool HaveSameRoutes(const BaseSources& lhs, const BaseSources& rhs) {
+    return equal(begin(lhs.stops), end(lhs.stops), begin(rhs.stops), end(rhs.stops),
+                 [](const Stop& lhs, const Stop& rhs) {
+                   return lhs.name == rhs.name && lhs.distances == rhs.distances;
+                 }) &&
+           equal(begin(lhs.buses), end(lhs.buses), begin(rhs.buses), end(rhs.buses),
+                 [](const Bus& lhs, const Bus& rhs) { return lhs.name == rhs.name && lhs.stops == rhs.stops; }) &&
+           PrintSettings(lhs.routing_settings) == PrintSettings(rhs.routing_settings);
+  }
+
+  static bool HaveSamePosition(const Stop& lhs, const Stop& rhs) {
+    const auto same = [](double lhs, double rhs) { return !(lhs < rhs) && !(rhs < lhs); };
+    return same(lhs.position.latitude, rhs.position.latitude) && same(lhs.position.longitude, rhs.position.longitude);
+  }
 
-      *db.add_companies() = move(company);
+  unordered_set<string> FindBusesWithSameStats(const BaseSources& lhs, const BaseSources& rhs) {
+    // Stats depend on the distances between neighbour stops of a bus, which only their own records give
+    unordered_map<string_view, const Stop*> lhs_stops;
+    for (const Stop& stop : lhs.stops) {
+      lhs_stops.emplace(stop.name, &stop);
     }
-    return db;
+    unordered_set<string_view> same_stops;
+    for (const Stop& stop : rhs.stops) {
+      const auto it = lhs_stops.find(stop.name);
+      if (it != lhs_stops.end() && HaveSamePosition(*it->second, stop) && it->second->distances == stop.distances) {
+        same_stops.insert(stop.name);
+      }
+    }
+
+    unordered_map<string_view, const Bus*> lhs_buses;
+    for (const Bus& bus : lhs.buses) {
+      lhs_buses.emplace(bus.name, &bus);
+    }
+    unordered_set<string> result;
+    for (const Bus& bus : rhs.buses) {
+      const auto it = lhs_buses.find(bus.name);
+      if (it != lhs_buses.end() && it->second->stops == bus.stops &&
+          all_of(begin(bus.stops), end(bus.stops), [&](const string& stop) { return same_stops.count(stop) > 0; })) {
+        result.insert(bus.name);
+      }
+    }
+    return result;
+  }
+
+  void CheckStopReferences(const BaseSources& sources, const YellowPages::Database& yellow_pages) {
+    // Stops are sorted by names
+    auto check = [&stops = sources.stops](const string& stop_name, const string& user) {
+      const auto it = lower_bound(begin(stops), end(stops), stop_name,
+                                  [](const Stop& stop, const string& name) { return stop.name < name; });
+      if (it == end(stops) || it->name != stop_name) {
+        throw invalid_argument(user + " refers to unknown stop " + stop_name);
+      }
+    };
+    for (const Stop& stop : sources.stops) {
+      for (const auto& [neighbour, _] : stop.distances) {
+        check(neighbour, "road distance from stop " + stop.name);
+      }
+    }
+    for (const Bus& bus : sources.buses) {
+      for (const string& stop_name : bus.stops) {
+        check(stop_name, "bus " + bus.name);
+      }
+    }
+    for (const auto& company : yellow_pages.companies()) {
+      for (const auto& nearby_stop : company.nearby_stops()) {
+        check(nearby_stop.name(), "company " + company.cached_main_name());
+      }
+    }
+  }
+
+  vector<optional<size_t>> UpdateYellowPages(YellowPages::Database& yellow_pages, YellowPages::Database changes,
+                                             const vector<string>& removed_companies) {
+    unordered_set<uint64_t> changed_rubric_ids;
+    for (auto& [rubric_id, rubric] : *changes.mutable_rubrics()) {
+      changed_rubric_ids.insert(rubric_id);
+      (*yellow_pages.mutable_rubrics())[rubric_id] = move(rubric);
+    }
+
+    auto& companies = *yellow_pages.mutable_companies();
+    vector<optional<size_t>> previous_positions;
+    unordered_map<string, int> company_idx_by_name;
+    for (int idx = 0; idx < companies.size(); ++idx) {
+      company_idx_by_name.emplace(companies[idx].cached_main_name(), idx);
+      previous_positions.emplace_back(idx);
+    }
+    for (auto& company : *changes.mutable_companies()) {
+      if (const auto it = company_idx_by_name.find(company.cached_main_name()); it != company_idx_by_name.end()) {
+        companies[it->second] = move(company);
+        previous_positions[it->second] = nullopt;
+      } else {
+        company_idx_by_name.emplace(company.cached_main_name(), companies.size());
+        *companies.Add() = move(company);
+        previous_positions.emplace_back(nullopt);
+      }
+    }
+
+    const unordered_set<string> removed_names(begin(removed_companies), end(removed_companies));
+    vector<optional<size_t>> kept_previous_positions;
+    for (int idx = 0; idx < companies.size(); ++idx) {
+      if (removed_names.count(companies[idx].cached_main_name()) > 0) {
+        continue;
+      }
+      const bool rubric_changed = any_of(begin(companies[idx].rubrics()), end(companies[idx].rubrics()),
+                                         [&](uint64_t rubric_id) { return changed_rubric_ids.count(rubric_id) > 0; });
+      kept_previous_positions.push_back(rubric_changed ? nullopt : previous_positions[idx]);
+    }
+    companies.erase(remove_if(companies.begin(), companies.end(),
+                              [&removed_names](const YellowPages::Company& company) {
+                                return removed_names.count(company.cached_main_name()) > 0;
+                              }),
+                    companies.end());
+
+    size_t id = 0;
+    for (auto& company : companies) {
+      company.set_id(to_string(id++));
+    }
+    FillCompaniesFullNames(yellow_pages);
+    return kept_previous_positions;
   }
 }  // namespace Descriptions
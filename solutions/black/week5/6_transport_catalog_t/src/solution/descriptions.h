@@ -1,9 +1,11 @@
 #pragma once
 
 #include <map>
+#include <optional>
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
+#include <utility>
 #include <variant>
 #include <vector>
 
@@ -17,22 +19,17 @@ namespace Descriptions {
   struct Stop {
     std::string name;
     Sphere::Point position;
-    std::unordered_map<std::string, size_t> distances;
+    std::vector<std::pair<std::string, size_t>> distances;  // to neighbour stops, see StopDistances
 
     static Stop ParseFrom(const Json::Dict& attrs);
   };
 
-  size_t ComputeStopsDistance(const Stop& lhs, const Stop& rhs);
-
   struct Bus {
     std::string name;
     std::vector<std::string> stops;
     std::vector<std::string> endpoints;
 
     static Bus ParseFrom(const Json::Dict& attrs);
-
-    void Serialize(TCProto::BusDescription& proto) const;
-    static Bus Deserialize(const TCProto::BusDescription& proto);
   };
 
   using InputQuery = std::variant<Stop, Bus, YellowPages::Company>;
@@ -40,6 +37,54 @@ namespace Descriptions {
   std::vector<InputQuery> ReadDescriptions(const Json::Array& nodes);
   YellowPages::Database ReadYellowPages(const Json::Dict& attrs);
 
+  // make_base input with the bulky parts already converted
+  struct BaseInput {
+    std::vector<InputQuery> descriptions;
+    YellowPages::Database yellow_pages;
+    Json::Dict settings;  // the rest of the top level keys
+  };
+
+  // Converts base requests and companies one by one while parsing,
+  // so the input never has to be held as a whole JSON tree
+  BaseInput ReadBaseInput(Json::Parser& parser);
+  // update_base input is read the same way, but companies get their full names only in UpdateYellowPages,
+  // as their rubrics may come from the base
+  BaseInput ReadBaseChanges(Json::Parser& parser);
+
+  // What a base is built from besides the yellow pages, which the base keeps anyway.
+  // Stored in the base, so that update_base needs only the changes.
+  struct BaseSources {
+    std::vector<Stop> stops;  // sorted by names
+    std::vector<Bus> buses;   // sorted by names
+    Json::Dict routing_settings;
+    Json::Dict render_settings;
+
+    // Descriptions replace the ones with the same names or are added, then the removed names go away
+    void Update(std::vector<InputQuery> changes, const std::vector<std::string>& removed_stops,
+                const std::vector<std::string>& removed_buses);
+
+    void Serialize(TCProto::BaseSources& proto) const;
+    static BaseSources Deserialize(const TCProto::BaseSources& proto);
+  };
+
+  // Routes depend on the stops, road distances, buses and routing settings, but not on the stop positions
+  bool HaveSameRoutes(const BaseSources& lhs, const BaseSources& rhs);
+
+  // Names of the buses of rhs with the same stats as in lhs: the same stops, which keep their positions
+  // and road distances
+  std::unordered_set<std::string> FindBusesWithSameStats(const BaseSources& lhs, const BaseSources& rhs);
+
+  // Throws std::invalid_argument if a bus, a road distance or a company nearby stop names a stop
+  // that is not in the sources, as after removing a stop that is still in use
+  void CheckStopReferences(const BaseSources& sources, const YellowPages::Database& yellow_pages);
+
+  // The same as BaseSources::Update for companies by their main names and for rubrics by ids.
+  // Company ids and full names are refreshed. Returns the previous positions of the companies in the order
+  // of the updated ones, nullopt for the added and replaced companies and for the ones with a changed rubric.
+  std::vector<std::optional<size_t>> UpdateYellowPages(YellowPages::Database& yellow_pages,
+                                                       YellowPages::Database changes,
+                                                       const std::vector<std::string>& removed_companies);
+
   template <typename Object>
   using Dict = std::map<std::string, const Object*>;
 
@@ -0,0 +1,184 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <functional>
+#include <iterator>
+#include <optional>
+#include <queue>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "graph.h"
+#include "graph.pb.h"
+#include "router.h"
+
+namespace Graph {
+
+  // Computes every route on demand with Dijkstra over a binary heap:
+  // nothing is precomputed, O(E log V) per query
+  template <typename Weight>
+  class DijkstraRouter : public Router<Weight> {
+   private:
+    using Base = Router<Weight>;
+    using typename Base::Graph;
+
+   public:
+    using typename Base::RouteInfo;
+
+    explicit DijkstraRouter(const Graph& graph);
+
+    // The graph is all the router needs, so there is nothing to store
+    void Serialize(GraphProto::Router&, BaseFile::Writer&) const override {}
+
+    std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const override;
+    std::optional<Weight> GetWeight(VertexId from, VertexId to) const override;
+
+    using typename Base::TargetCost;
+    using typename Base::TargetRouteInfo;
+
+    // A single search settling targets in order of route weight until no cost can improve
+    std::optional<TargetRouteInfo> BuildRouteToBestTarget(VertexId from, const std::vector<VertexId>& targets,
+                                                          const TargetCost& target_cost) const override;
+
+   private:
+    struct RouteInternalData {
+      Weight weight;
+      std::optional<EdgeId> prev_edge;
+    };
+    using RoutesInternalData = std::vector<std::optional<RouteInternalData>>;
+
+    // Stops as soon as `to` is settled, so only its data is guaranteed to be final
+    RoutesInternalData FindShortestPaths(VertexId from, VertexId to) const;
+
+    // Calls on_settled(vertex, weight) for every settled vertex, stops once it returns true
+    template <typename OnSettled>
+    RoutesInternalData FindShortestPaths(VertexId from, OnSettled on_settled) const;
+
+    std::vector<EdgeId> ExpandRoute(const RoutesInternalData& routes_internal_data, VertexId to) const;
+  };
+
+  template <typename Weight>
+  DijkstraRouter<Weight>::DijkstraRouter(const Graph& graph) : Base(graph) {}
+
+  template <typename Weight>
+  typename DijkstraRouter<Weight>::RoutesInternalData DijkstraRouter<Weight>::FindShortestPaths(VertexId from,
+                                                                                               VertexId to) const {
+    return FindShortestPaths(from, [to](VertexId vertex, Weight) { return vertex == to; });
+  }
+
+  template <typename Weight>
+  template <typename OnSettled>
+  typename DijkstraRouter<Weight>::RoutesInternalData DijkstraRouter<Weight>::FindShortestPaths(
+      VertexId from, OnSettled on_settled) const {
+    const Graph& graph = this->graph_;
+    RoutesInternalData routes_internal_data(graph.GetVertexCount());
+    routes_internal_data[from] = RouteInternalData{0, std::nullopt};
+
+    using QueueItem = std::pair<Weight, VertexId>;
+    std::priority_queue<QueueItem, std::vector<QueueItem>, std::greater<QueueItem>> queue;
+    queue.push({0, from});
+
+    while (!queue.empty()) {
+      const auto [weight, vertex] = queue.top();
+      queue.pop();
+      if (routes_internal_data[vertex]->weight < weight) {
+        continue;  // outdated queue item, the vertex was settled earlier
+      }
+      if (on_settled(vertex, weight)) {
+        break;
+      }
+      for (const EdgeId edge_id : graph.GetIncidentEdges(vertex)) {
+        const auto& edge = graph.GetEdge(edge_id);
+        assert(edge.weight >= 0);
+        const Weight candidate_weight = weight + edge.weight;
+        auto& route_internal_data = routes_internal_data[edge.to];
+        if (!route_internal_data || candidate_weight < route_internal_data->weight) {
+          route_internal_data = RouteInternalData{candidate_weight, edge_id};
+          queue.push({candidate_weight, edge.to});
+        }
+      }
+    }
+
+    return routes_internal_data;
+  }
+
+  template <typename Weight>
+  std::optional<typename DijkstraRouter<Weight>::RouteInfo> DijkstraRouter<Weight>::BuildRoute(VertexId from,
+                                                                                             VertexId to) const {
+    const RoutesInternalData routes_internal_data = FindShortestPaths(from, to);
+    const auto& route_internal_data = routes_internal_data[to];
+    if (!route_internal_data) {
+      return std::nullopt;
+    }
+    return this->SaveRoute(route_internal_data->weight, ExpandRoute(routes_internal_data, to));
+  }
+
+  template <typename Weight>
+  std::vector<EdgeId> DijkstraRouter<Weight>::ExpandRoute(const RoutesInternalData& routes_internal_data,
+                                                          VertexId to) const {
+    std::vector<EdgeId> edges;
+    for (std::optional<EdgeId> edge_id = routes_internal_data[to]->prev_edge; edge_id;
+         edge_id = routes_internal_data[this->graph_.GetEdge(*edge_id).from]->prev_edge) {
+      edges.push_back(*edge_id);
+    }
+    std::reverse(std::begin(edges), std::end(edges));
+    return edges;
+  }
+
+  template <typename Weight>
+  std::optional<Weight> DijkstraRouter<Weight>::GetWeight(VertexId from, VertexId to) const {
+    const RoutesInternalData routes_internal_data = FindShortestPaths(from, to);
+    const auto& route_internal_data = routes_internal_data[to];
+    if (!route_internal_data) {
+      return std::nullopt;
+    }
+    return route_internal_data->weight;
+  }
+
+  template <typename Weight>
+  std::optional<typename DijkstraRouter<Weight>::TargetRouteInfo> DijkstraRouter<Weight>::BuildRouteToBestTarget(
+      VertexId from, const std::vector<VertexId>& targets, const TargetCost& target_cost) const {
+    std::unordered_map<VertexId, std::vector<size_t>> vertex_targets;
+    for (size_t target_idx = 0; target_idx < targets.size(); ++target_idx) {
+      vertex_targets[targets[target_idx]].push_back(target_idx);
+    }
+
+    struct BestTarget {
+      size_t target_idx;
+      Weight cost;
+    };
+    std::optional<BestTarget> best_target;
+    size_t settled_vertex_count = 0;
+    const RoutesInternalData routes_internal_data = FindShortestPaths(from, [&](VertexId vertex, Weight weight) {
+      // Costs are not less than weights, so nothing settled later can beat the best one
+      if (best_target && best_target->cost < weight) {
+        return true;
+      }
+      const auto it = vertex_targets.find(vertex);
+      if (it == vertex_targets.end()) {
+        return false;
+      }
+      for (const size_t target_idx : it->second) {
+        const Weight cost = target_cost(target_idx, weight);
+        if (!best_target || cost < best_target->cost ||
+            (!(best_target->cost < cost) && target_idx < best_target->target_idx)) {
+          best_target = BestTarget{target_idx, cost};
+        }
+      }
+      return ++settled_vertex_count == vertex_targets.size();
+    });
+
+    if (!best_target) {
+      return std::nullopt;
+    }
+    const VertexId to = targets[best_target->target_idx];
+    return TargetRouteInfo{
+        best_target->target_idx,
+        best_target->cost,
+        this->SaveRoute(routes_internal_data[to]->weight, ExpandRoute(routes_internal_data, to)),
+    };
+  }
+
+}  // namespace Graph
@@ -1,5 +1,8 @@
 #include "filters.h"
 
+#include <algorithm>
+#include <stdexcept>
+
 using namespace std;
 
 CompaniesFilter::CompaniesFilter(const Json::Dict& attrs) {
@@ -8,6 +11,23 @@ CompaniesFilter::CompaniesFilter(const Json::Dict& attrs) {
       names.push_back(name.AsString());
     }
   }
+  if (attrs.count("match")) {
+    const string& match = attrs.at("match").AsString();
+    if (match == "prefix") {
+      name_match = NameMatch::PREFIX;
+    } else if (match == "fuzzy") {
+      name_match = NameMatch::FUZZY;
+    } else if (match != "exact") {
+      throw invalid_argument("unknown match mode: " + match);
+    }
+  }
+  if (attrs.count("max_edits")) {
+    const int requested_max_edits = attrs.at("max_edits").AsInt();
+    if (requested_max_edits < 0) {
+      throw invalid_argument("negative max_edits: " + to_string(requested_max_edits));
+    }
+    max_edits = min(static_cast<uint32_t>(requested_max_edits), MAX_EDITS);
+  }
   if (attrs.count("urls")) {
     for (const auto& url : attrs.at("urls").AsArray()) {
       urls.push_back(url.AsString());
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
 #include <vector>
 
@@ -7,10 +8,17 @@
 #include "phone.pb.h"
 
 struct CompaniesFilter {
+  // How names and rubrics of the filter are compared with those of companies
+  enum class NameMatch { EXACT, PREFIX, FUZZY };
+
   std::vector<std::string> names;
   std::vector<std::string> rubrics;
   std::vector<std::string> urls;
   std::vector<YellowPages::Phone> phones;
+  NameMatch name_match = NameMatch::EXACT;
+  // Fuzzy search gets slower quickly as it allows more edits, so requests get at most MAX_EDITS
+  static constexpr uint32_t MAX_EDITS = 3;
+  uint32_t max_edits = 1;  // for fuzzy matching
 
   CompaniesFilter() = default;
   CompaniesFilter(const Json::Dict& attrs);
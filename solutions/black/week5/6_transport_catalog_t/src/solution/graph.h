@@ -1,12 +1,20 @@
 #pragma once
 
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cstdint>
 #include <cstdlib>
-#include <deque>
+#include <limits>
+#include <ranges>
+#include <span>
+#include <stdexcept>
+#include <string>
 #include <type_traits>
 #include <vector>
 
+#include "base_file.h"
 #include "graph.pb.h"
-#include "utils.h"
 
 namespace Graph {
 
@@ -20,105 +28,159 @@ namespace Graph {
     Weight weight;
   };
 
+  // Edges are added one by one and then finalized into compressed sparse rows:
+  // the edges going from a vertex get consecutive ids, and their ends and weights lie side by side
   template <typename Weight>
   class DirectedWeightedGraph {
    private:
-    using IncidenceList = std::vector<EdgeId>;
-    using IncidentEdgesRange = Range<typename IncidenceList::const_iterator>;
+    using IncidentEdgesRange = std::ranges::iota_view<EdgeId, EdgeId>;
 
    public:
     DirectedWeightedGraph(size_t vertex_count = 0);
+
+    DirectedWeightedGraph(DirectedWeightedGraph&&) = default;
+    DirectedWeightedGraph& operator=(DirectedWeightedGraph&&) = default;
+
+    // Returns the position of the edge among the added ones, Finalize maps it to the edge id
     EdgeId AddEdge(const Edge<Weight>& edge);
+    // Edges keep their order within a vertex. Returns the ids of the edges in the order they were added.
+    // Throws std::length_error if the vertices or the edges don't fit StoredId.
+    std::vector<EdgeId> Finalize();
 
     size_t GetVertexCount() const;
+    // The rest is only for finalized graphs
     size_t GetEdgeCount() const;
-    const Edge<Weight>& GetEdge(EdgeId edge_id) const;
+    Edge<Weight> GetEdge(EdgeId edge_id) const;
     IncidentEdgesRange GetIncidentEdges(VertexId vertex) const;
+    // The same vertices and edge ends under the same ids, only the weights may differ
+    bool HasSameEdges(const DirectedWeightedGraph& other) const;
 
-    void Serialize(GraphProto::DirectedWeightedGraph& proto) const;
-    static DirectedWeightedGraph Deserialize(const GraphProto::DirectedWeightedGraph& proto);
+    void Serialize(GraphProto::DirectedWeightedGraph& proto, BaseFile::Writer& base_file) const;
+    // The arrays are used in place, so the base file must outlive the graph
+    static DirectedWeightedGraph Deserialize(const GraphProto::DirectedWeightedGraph& proto,
+                                             const BaseFile::Reader& base_file);
 
    private:
-    std::vector<Edge<Weight>> edges_;
-    std::vector<IncidenceList> incidence_lists_;
+    using StoredId = uint32_t;  // halves the arrays, graphs are limited to 2^32 - 1 vertices and edges
+
+    size_t vertex_count_;
+    std::vector<Edge<Weight>> added_edges_;  // until finalized
+
+    // Filled when finalized, empty when the arrays are read from a base file.
+    // Vectors keep their buffers when moved, so the spans stay valid.
+    std::vector<StoredId> built_offsets_;
+    std::vector<StoredId> built_sources_;
+    std::vector<StoredId> built_targets_;
+    std::vector<Weight> built_weights_;
+
+    std::span<const StoredId> offsets_;  // vertex_count + 1 items, edges of a vertex are [offsets[v], offsets[v + 1])
+    std::span<const StoredId> sources_;
+    std::span<const StoredId> targets_;
+    std::span<const Weight> weights_;
   };
 
   template <typename Weight>
-  DirectedWeightedGraph<Weight>::DirectedWeightedGraph(size_t vertex_count) : incidence_lists_(vertex_count) {}
+  DirectedWeightedGraph<Weight>::DirectedWeightedGraph(size_t vertex_count) : vertex_count_(vertex_count) {}
 
   template <typename Weight>
   EdgeId DirectedWeightedGraph<Weight>::AddEdge(const Edge<Weight>& edge) {
-    edges_.push_back(edge);
-    const EdgeId id = edges_.size() - 1;
-    incidence_lists_[edge.from].push_back(id);
-    return id;
+    assert(offsets_.empty());
+    assert(edge.from < vertex_count_ && edge.to < vertex_count_);
+    added_edges_.push_back(edge);
+    return added_edges_.size() - 1;
+  }
+
+  template <typename Weight>
+  std::vector<EdgeId> DirectedWeightedGraph<Weight>::Finalize() {
+    assert(offsets_.empty());
+    constexpr size_t MAX_COUNT = std::numeric_limits<StoredId>::max();
+    if (vertex_count_ > MAX_COUNT || added_edges_.size() > MAX_COUNT) {
+      throw std::length_error("graph is too large: " + std::to_string(vertex_count_) + " vertices, " +
+                              std::to_string(added_edges_.size()) + " edges");
+    }
+    // Counting sort by the source vertex, stable for the edges of one vertex
+    built_offsets_.assign(vertex_count_ + 1, 0);
+    for (const auto& edge : added_edges_) {
+      ++built_offsets_[edge.from + 1];
+    }
+    for (size_t vertex = 0; vertex < vertex_count_; ++vertex) {
+      built_offsets_[vertex + 1] += built_offsets_[vertex];
+    }
+
+    std::vector<StoredId> next_ids(built_offsets_.begin(), built_offsets_.end() - 1);
+    std::vector<EdgeId> edge_ids;
+    edge_ids.reserve(added_edges_.size());
+    built_sources_.resize(added_edges_.size());
+    built_targets_.resize(added_edges_.size());
+    built_weights_.resize(added_edges_.size());
+    for (const auto& edge : added_edges_) {
+      const StoredId edge_id = next_ids[edge.from]++;
+      built_sources_[edge_id] = edge.from;
+      built_targets_[edge_id] = edge.to;
+      built_weights_[edge_id] = edge.weight;
+      edge_ids.push_back(edge_id);
+    }
+    added_edges_ = {};
+
+    offsets_ = built_offsets_;
+    sources_ = built_sources_;
+    targets_ = built_targets_;
+    weights_ = built_weights_;
+    return edge_ids;
   }
 
   template <typename Weight>
   size_t DirectedWeightedGraph<Weight>::GetVertexCount() const {
-    return incidence_lists_.size();
+    return vertex_count_;
   }
 
   template <typename Weight>
   size_t DirectedWeightedGraph<Weight>::GetEdgeCount() const {
-    return edges_.size();
+    return targets_.size();
   }
 
   template <typename Weight>
-  const Edge<Weight>& DirectedWeightedGraph<Weight>::GetEdge(EdgeId edge_id) const {
-    return edges_[edge_id];
+  Edge<Weight> DirectedWeightedGraph<Weight>::GetEdge(EdgeId edge_id) const {
+    return {sources_[edge_id], targets_[edge_id], weights_[edge_id]};
   }
 
   template <typename Weight>
   typename DirectedWeightedGraph<Weight>::IncidentEdgesRange DirectedWeightedGraph<Weight>::GetIncidentEdges(
       VertexId vertex) const {
-    const auto& edges = incidence_lists_[vertex];
-    return {std::begin(edges), std::end(edges)};
+    return IncidentEdgesRange(offsets_[vertex], offsets_[vertex + 1]);
   }
 
   template <typename Weight>
-  void DirectedWeightedGraph<Weight>::Serialize(GraphProto::DirectedWeightedGraph& proto) const {
-    static_assert(std::is_same_v<Weight, double>, "Serialization is implemented only for double weights");
-
-    for (const auto& edge : edges_) {
-      auto& edge_proto = *proto.add_edges();
-      edge_proto.set_from(edge.from);
-      edge_proto.set_to(edge.to);
-      edge_proto.set_weight(edge.weight);
-    }
+  bool DirectedWeightedGraph<Weight>::HasSameEdges(const DirectedWeightedGraph& other) const {
+    return vertex_count_ == other.vertex_count_ && std::ranges::equal(offsets_, other.offsets_) &&
+           std::ranges::equal(targets_, other.targets_);
+  }
 
-    for (const auto& incidence_list : incidence_lists_) {
-      auto& incidence_list_proto = *proto.add_incidence_lists();
-      for (const auto edge_id : incidence_list) {
-        incidence_list_proto.add_edge_ids(edge_id);
-      }
-    }
+  template <typename Weight>
+  void DirectedWeightedGraph<Weight>::Serialize(GraphProto::DirectedWeightedGraph& proto,
+                                                BaseFile::Writer& base_file) const {
+    static_assert(std::is_same_v<Weight, double>, "Serialization is implemented only for double weights");
+    static_assert(std::endian::native == std::endian::little, "Arrays are stored in little-endian byte order");
+
+    proto.set_vertex_count(vertex_count_);
+    proto.set_edge_count(GetEdgeCount());
+    proto.set_offsets_offset(base_file.AppendArray(offsets_));
+    proto.set_sources_offset(base_file.AppendArray(sources_));
+    proto.set_targets_offset(base_file.AppendArray(targets_));
+    proto.set_weights_offset(base_file.AppendArray(weights_));
   }
 
   template <typename Weight>
   DirectedWeightedGraph<Weight> DirectedWeightedGraph<Weight>::Deserialize(
-      const GraphProto::DirectedWeightedGraph& proto) {
+      const GraphProto::DirectedWeightedGraph& proto, const BaseFile::Reader& base_file) {
     static_assert(std::is_same_v<Weight, double>, "Serialization is implemented only for double weights");
+    static_assert(std::endian::native == std::endian::little, "Arrays are stored in little-endian byte order");
 
-    DirectedWeightedGraph graph;
-
-    graph.edges_.reserve(proto.edges_size());
-    for (const auto& edge_proto : proto.edges()) {
-      auto& edge = graph.edges_.emplace_back();
-      edge.from = edge_proto.from();
-      edge.to = edge_proto.to();
-      edge.weight = edge_proto.weight();
-    }
-
-    graph.incidence_lists_.reserve(proto.incidence_lists_size());
-    for (const auto& incidence_list_proto : proto.incidence_lists()) {
-      auto& incidence_list = graph.incidence_lists_.emplace_back();
-      incidence_list.reserve(incidence_list_proto.edge_ids_size());
-      for (const auto edge_id : incidence_list_proto.edge_ids()) {
-        incidence_list.push_back(edge_id);
-      }
-    }
-
+    DirectedWeightedGraph graph(proto.vertex_count());
+    graph.offsets_ = base_file.GetArray<StoredId>(proto.offsets_offset(), proto.vertex_count() + 1);
+    graph.sources_ = base_file.GetArray<StoredId>(proto.sources_offset(), proto.edge_count());
+    graph.targets_ = base_file.GetArray<StoredId>(proto.targets_offset(), proto.edge_count());
+    graph.weights_ = base_file.GetArray<Weight>(proto.weights_offset(), proto.edge_count());
     return graph;
   }
 }  // namespace Graph
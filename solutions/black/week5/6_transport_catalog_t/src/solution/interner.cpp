@@ -0,0 +1,49 @@
+#include "interner.h"
+
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+
+using namespace std;
+
+Interner::Interner(vector<string> names) : names_(move(names)) {
+  sort(begin(names_), end(names_));
+  names_.erase(unique(begin(names_), end(names_)), end(names_));
+}
+
+optional<Interner::Id> Interner::FindId(string_view name) const {
+  const auto it = lower_bound(begin(names_), end(names_), name);
+  if (it == end(names_) || *it != name) {
+    return nullopt;
+  }
+  return static_cast<Id>(it - begin(names_));
+}
+
+Interner::Id Interner::GetId(string_view name) const {
+  if (const auto id = FindId(name)) {
+    return *id;
+  }
+  throw out_of_range("unknown name: " + string(name));
+}
+
+vector<Interner::Id> Interner::GetIds(const vector<string>& names) const {
+  vector<Id> ids;
+  ids.reserve(names.size());
+  for (const string& name : names) {
+    ids.push_back(GetId(name));
+  }
+  return ids;
+}
+
+void Interner::Serialize(google::protobuf::RepeatedPtrField<string>& proto) const {
+  proto.Reserve(static_cast<int>(names_.size()));
+  for (const string& name : names_) {
+    *proto.Add() = name;
+  }
+}
+
+Interner Interner::Deserialize(const google::protobuf::RepeatedPtrField<string>& proto) {
+  Interner interner;
+  interner.names_.assign(begin(proto), end(proto));  // stored sorted and distinct
+  return interner;
+}
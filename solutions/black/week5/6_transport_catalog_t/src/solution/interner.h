@@ -0,0 +1,43 @@
+#pragma once
+
+#include <google/protobuf/repeated_field.h>
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Dense ids for a fixed set of names. Ids follow the alphabetical order of the names,
+// so maps keyed by names turn into vectors indexed by ids without changing the iteration order.
+class Interner {
+ public:
+  using Id = uint32_t;
+
+  Interner() = default;
+  // Repeated names get a single id
+  explicit Interner(std::vector<std::string> names);
+
+  size_t GetSize() const { return names_.size(); }
+  const std::string& GetName(Id id) const { return names_[id]; }
+
+  std::optional<Id> FindId(std::string_view name) const;
+  // Throws std::out_of_range for unknown names, like map::at
+  Id GetId(std::string_view name) const;
+  std::vector<Id> GetIds(const std::vector<std::string>& names) const;
+
+  void Serialize(google::protobuf::RepeatedPtrField<std::string>& proto) const;
+  static Interner Deserialize(const google::protobuf::RepeatedPtrField<std::string>& proto);
+
+ private:
+  std::vector<std::string> names_;
+};
+
+using StopId = Interner::Id;
+using BusId = Interner::Id;
+
+// Names are kept once for the whole catalog, its parts store ids only
+struct CatalogNames {
+  Interner stops;
+  Interner buses;
+};
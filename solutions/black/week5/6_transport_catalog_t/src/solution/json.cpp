@@ -1,119 +1,222 @@
 #include "json.h"
 
+#include <array>
+#include <cctype>
+#include <charconv>
+#include <stdexcept>
+
 using namespace std;
 
 namespace Json {
 
-  Node LoadArray(istream& input) {
-    vector<Node> result;
-
-    for (char c; input >> c && c != ']';) {
-      if (c != ',') {
-        input.putback(c);
+  Node Parser::ParseNode() {
+    switch (PeekToken()) {
+      case '[': {
+        Array result;
+        ParseArray([this, &result] { result.push_back(ParseNode()); });
+        return Node(move(result));
       }
-      result.push_back(LoadNode(input));
+      case '{': {
+        Dict result;
+        ParseDict([this, &result](string key) { result.emplace(move(key), ParseNode()); });
+        return Node(move(result));
+      }
+      case '"':
+        return Node(ParseString());
+      case 't':
+      case 'f':
+        return ParseBool();
+      default:
+        return ParseNumber();
     }
+  }
 
-    return Node(move(result));
+  bool Parser::IsEnd() {
+    while (pos_ < input_.size() && isspace(static_cast<unsigned char>(input_[pos_]))) {
+      ++pos_;
+    }
+    return pos_ == input_.size();
   }
 
-  Node LoadBool(istream& input) {
-    string s;
-    while (isalpha(input.peek())) {
-      s.push_back(static_cast<char>(input.get()));
+  char Parser::PeekToken() {
+    if (IsEnd()) {
+      Fail("unexpected end of input");
     }
-    return Node(s == "true");
+    return input_[pos_];
   }
 
-  Node LoadNumber(istream& input) {
-    bool is_negative = false;
-    if (input.peek() == '-') {
-      is_negative = true;
-      input.get();
+  void Parser::Expect(char c) {
+    if (PeekToken() != c) {
+      Fail(string("expected '") + c + "'");
     }
-    int int_part = 0;
-    while (isdigit(input.peek())) {
-      int_part *= 10;
-      int_part += input.get() - '0';
+    ++pos_;
+  }
+
+  string Parser::ParseString() {
+    Expect('"');
+    string result;
+    while (true) {
+      const size_t special_pos = input_.find_first_of("\"\\", pos_);
+      if (special_pos == string_view::npos) {
+        Fail("unterminated string");
+      }
+      result.append(input_.substr(pos_, special_pos - pos_));
+      pos_ = special_pos + 1;
+      if (input_[special_pos] == '"') {
+        return result;
+      }
+      if (pos_ == input_.size()) {
+        Fail("unterminated string");
+      }
+      switch (const char escaped = input_[pos_++]) {
+        case 'n': result.push_back('\n'); break;
+        case 't': result.push_back('\t'); break;
+        case 'r': result.push_back('\r'); break;
+        case 'b': result.push_back('\b'); break;
+        case 'f': result.push_back('\f'); break;
+        case 'u': {
+          uint32_t code_point = ParseHexQuad();
+          if (code_point >= 0xD800 && code_point < 0xDC00 && input_.substr(pos_, 2) == "\\u") {
+            pos_ += 2;
+            code_point = 0x10000 + ((code_point - 0xD800) << 10) + (ParseHexQuad() - 0xDC00);
+          }
+          AppendCodePoint(code_point, result);
+          break;
+        }
+        default:
+          result.push_back(escaped);  // '"', '\\' and '/' stand for themselves
+      }
     }
-    if (input.peek() != '.') {
-      return Node(int_part * (is_negative ? -1 : 1));
+  }
+
+  uint32_t Parser::ParseHexQuad() {
+    uint32_t value = 0;
+    if (pos_ + 4 > input_.size()) {
+      Fail("truncated \\u escape");
     }
-    input.get();  // '.'
-    double result = int_part;
-    double frac_mult = 0.1;
-    while (isdigit(input.peek())) {
-      result += frac_mult * (input.get() - '0');
-      frac_mult /= 10;
+    const auto [end, error] = from_chars(input_.data() + pos_, input_.data() + pos_ + 4, value, 16);
+    if (error != errc() || end != input_.data() + pos_ + 4) {
+      Fail("bad \\u escape");
     }
-    return Node(result * (is_negative ? -1 : 1));
+    pos_ += 4;
+    return value;
   }
 
-  Node LoadString(istream& input) {
-    string line;
-    string part;
-    getline(input, part, '"');
-
-    if (part.back() != '\\') {
-      line = move(part);
+  void Parser::AppendCodePoint(uint32_t code_point, string& output) {
+    if (code_point < 0x80) {
+      output.push_back(static_cast<char>(code_point));
+    } else if (code_point < 0x800) {
+      output.push_back(static_cast<char>(0xC0 | (code_point >> 6)));
+      output.push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
+    } else if (code_point < 0x10000) {
+      output.push_back(static_cast<char>(0xE0 | (code_point >> 12)));
+      output.push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3F)));
+      output.push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
     } else {
-      while (input && part.back() == '\\') {
-        part.back() = '"';
-        line += part;
-        getline(input, part, '"');
-      }
-      line += part;
+      output.push_back(static_cast<char>(0xF0 | (code_point >> 18)));
+      output.push_back(static_cast<char>(0x80 | ((code_point >> 12) & 0x3F)));
+      output.push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3F)));
+      output.push_back(static_cast<char>(0x80 | (code_point & 0x3F)));
     }
-
-    return Node(move(line));
   }
 
-  Node LoadDict(istream& input) {
-    Dict result;
-
-    for (char c; input >> c && c != '}';) {
-      if (c == ',') {
-        input >> c;
+  Node Parser::ParseNumber() {
+    const size_t begin = pos_;
+    bool is_integer = true;
+    for (; pos_ < input_.size(); ++pos_) {
+      const char c = input_[pos_];
+      if (c == '.' || c == 'e' || c == 'E') {
+        is_integer = false;
+      } else if (!isdigit(static_cast<unsigned char>(c)) && c != '-' && c != '+') {
+        break;
       }
-
-      string key = LoadString(input).AsString();
-      input >> c;
-      result.emplace(move(key), LoadNode(input));
     }
+    const char* const first = input_.data() + begin;
+    const char* const last = input_.data() + pos_;
+    if (is_integer) {
+      int value = 0;
+      if (const auto [end, error] = from_chars(first, last, value); error == errc() && end == last) {
+        return Node(value);
+      }
+      // doesn't fit int, falls back to double
+    }
+    double value = 0;
+    if (const auto [end, error] = from_chars(first, last, value); error != errc() || end != last) {
+      pos_ = begin;
+      Fail("bad number");
+    }
+    return Node(value);
+  }
 
-    return Node(move(result));
+  Node Parser::ParseBool() {
+    if (input_.substr(pos_, 4) == "true") {
+      pos_ += 4;
+      return Node(true);
+    }
+    if (input_.substr(pos_, 5) == "false") {
+      pos_ += 5;
+      return Node(false);
+    }
+    Fail("bad literal");
   }
 
-  Node LoadNode(istream& input) {
-    char c;
-    input >> c;
+  void Parser::Fail(const string& message) const {
+    throw invalid_argument("JSON: " + message + " at offset " + to_string(pos_));
+  }
 
-    if (c == '[') {
-      return LoadArray(input);
-    } else if (c == '{') {
-      return LoadDict(input);
-    } else if (c == '"') {
-      return LoadString(input);
-    } else if (c == 't' || c == 'f') {
-      input.putback(c);
-      return LoadBool(input);
-    } else {
-      input.putback(c);
-      return LoadNumber(input);
+  string ReadAll(istream& input) {
+    string result;
+    array<char, 1 << 16> buffer;
+    while (input.read(buffer.data(), buffer.size()) || input.gcount() > 0) {
+      result.append(buffer.data(), input.gcount());
     }
+    return result;
   }
 
-  Document Load(istream& input) { return Document{LoadNode(input)}; }
+  Document Load(string_view input) { return Document{Parser(input).ParseNode()}; }
+
+  Document Load(istream& input) { return Load(ReadAll(input)); }
+
+  void AppendEscaped(string& buffer, string_view value) {
+    static constexpr string_view HEX_DIGITS = "0123456789abcdef";
+    size_t copied_size = 0;
+    for (size_t pos = 0; pos < value.size(); ++pos) {
+      const auto c = static_cast<unsigned char>(value[pos]);
+      if (c >= 0x20 && c != '"' && c != '\\') {
+        continue;
+      }
+      buffer.append(value.substr(copied_size, pos - copied_size));
+      copied_size = pos + 1;
+      buffer += '\\';
+      switch (c) {
+        case '"': buffer += '"'; break;
+        case '\\': buffer += '\\'; break;
+        case '\n': buffer += 'n'; break;
+        case '\t': buffer += 't'; break;
+        case '\r': buffer += 'r'; break;
+        case '\b': buffer += 'b'; break;
+        case '\f': buffer += 'f'; break;
+        default:
+          buffer += "u00";
+          buffer += HEX_DIGITS[c >> 4];
+          buffer += HEX_DIGITS[c & 0xF];
+      }
+    }
+    buffer.append(value.substr(copied_size));
+  }
 
   template <>
   void PrintValue<string>(const string& value, ostream& output) {
+    string literal = "\"";
+    AppendEscaped(literal, value);
+    literal += '"';
+    output << literal;
+  }
+
+  template <>
+  void PrintValue<EscapedString>(const EscapedString& value, ostream& output) {
     output << '"';
-    for (const char c : value) {
-      if (c == '"' || c == '\\') {
-        output << '\\';
-      }
-      output << c;
-    }
+    output.write(value.value.data(), value.value.size());
     output << '"';
   }
 
@@ -168,6 +271,97 @@ namespace Json {
     return output;
   }
 
+  void Writer::BeginItem() {
+    if (after_key_) {
+      after_key_ = false;
+    } else if (!first_item_) {
+      buffer_ += ", ";
+    }
+    first_item_ = false;
+  }
+
+  Writer& Writer::BeginArray() {
+    BeginItem();
+    buffer_ += '[';
+    first_item_ = true;
+    return *this;
+  }
+
+  Writer& Writer::EndArray() {
+    buffer_ += ']';
+    first_item_ = false;
+    return *this;
+  }
+
+  Writer& Writer::BeginDict() {
+    BeginItem();
+    buffer_ += '{';
+    first_item_ = true;
+    return *this;
+  }
+
+  Writer& Writer::EndDict() {
+    buffer_ += '}';
+    first_item_ = false;
+    return *this;
+  }
+
+  Writer& Writer::Key(string_view key) {
+    BeginItem();
+    buffer_ += '"';
+    buffer_ += key;
+    buffer_ += "\": ";
+    after_key_ = true;
+    return *this;
+  }
+
+  Writer& Writer::Value(int value) {
+    BeginItem();
+    char chars[16];
+    const auto result = to_chars(begin(chars), end(chars), value);
+    buffer_.append(chars, result.ptr);
+    return *this;
+  }
+
+  Writer& Writer::Value(double value) {
+    BeginItem();
+    char chars[32];
+    // Same as the default stream output
+    const auto result = to_chars(begin(chars), end(chars), value, chars_format::general, 6);
+    buffer_.append(chars, result.ptr);
+    return *this;
+  }
+
+  Writer& Writer::Value(bool value) {
+    BeginItem();
+    buffer_ += value ? "true" : "false";
+    return *this;
+  }
+
+  Writer& Writer::Value(string_view value) {
+    BeginItem();
+    buffer_ += '"';
+    AppendEscaped(buffer_, value);
+    buffer_ += '"';
+    return *this;
+  }
+
+  Writer& Writer::Value(const EscapedString& value) {
+    BeginItem();
+    buffer_ += '"';
+    buffer_ += value.value;
+    buffer_ += '"';
+    return *this;
+  }
+
+  Writer& Writer::Fields(string_view fields) {
+    if (!fields.empty()) {
+      BeginItem();
+      buffer_ += fields;
+    }
+    return *this;
+  }
+
   bool operator==(const Document& lhs, const Document& rhs) {
     stringstream output_lhs, output_rhs;
     PrintValue(lhs, output_lhs);
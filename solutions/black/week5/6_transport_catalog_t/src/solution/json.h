@@ -1,9 +1,11 @@
 #pragma once
 
+#include <cstdint>
 #include <iostream>
 #include <map>
 #include <sstream>
 #include <string>
+#include <string_view>
 #include <utility>
 #include <variant>
 #include <vector>
@@ -14,7 +16,13 @@ namespace Json {
   using Array = std::vector<Node>;
   using Dict = std::map<std::string, Node>;
 
-  class Node : std::variant<Array, Dict, bool, int, double, std::string> {
+  // String contents already escaped for a JSON literal, printed as is.
+  // Lets large generated texts be escaped while they are produced instead of in a separate pass.
+  struct EscapedString {
+    std::string value;
+  };
+
+  class Node : std::variant<Array, Dict, bool, int, double, std::string, EscapedString> {
    public:
     using variant::variant;
     const variant& GetBase() const { return *this; }
@@ -49,8 +57,88 @@ namespace Json {
     Node root;
   };
 
-  Node LoadNode(std::istream& input);
+  // Parses JSON right from a contiguous buffer. Besides building whole nodes it walks arrays
+  // and objects item by item, so that callers may consume a large input without keeping it as one tree.
+  // Throws std::invalid_argument on malformed input.
+  class Parser {
+   public:
+    explicit Parser(std::string_view input) : input_(input) {}
+
+    Node ParseNode();
+
+    // on_item() must consume exactly one node
+    template <typename OnItem>
+    void ParseArray(OnItem on_item);
+
+    // on_member(key) must consume exactly one node, the value
+    template <typename OnMember>
+    void ParseDict(OnMember on_member);
+
+    bool IsEnd();
+
+   private:
+    char PeekToken();
+    void Expect(char c);
+    std::string ParseString();
+    Node ParseNumber();
+    Node ParseBool();
+    void AppendCodePoint(uint32_t code_point, std::string& output);
+    uint32_t ParseHexQuad();
+    [[noreturn]] void Fail(const std::string& message) const;
+
+    std::string_view input_;
+    size_t pos_ = 0;
+  };
+
+  template <typename OnItem>
+  void Parser::ParseArray(OnItem on_item) {
+    Expect('[');
+    if (PeekToken() == ']') {
+      ++pos_;
+      return;
+    }
+    while (true) {
+      on_item();
+      if (PeekToken() == ',') {
+        ++pos_;
+        continue;
+      }
+      Expect(']');
+      return;
+    }
+  }
+
+  template <typename OnMember>
+  void Parser::ParseDict(OnMember on_member) {
+    Expect('{');
+    if (PeekToken() == '}') {
+      ++pos_;
+      return;
+    }
+    while (true) {
+      if (PeekToken() != '"') {
+        Fail("expected a key");
+      }
+      std::string key = ParseString();
+      Expect(':');
+      on_member(std::move(key));
+      if (PeekToken() == ',') {
+        ++pos_;
+        continue;
+      }
+      Expect('}');
+      return;
+    }
+  }
 
+  // Reads the whole stream
+  std::string ReadAll(std::istream& input);
+
+  // Appends the contents of a JSON string literal: quotes, backslashes and control characters are escaped,
+  // the rest is copied as is
+  void AppendEscaped(std::string& buffer, std::string_view value);
+
+  Document Load(std::string_view input);
   Document Load(std::istream& input);
 
   void PrintNode(const Node& node, std::ostream& output);
@@ -63,6 +151,9 @@ namespace Json {
   template <>
   void PrintValue<std::string>(const std::string& value, std::ostream& output);
 
+  template <>
+  void PrintValue<EscapedString>(const EscapedString& value, std::ostream& output);
+
   template <>
   void PrintValue<bool>(const bool& value, std::ostream& output);
 
@@ -79,5 +170,36 @@ namespace Json {
 
   std::ostream& operator<<(std::ostream& output, const Document& rhs);
 
+  // Writes JSON right into a buffer as it goes, without building nodes first.
+  // Output matches PrintNode, except that dict keys come in the order they are written.
+  class Writer {
+   public:
+    explicit Writer(std::string& buffer) : buffer_(buffer) {}
+
+    Writer& BeginArray();
+    Writer& EndArray();
+    Writer& BeginDict();
+    Writer& EndDict();
+
+    // Keys are written as is, so they must need no escaping
+    Writer& Key(std::string_view key);
+
+    Writer& Value(int value);
+    Writer& Value(double value);
+    Writer& Value(bool value);
+    Writer& Value(std::string_view value);
+    Writer& Value(const char* value) { return Value(std::string_view(value)); }
+    Writer& Value(const EscapedString& value);
+    // Dict fields written by another writer, appended to the current dict as is
+    Writer& Fields(std::string_view fields);
+
+   private:
+    void BeginItem();
+
+    std::string& buffer_;
+    bool first_item_ = true;
+    bool after_key_ = false;
+  };
+
   bool operator==(const Document& lhs, const Document& rhs);
 }  // namespace Json
@@ -1,3 +1,4 @@
+#include <exception>
 #include <iostream>
 #include <string_view>
 
@@ -7,16 +8,25 @@ using namespace std;
 
 int main(int argc, const char* argv[]) {
   if (argc != 2) {
-    cerr << "Usage: transport_catalog_part_q [make_base|process_requests]\n";
+    cerr << "Usage: transport_catalog_part_q [make_base|update_base|process_requests|serve_requests]\n";
     return 5;
   }
 
   const string_view mode(argv[1]);
 
-  if (mode == "process_requests") {
-    ProcessRequests(cin, cout);
-  } else if (mode == "make_base") {
-    MakeBase(cin);
+  try {
+    if (mode == "process_requests") {
+      ProcessRequests(cin, cout);
+    } else if (mode == "make_base") {
+      MakeBase(cin);
+    } else if (mode == "update_base") {
+      UpdateBase(cin);
+    } else if (mode == "serve_requests") {
+      ServeRequests(cin, cout);
+    }
+  } catch (const exception& e) {
+    cerr << mode << " failed: " << e.what() << '\n';
+    return 1;
   }
 
   return 0;
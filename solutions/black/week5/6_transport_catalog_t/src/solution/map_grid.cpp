@@ -0,0 +1,61 @@
+#include "map_grid.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <limits>
+
+using namespace std;
+
+MapArea MapArea::Around(Svg::Point lhs, Svg::Point rhs) {
+  return {{std::min(lhs.x, rhs.x), std::min(lhs.y, rhs.y)}, {std::max(lhs.x, rhs.x), std::max(lhs.y, rhs.y)}};
+}
+
+static constexpr size_t ITEMS_PER_CELL = 4;
+static constexpr size_t MAX_CELLS_PER_SIDE = 1024;
+
+MapGrid::MapGrid(MapArea bounds, size_t expected_item_count) : bounds_(bounds) {
+  const auto cells_per_side =
+      static_cast<size_t>(ceil(sqrt(static_cast<double>(expected_item_count) / ITEMS_PER_CELL)));
+  columns_ = rows_ = clamp<size_t>(cells_per_side, 1, MAX_CELLS_PER_SIDE);
+  cell_width_ = max((bounds_.max.x - bounds_.min.x) / columns_, numeric_limits<double>::min());
+  cell_height_ = max((bounds_.max.y - bounds_.min.y) / rows_, numeric_limits<double>::min());
+  cells_.assign(columns_ * rows_, {});
+}
+
+size_t MapGrid::GetColumn(double x) const {
+  const double column = floor((x - bounds_.min.x) / cell_width_);
+  return static_cast<size_t>(clamp(column, 0.0, static_cast<double>(columns_ - 1)));
+}
+
+size_t MapGrid::GetRow(double y) const {
+  const double row = floor((y - bounds_.min.y) / cell_height_);
+  return static_cast<size_t>(clamp(row, 0.0, static_cast<double>(rows_ - 1)));
+}
+
+void MapGrid::Insert(ItemId item, MapArea box) {
+  for (size_t row = GetRow(box.min.y); row <= GetRow(box.max.y); ++row) {
+    for (size_t column = GetColumn(box.min.x); column <= GetColumn(box.max.x); ++column) {
+      cells_[row * columns_ + column].push_back({item, box});
+    }
+  }
+}
+
+vector<MapGrid::ItemId> MapGrid::Find(MapArea area) const {
+  vector<ItemId> result;
+  if (!area.Intersects(bounds_)) {
+    return result;
+  }
+  for (size_t row = GetRow(area.min.y); row <= GetRow(area.max.y); ++row) {
+    for (size_t column = GetColumn(area.min.x); column <= GetColumn(area.max.x); ++column) {
+      for (const Entry& entry : cells_[row * columns_ + column]) {
+        if (entry.box.Intersects(area)) {
+          result.push_back(entry.item);
+        }
+      }
+    }
+  }
+  sort(begin(result), end(result));
+  result.erase(unique(begin(result), end(result)), end(result));
+  return result;
+}
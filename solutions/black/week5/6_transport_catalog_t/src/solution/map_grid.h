@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "svg.h"
+
+// Axis-aligned box in map coordinates
+struct MapArea {
+  Svg::Point min;
+  Svg::Point max;
+
+  bool Intersects(const MapArea& other) const {
+    return min.x <= other.max.x && other.min.x <= max.x && min.y <= other.max.y && other.min.y <= max.y;
+  }
+
+  static MapArea Around(Svg::Point lhs, Svg::Point rhs);
+};
+
+// Part of a map split into 2^zoom columns and 2^zoom rows, x and y count from the top left tile
+struct MapTile {
+  static constexpr uint32_t MAX_ZOOM = 30;  // keeps 2^zoom tiles per side within uint32_t
+
+  uint32_t zoom;
+  uint32_t x;
+  uint32_t y;
+};
+
+// Uniform grid spatial index: every item is kept in the cells its box covers,
+// so an area query only looks at items near that area
+class MapGrid {
+ public:
+  using ItemId = uint32_t;
+
+  MapGrid() = default;
+  // Cells are sized to hold a few of the expected items each
+  MapGrid(MapArea bounds, size_t expected_item_count);
+
+  // One item may be inserted with several boxes, e.g. a polyline segment by segment
+  void Insert(ItemId item, MapArea box);
+
+  // Ids of items with a box intersecting the area, each once and in ascending order
+  std::vector<ItemId> Find(MapArea area) const;
+
+ private:
+  struct Entry {
+    ItemId item;
+    MapArea box;
+  };
+
+  size_t GetColumn(double x) const;
+  size_t GetRow(double y) const;
+
+  MapArea bounds_ = {};
+  size_t columns_ = 1;
+  size_t rows_ = 1;
+  double cell_width_ = 1;
+  double cell_height_ = 1;
+  std::vector<std::vector<Entry>> cells_ = std::vector<std::vector<Entry>>(1);
+};
@@ -1,31 +1,82 @@
 #include "map_renderer.h"
 
 #include <algorithm>
+#include <cmath>
 #include <iterator>
 
 #include "map_renderer_helpers.h"
+#include "metrics.h"
 #include "sphere.h"
 #include "svg_serialize.h"
 
 using namespace std;
 
 MapRenderer::MapRenderer(const Descriptions::StopsDict& stops_dict, const Descriptions::BusesDict& buses_dict,
-                         const YellowPages::Database& yellow_pages, const Json::Dict& render_settings_json)
+                         shared_ptr<const CatalogNames> names, const YellowPages::Database& yellow_pages,
+                         const Json::Dict& render_settings_json)
     : render_settings_(RenderSettings::Parse(render_settings_json)),
-      bus_colors_(ChooseBusColors(buses_dict, render_settings_)),
-      buses_dict_(CopyBusesDict(buses_dict)) {
+      names_(move(names)),
+      bus_colors_(ChooseBusColors(buses_dict, render_settings_)) {
   CoordsMapping mapping = ComputeStopsCoordsByGrid(stops_dict, buses_dict, yellow_pages, render_settings_);
-  stops_coords_ = move(mapping.stops);
+  stops_coords_.resize(names_->stops.GetSize());
+  for (const auto& [stop_name, point] : mapping.stops) {
+    stops_coords_[names_->stops.GetId(stop_name)] = point;
+  }
   companies_coords_ = move(mapping.companies);
+
+  buses_.resize(names_->buses.GetSize());
+  for (const auto& [bus_name, bus] : buses_dict) {
+    BusRoute& route = buses_[names_->buses.GetId(bus_name)];
+    route.stops.reserve(bus->stops.size());
+    for (const string& stop_name : bus->stops) {
+      route.stops.push_back(names_->stops.GetId(stop_name));
+    }
+    for (const string& stop_name : bus->endpoints) {
+      route.endpoints.push_back(names_->stops.GetId(stop_name));
+    }
+  }
+
+  FillAllObjects();
+}
+
+void MapRenderer::FillAllObjects() {
+  for (StopId stop_id = 0; stop_id < stops_coords_.size(); ++stop_id) {
+    all_objects_.stops.push_back(stop_id);
+  }
+  for (BusId bus_id = 0; bus_id < buses_.size(); ++bus_id) {
+    all_objects_.buses.push_back(bus_id);
+  }
+}
+
+void MapRenderer::BuildGrids() const {
+  METRICS_SPAN("map: building grids");
+  const MapArea bounds = {{0, 0}, {render_settings_.max_width, render_settings_.max_height}};
+
+  stops_grid_ = MapGrid(bounds, stops_coords_.size());
+  for (StopId stop_id = 0; stop_id < stops_coords_.size(); ++stop_id) {
+    stops_grid_.Insert(stop_id, {stops_coords_[stop_id], stops_coords_[stop_id]});
+  }
+
+  size_t segment_count = 0;
+  for (const auto& bus : buses_) {
+    segment_count += bus.stops.size();
+  }
+  buses_grid_ = MapGrid(bounds, segment_count);
+  for (BusId bus_id = 0; bus_id < buses_.size(); ++bus_id) {
+    const auto& stops = buses_[bus_id].stops;
+    for (size_t stop_idx = 0; stop_idx < stops.size(); ++stop_idx) {
+      const Svg::Point point = stops_coords_[stops[stop_idx]];
+      const Svg::Point next_point = stops_coords_[stops[min(stop_idx + 1, stops.size() - 1)]];
+      buses_grid_.Insert(bus_id, MapArea::Around(point, next_point));
+    }
+  }
 }
 
 void MapRenderer::Serialize(TCProto::MapRenderer& proto) {
   render_settings_.Serialize(*proto.mutable_render_settings());
 
-  for (const auto& [name, point] : stops_coords_) {
-    auto& stop_coords_proto = *proto.add_stops_coords();
-    stop_coords_proto.set_name(name);
-    Svg::SerializePoint(point, *stop_coords_proto.mutable_point());
+  for (const Svg::Point point : stops_coords_) {
+    Svg::SerializePoint(point, *proto.add_stops_points());
   }
 
   for (const auto& [name, point] : companies_coords_) {
@@ -34,25 +85,28 @@ void MapRenderer::Serialize(TCProto::MapRenderer& proto) {
     Svg::SerializePoint(point, *companies_coords_proto.mutable_point());
   }
 
-  for (const auto& [name, color] : bus_colors_) {
-    auto& bus_color_proto = *proto.add_bus_colors();
-    bus_color_proto.set_name(name);
-    Svg::SerializeColor(color, *bus_color_proto.mutable_color());
+  for (const auto& color : bus_colors_) {
+    Svg::SerializeColor(color, *proto.add_bus_colors());
   }
 
-  for (const auto& [_, bus] : buses_dict_) {
-    bus.Serialize(*proto.add_bus_descriptions());
+  for (const auto& bus : buses_) {
+    auto& bus_proto = *proto.add_bus_descriptions();
+    bus_proto.mutable_stops()->Add(begin(bus.stops), end(bus.stops));
+    bus_proto.mutable_endpoints()->Add(begin(bus.endpoints), end(bus.endpoints));
   }
 }
 
-std::unique_ptr<MapRenderer> MapRenderer::Deserialize(const TCProto::MapRenderer& proto) {
+std::unique_ptr<MapRenderer> MapRenderer::Deserialize(const TCProto::MapRenderer& proto,
+                                                      shared_ptr<const CatalogNames> names) {
   std::unique_ptr<MapRenderer> renderer_holder(new MapRenderer);
   auto& renderer = *renderer_holder;
 
   renderer.render_settings_ = RenderSettings::Deserialize(proto.render_settings());
+  renderer.names_ = move(names);
 
-  for (const auto& stop_coords_proto : proto.stops_coords()) {
-    renderer.stops_coords_.emplace(stop_coords_proto.name(), Svg::DeserializePoint(stop_coords_proto.point()));
+  renderer.stops_coords_.reserve(proto.stops_points_size());
+  for (const auto& point_proto : proto.stops_points()) {
+    renderer.stops_coords_.push_back(Svg::DeserializePoint(point_proto));
   }
 
   for (const auto& companies_coords_proto : proto.companies_coords()) {
@@ -60,14 +114,21 @@ std::unique_ptr<MapRenderer> MapRenderer::Deserialize(const TCProto::MapRenderer
                                        Svg::DeserializePoint(companies_coords_proto.point()));
   }
 
-  for (const auto& bus_color_proto : proto.bus_colors()) {
-    renderer.bus_colors_.emplace(bus_color_proto.name(), Svg::DeserializeColor(bus_color_proto.color()));
+  renderer.bus_colors_.reserve(proto.bus_colors_size());
+  for (const auto& color_proto : proto.bus_colors()) {
+    renderer.bus_colors_.push_back(Svg::DeserializeColor(color_proto));
   }
 
+  renderer.buses_.reserve(proto.bus_descriptions_size());
   for (const auto& bus_proto : proto.bus_descriptions()) {
-    renderer.buses_dict_.emplace(bus_proto.name(), Descriptions::Bus::Deserialize(bus_proto));
+    renderer.buses_.push_back({
+        {begin(bus_proto.stops()), end(bus_proto.stops())},
+        {begin(bus_proto.endpoints()), end(bus_proto.endpoints())},
+    });
   }
 
+  renderer.FillAllObjects();
+
   return renderer_holder;
 }
 
@@ -75,19 +136,19 @@ using RouteBusItem = TransportRouter::RouteInfo::RideBusItem;
 using RouteWaitItem = TransportRouter::RouteInfo::WaitBusItem;
 using WalkToCompanyItem = TransportRouter::RouteInfo::WalkToCompanyItem;
 
-void MapRenderer::RenderBusLines(Svg::Document& svg) const {
-  for (const auto& [bus_name, bus] : buses_dict_) {
-    const auto& stops = bus.stops;
+void MapRenderer::RenderBusLines(Svg::Document& svg, const MapObjects& objects) const {
+  for (const BusId bus_id : objects.buses) {
+    const auto& stops = buses_[bus_id].stops;
     if (stops.empty()) {
       continue;
     }
     Svg::Polyline line;
-    line.SetStrokeColor(bus_colors_.at(bus_name))
+    line.SetStrokeColor(bus_colors_[bus_id])
         .SetStrokeWidth(render_settings_.line_width)
         .SetStrokeLineCap("round")
         .SetStrokeLineJoin("round");
-    for (const auto& stop_name : stops) {
-      line.AddPoint(stops_coords_.at(stop_name));
+    for (const StopId stop_id : stops) {
+      line.AddPoint(stops_coords_[stop_id]);
     }
     svg.Add(line);
   }
@@ -99,34 +160,32 @@ void MapRenderer::RenderRouteBusLines(Svg::Document& svg, const TransportRouter:
       continue;
     }
     const auto& bus_item = get<RouteBusItem>(item);
-    const string& bus_name = bus_item.bus_name;
-    const auto& stops = buses_dict_.at(bus_name).stops;
+    const auto& stops = buses_[bus_item.bus_id].stops;
     if (stops.empty()) {
       continue;
     }
     Svg::Polyline line;
-    line.SetStrokeColor(bus_colors_.at(bus_name))
+    line.SetStrokeColor(bus_colors_[bus_item.bus_id])
         .SetStrokeWidth(render_settings_.line_width)
         .SetStrokeLineCap("round")
         .SetStrokeLineJoin("round");
     for (size_t stop_idx = bus_item.start_stop_idx; stop_idx <= bus_item.finish_stop_idx; ++stop_idx) {
-      const string& stop_name = stops[stop_idx];
-      line.AddPoint(stops_coords_.at(stop_name));
+      line.AddPoint(stops_coords_[stops[stop_idx]]);
     }
     svg.Add(line);
   }
 }
 
-void MapRenderer::RenderBusLabel(Svg::Document& svg, const string& bus_name, const string& stop_name) const {
-  const auto& color = bus_colors_.at(bus_name);  // can be optimized a bit by moving upper
-  const auto point = stops_coords_.at(stop_name);
+void MapRenderer::RenderBusLabel(Svg::Document& svg, BusId bus_id, StopId stop_id) const {
+  const auto& color = bus_colors_[bus_id];
+  const auto point = stops_coords_[stop_id];
   const auto base_text = Svg::Text{}
                              .SetPoint(point)
                              .SetOffset(render_settings_.bus_label_offset)
                              .SetFontSize(render_settings_.bus_label_font_size)
                              .SetFontFamily("Verdana")
                              .SetFontWeight("bold")
-                             .SetData(bus_name);
+                             .SetData(names_->buses.GetName(bus_id));
   svg.Add(Svg::Text(base_text)
               .SetFillColor(render_settings_.underlayer_color)
               .SetStrokeColor(render_settings_.underlayer_color)
@@ -136,12 +195,12 @@ void MapRenderer::RenderBusLabel(Svg::Document& svg, const string& bus_name, con
   svg.Add(Svg::Text(base_text).SetFillColor(color));
 }
 
-void MapRenderer::RenderBusLabels(Svg::Document& svg) const {
-  for (const auto& [bus_name, bus] : buses_dict_) {
-    const auto& stops = bus.stops;
-    if (!stops.empty()) {
-      for (const string& endpoint : bus.endpoints) {
-        RenderBusLabel(svg, bus_name, endpoint);
+void MapRenderer::RenderBusLabels(Svg::Document& svg, const MapObjects& objects) const {
+  for (const BusId bus_id : objects.buses) {
+    const auto& bus = buses_[bus_id];
+    if (!bus.stops.empty()) {
+      for (const StopId endpoint : bus.endpoints) {
+        RenderBusLabel(svg, bus_id, endpoint);
       }
     }
   }
@@ -154,17 +213,16 @@ void MapRenderer::RenderRouteBusLabels(Svg::Document& svg, const TransportRouter
       continue;
     }
     const auto& bus_item = get<RouteBusItem>(item);
-    const string& bus_name = bus_item.bus_name;
-    const auto& bus = buses_dict_.at(bus_name);
+    const auto& bus = buses_[bus_item.bus_id];
     const auto& stops = bus.stops;
     if (stops.empty()) {
       continue;
     }
     for (const size_t stop_idx : {bus_item.start_stop_idx, bus_item.finish_stop_idx}) {
-      const auto stop_name = stops[stop_idx];
+      const StopId stop_id = stops[stop_idx];
       if (stop_idx == 0 || stop_idx == stops.size() - 1 ||
-          find(begin(bus.endpoints), end(bus.endpoints), stop_name) != end(bus.endpoints)) {
-        RenderBusLabel(svg, bus_name, stop_name);
+          find(begin(bus.endpoints), end(bus.endpoints), stop_id) != end(bus.endpoints)) {
+        RenderBusLabel(svg, bus_item.bus_id, stop_id);
       }
     }
   }
@@ -174,9 +232,9 @@ void MapRenderer::RenderStopPoint(Svg::Document& svg, Svg::Point point) const {
   svg.Add(Svg::Circle{}.SetCenter(point).SetRadius(render_settings_.stop_radius).SetFillColor("white"));
 }
 
-void MapRenderer::RenderStopPoints(Svg::Document& svg) const {
-  for (const auto& [_, stop_point] : stops_coords_) {
-    RenderStopPoint(svg, stop_point);
+void MapRenderer::RenderStopPoints(Svg::Document& svg, const MapObjects& objects) const {
+  for (const StopId stop_id : objects.stops) {
+    RenderStopPoint(svg, stops_coords_[stop_id]);
   }
 }
 
@@ -187,14 +245,12 @@ void MapRenderer::RenderRouteStopPoints(Svg::Document& svg, const TransportRoute
       continue;
     }
     const auto& bus_item = get<RouteBusItem>(item);
-    const string& bus_name = bus_item.bus_name;
-    const auto& stops = buses_dict_.at(bus_name).stops;
+    const auto& stops = buses_[bus_item.bus_id].stops;
     if (stops.empty()) {
       continue;
     }
     for (size_t stop_idx = bus_item.start_stop_idx; stop_idx <= bus_item.finish_stop_idx; ++stop_idx) {
-      const string& stop_name = stops[stop_idx];
-      RenderStopPoint(svg, stops_coords_.at(stop_name));
+      RenderStopPoint(svg, stops_coords_[stops[stop_idx]]);
     }
   }
 }
@@ -215,9 +271,9 @@ void MapRenderer::RenderStopLabel(Svg::Document& svg, Svg::Point point, const st
   svg.Add(base_text.SetFillColor("black"));
 }
 
-void MapRenderer::RenderStopLabels(Svg::Document& svg) const {
-  for (const auto& [stop_name, stop_point] : stops_coords_) {
-    RenderStopLabel(svg, stop_point, stop_name);
+void MapRenderer::RenderStopLabels(Svg::Document& svg, const MapObjects& objects) const {
+  for (const StopId stop_id : objects.stops) {
+    RenderStopLabel(svg, stops_coords_[stop_id], names_->stops.GetName(stop_id));
   }
 }
 
@@ -229,21 +285,19 @@ void MapRenderer::RenderRouteStopLabels(Svg::Document& svg, const TransportRoute
     if (!holds_alternative<RouteWaitItem>(item)) {
       continue;
     }
-    const auto& wait_item = get<RouteWaitItem>(item);
-    const string& stop_name = wait_item.stop_name;
-    RenderStopLabel(svg, stops_coords_.at(stop_name), stop_name);
+    const StopId stop_id = get<RouteWaitItem>(item).stop_id;
+    RenderStopLabel(svg, stops_coords_[stop_id], names_->stops.GetName(stop_id));
   }
 
   // draw stop label for last stop
+  StopId last_stop_id;
   if (holds_alternative<RouteBusItem>(route.items.back())) {
     const auto& last_bus_item = get<RouteBusItem>(route.items.back());
-    const string& last_stop_name = buses_dict_.at(last_bus_item.bus_name).stops[last_bus_item.finish_stop_idx];
-    RenderStopLabel(svg, stops_coords_.at(last_stop_name), last_stop_name);
+    last_stop_id = buses_[last_bus_item.bus_id].stops[last_bus_item.finish_stop_idx];
   } else {
-    const auto& company_item = get<WalkToCompanyItem>(route.items.back());
-    const string& last_stop_name = company_item.stop_name;
-    RenderStopLabel(svg, stops_coords_.at(last_stop_name), last_stop_name);
+    last_stop_id = get<WalkToCompanyItem>(route.items.back()).stop_id;
   }
+  RenderStopLabel(svg, stops_coords_[last_stop_id], names_->stops.GetName(last_stop_id));
 }
 
 void MapRenderer::RenderRouteCompanyLines(Svg::Document& svg, const TransportRouter::RouteInfo& route) const {
@@ -257,7 +311,7 @@ void MapRenderer::RenderRouteCompanyLines(Svg::Document& svg, const TransportRou
       .SetStrokeLineCap("round")
       .SetStrokeLineJoin("round");
   const auto& walk = get<WalkToCompanyItem>(route.items.back());
-  line.AddPoint(stops_coords_.at(walk.stop_name));
+  line.AddPoint(stops_coords_[walk.stop_id]);
   line.AddPoint(companies_coords_.at(GetCompanyKey(*walk.company)));
   svg.Add(line);
 }
@@ -283,13 +337,14 @@ void MapRenderer::RenderRouteCompanyLabels(Svg::Document& svg, const TransportRo
   RenderStopLabel(svg, companies_coords_.at(GetCompanyKey(*walk.company)), walk.company->cached_full_name());
 }
 
-void MapRenderer::RenderDummy(Svg::Document&) const {}
+void MapRenderer::RenderDummy(Svg::Document&, const MapObjects&) const {}
 
-const unordered_map<string, void (MapRenderer::*)(Svg::Document&) const> MapRenderer::MAP_LAYER_ACTIONS = {
-    {"bus_lines", &MapRenderer::RenderBusLines},     {"bus_labels", &MapRenderer::RenderBusLabels},
-    {"stop_points", &MapRenderer::RenderStopPoints}, {"stop_labels", &MapRenderer::RenderStopLabels},
-    {"company_lines", &MapRenderer::RenderDummy},    {"company_points", &MapRenderer::RenderDummy},
-    {"company_labels", &MapRenderer::RenderDummy},
+const unordered_map<string, void (MapRenderer::*)(Svg::Document&, const MapRenderer::MapObjects&) const>
+    MapRenderer::MAP_LAYER_ACTIONS = {
+        {"bus_lines", &MapRenderer::RenderBusLines},     {"bus_labels", &MapRenderer::RenderBusLabels},
+        {"stop_points", &MapRenderer::RenderStopPoints}, {"stop_labels", &MapRenderer::RenderStopLabels},
+        {"company_lines", &MapRenderer::RenderDummy},    {"company_points", &MapRenderer::RenderDummy},
+        {"company_labels", &MapRenderer::RenderDummy},
 };
 
 const unordered_map<string, void (MapRenderer::*)(Svg::Document&, const TransportRouter::RouteInfo&) const>
@@ -305,16 +360,34 @@ const unordered_map<string, void (MapRenderer::*)(Svg::Document&, const Transpor
 };
 
 Svg::Document MapRenderer::Render() const {
+  return Render(all_objects_);
+}
+
+Svg::Document MapRenderer::Render(MapArea area) const {
+  call_once(grids_built_, [this] { BuildGrids(); });
+  return Render(MapObjects{stops_grid_.Find(area), buses_grid_.Find(area)});
+}
+
+Svg::Document MapRenderer::Render(const MapObjects& objects) const {
   Svg::Document svg;
 
   for (const auto& layer : render_settings_.layers) {
-    (this->*MAP_LAYER_ACTIONS.at(layer))(svg);
+    (this->*MAP_LAYER_ACTIONS.at(layer))(svg, objects);
   }
 
   return svg;
 }
 
-Svg::Document MapRenderer::RenderRoute(Svg::Document svg, const TransportRouter::RouteInfo& route) const {
+MapArea MapRenderer::GetTileArea(MapTile tile) const {
+  const double tiles_per_side = ldexp(1.0, static_cast<int>(tile.zoom));
+  const double tile_width = render_settings_.max_width / tiles_per_side;
+  const double tile_height = render_settings_.max_height / tiles_per_side;
+  return {{tile.x * tile_width, tile.y * tile_height}, {(tile.x + 1) * tile_width, (tile.y + 1) * tile_height}};
+}
+
+Svg::Document MapRenderer::RenderRoute(const TransportRouter::RouteInfo& route) const {
+  METRICS_SPAN("map: RenderRoute layers");
+  Svg::Document svg;
   const double outer_margin = render_settings_.outer_margin;
   svg.Add(Svg::Rectangle{}
               .SetFillColor(render_settings_.underlayer_color)
@@ -1,13 +1,16 @@
 #pragma once
 
-#include <map>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <unordered_map>
 #include <vector>
 
 #include "database.pb.h"
 #include "descriptions.h"
+#include "interner.h"
 #include "json.h"
+#include "map_grid.h"
 #include "map_renderer.pb.h"
 #include "render_settings.h"
 #include "svg.h"
@@ -16,33 +19,61 @@
 class MapRenderer {
  public:
   MapRenderer(const Descriptions::StopsDict& stops_dict, const Descriptions::BusesDict& buses_dict,
-              const YellowPages::Database& yellow_pages, const Json::Dict& render_settings_json);
+              std::shared_ptr<const CatalogNames> names, const YellowPages::Database& yellow_pages,
+              const Json::Dict& render_settings_json);
 
   void Serialize(TCProto::MapRenderer& proto);
-  static std::unique_ptr<MapRenderer> Deserialize(const TCProto::MapRenderer& proto);
+  static std::unique_ptr<MapRenderer> Deserialize(const TCProto::MapRenderer& proto,
+                                                  std::shared_ptr<const CatalogNames> names);
 
   Svg::Document Render() const;
-  Svg::Document RenderRoute(Svg::Document whole_map, const TransportRouter::RouteInfo& route) const;
+  // Only the stops and the bus lines that intersect the area, drawn as on the whole map
+  Svg::Document Render(MapArea area) const;
+  MapArea GetTileArea(MapTile tile) const;
+  // Only the layers drawn over the whole map: the underlayer and the route itself
+  Svg::Document RenderRoute(const TransportRouter::RouteInfo& route) const;
 
  private:
   MapRenderer() = default;
 
+  struct BusRoute {
+    std::vector<StopId> stops;
+    std::vector<StopId> endpoints;
+  };
+
+  // Objects to draw, in the order they have on the whole map
+  struct MapObjects {
+    std::vector<StopId> stops;
+    std::vector<BusId> buses;
+  };
+
   RenderSettings render_settings_;
-  std::map<std::string, Svg::Point> stops_coords_;
+  std::shared_ptr<const CatalogNames> names_;
+  std::vector<Svg::Point> stops_coords_;  // indexed by stop id
   std::unordered_map<std::string, Svg::Point> companies_coords_;
-  std::unordered_map<std::string, Svg::Color> bus_colors_;
-  // TODO: move instead of copy
-  std::map<std::string, Descriptions::Bus> buses_dict_;
+  std::vector<Svg::Color> bus_colors_;  // indexed by bus id
+  std::vector<BusRoute> buses_;         // indexed by bus id
+
+  // Companies are drawn on route maps only, so just stops and buses are indexed
+  MapObjects all_objects_;  // grid item ids are stop and bus ids
+  // Built by the first area request, as many runs never make one
+  mutable std::once_flag grids_built_;
+  mutable MapGrid stops_grid_;
+  mutable MapGrid buses_grid_;
+
+  void FillAllObjects();
+  void BuildGrids() const;
+  Svg::Document Render(const MapObjects& objects) const;
 
-  void RenderBusLabel(Svg::Document& svg, const std::string& bus_name, const std::string& stop_name) const;
+  void RenderBusLabel(Svg::Document& svg, BusId bus_id, StopId stop_id) const;
   void RenderStopPoint(Svg::Document& svg, Svg::Point point) const;
   void RenderStopLabel(Svg::Document& svg, Svg::Point point, const std::string& name) const;
 
-  void RenderBusLines(Svg::Document& svg) const;
-  void RenderBusLabels(Svg::Document& svg) const;
-  void RenderStopPoints(Svg::Document& svg) const;
-  void RenderStopLabels(Svg::Document& svg) const;
-  void RenderDummy(Svg::Document& svg) const;
+  void RenderBusLines(Svg::Document& svg, const MapObjects& objects) const;
+  void RenderBusLabels(Svg::Document& svg, const MapObjects& objects) const;
+  void RenderStopPoints(Svg::Document& svg, const MapObjects& objects) const;
+  void RenderStopLabels(Svg::Document& svg, const MapObjects& objects) const;
+  void RenderDummy(Svg::Document& svg, const MapObjects& objects) const;
 
   void RenderRouteBusLines(Svg::Document& svg, const TransportRouter::RouteInfo& route) const;
   void RenderRouteBusLabels(Svg::Document& svg, const TransportRouter::RouteInfo& route) const;
@@ -53,7 +84,8 @@ class MapRenderer {
   void RenderRouteCompanyPoints(Svg::Document& svg, const TransportRouter::RouteInfo& route) const;
   void RenderRouteCompanyLabels(Svg::Document& svg, const TransportRouter::RouteInfo& route) const;
 
-  static const std::unordered_map<std::string, void (MapRenderer::*)(Svg::Document&) const> MAP_LAYER_ACTIONS;
+  static const std::unordered_map<std::string, void (MapRenderer::*)(Svg::Document&, const MapObjects&) const>
+      MAP_LAYER_ACTIONS;
 
   static const std::unordered_map<std::string,
                                   void (MapRenderer::*)(Svg::Document&, const TransportRouter::RouteInfo&) const>
@@ -11,14 +11,6 @@ struct NeighboursDicts {
 
 string GetCompanyKey(const YellowPages::Company& company) { return string(COMPANY_KEY_PREFIX) + company.id(); }
 
-map<string, Descriptions::Bus> CopyBusesDict(const Descriptions::BusesDict& source) {
-  map<string, Descriptions::Bus> target;
-  for (const auto& [name, data_ptr] : source) {
-    target.emplace(name, *data_ptr);
-  }
-  return target;
-}
-
 static unordered_set<string> FindBusSupportStops(const Descriptions::BusesDict& buses_dict) {
   unordered_set<string> support_stops;
   unordered_map<string, const Descriptions::Bus*> stops_first_bus;
@@ -157,13 +149,12 @@ CoordsMapping ComputeStopsCoordsByGrid(const Descriptions::StopsDict& stops_dict
   return mapping;
 }
 
-unordered_map<string, Svg::Color> ChooseBusColors(const Descriptions::BusesDict& buses_dict,
-                                                  const RenderSettings& render_settings) {
+vector<Svg::Color> ChooseBusColors(const Descriptions::BusesDict& buses_dict, const RenderSettings& render_settings) {
   const auto& palette = render_settings.palette;
-  unordered_map<string, Svg::Color> bus_colors;
-  int idx = 0;
-  for (const auto& [bus_name, bus_ptr] : buses_dict) {
-    bus_colors[bus_name] = palette[idx++ % palette.size()];
+  vector<Svg::Color> bus_colors;
+  bus_colors.reserve(buses_dict.size());
+  for (size_t idx = 0; idx < buses_dict.size(); ++idx) {
+    bus_colors.push_back(palette[idx % palette.size()]);
   }
   return bus_colors;
 }
\ No newline at end of file
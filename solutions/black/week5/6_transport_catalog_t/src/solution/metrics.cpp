@@ -0,0 +1,139 @@
+#include "metrics.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace Metrics {
+  // Values below 8 have buckets of their own, the others go by the highest bit and the 3 bits after it
+  static constexpr size_t SUB_BUCKET_BITS = 3;
+  static constexpr size_t SUB_BUCKET_COUNT = 1 << SUB_BUCKET_BITS;
+  static constexpr size_t BUCKET_COUNT = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKET_COUNT;
+
+  static size_t GetBucket(uint64_t value) {
+    if (value < SUB_BUCKET_COUNT) {
+      return value;
+    }
+    const size_t shift = bit_width(value) - 1 - SUB_BUCKET_BITS;
+    return (shift + 1) * SUB_BUCKET_COUNT + (value >> shift) - SUB_BUCKET_COUNT;
+  }
+
+  // The least value of the bucket
+  static uint64_t GetBucketValue(size_t bucket) {
+    if (bucket < SUB_BUCKET_COUNT) {
+      return bucket;
+    }
+    const size_t shift = bucket / SUB_BUCKET_COUNT - 1;
+    return (SUB_BUCKET_COUNT + bucket % SUB_BUCKET_COUNT) << shift;
+  }
+
+  struct Series {
+    uint64_t count = 0;
+    uint64_t total = 0;
+    uint64_t max = 0;
+    array<uint64_t, BUCKET_COUNT> buckets = {};
+
+    void Add(const Series& other) {
+      count += other.count;
+      total += other.total;
+      max = std::max(max, other.max);
+      for (size_t bucket = 0; bucket < BUCKET_COUNT; ++bucket) {
+        buckets[bucket] += other.buckets[bucket];
+      }
+    }
+
+    uint64_t GetPercentile(size_t percent) const {
+      const uint64_t rank = (count - 1) * percent / 100;
+      uint64_t seen = 0;
+      for (size_t bucket = 0; bucket < BUCKET_COUNT; ++bucket) {
+        seen += buckets[bucket];
+        if (seen > rank) {
+          return std::min(GetBucketValue(bucket), max);
+        }
+      }
+      return max;
+    }
+  };
+
+  using ThreadSeries = vector<Series>;  // by ids
+
+  struct Registry {
+    mutex m;
+    vector<pair<string, Kind>> series_names;
+    vector<unique_ptr<ThreadSeries>> threads;  // kept after the threads end, until the report
+  };
+
+  static Registry& GetRegistry() {
+    static Registry registry;
+    return registry;
+  }
+
+  SeriesId Register(string_view name, Kind kind) {
+    Registry& registry = GetRegistry();
+    lock_guard guard(registry.m);
+    const auto it = find_if(begin(registry.series_names), end(registry.series_names),
+                            [name](const auto& series_name) { return series_name.first == name; });
+    if (it != end(registry.series_names)) {
+      return it - begin(registry.series_names);
+    }
+    registry.series_names.emplace_back(name, kind);
+    return registry.series_names.size() - 1;
+  }
+
+  static ThreadSeries& AddThread() {
+    Registry& registry = GetRegistry();
+    lock_guard guard(registry.m);
+    return *registry.threads.emplace_back(make_unique<ThreadSeries>());
+  }
+
+  void Record(SeriesId id, uint64_t value) {
+    thread_local ThreadSeries& thread_series = AddThread();
+    if (id >= thread_series.size()) {
+      thread_series.resize(id + 1);
+    }
+    Series& series = thread_series[id];
+    ++series.count;
+    series.total += value;
+    series.max = max(series.max, value);
+    ++series.buckets[GetBucket(value)];
+  }
+
+  void Report(ostream& output) {
+    Registry& registry = GetRegistry();
+    lock_guard guard(registry.m);
+    ostringstream report;
+    report << fixed << setprecision(3);
+    for (SeriesId id = 0; id < registry.series_names.size(); ++id) {
+      Series series;
+      for (const auto& thread_series : registry.threads) {
+        if (id < thread_series->size()) {
+          series.Add((*thread_series)[id]);
+        }
+      }
+      if (series.count == 0) {
+        continue;
+      }
+
+      const auto& [name, kind] = registry.series_names[id];
+      report << "metrics: " << name << ": count " << series.count;
+      if (kind == Kind::SPAN) {
+        auto to_us = [](uint64_t ns) { return static_cast<double>(ns) / 1000; };
+        report << ", total " << to_us(series.total) / 1000 << " ms, p50 " << to_us(series.GetPercentile(50))
+               << " us, p99 " << to_us(series.GetPercentile(99)) << " us, max " << to_us(series.max) << " us";
+      } else {
+        report << ", total " << series.total << ", p50 " << series.GetPercentile(50) << ", p99 "
+               << series.GetPercentile(99) << ", max " << series.max;
+      }
+      report << '\n';
+    }
+    output << report.str() << flush;
+  }
+}  // namespace Metrics
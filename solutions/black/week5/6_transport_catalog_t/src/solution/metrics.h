@@ -0,0 +1,68 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string_view>
+
+// Timers and counters of hot paths, compiled in with -DBELTS_METRICS=ON.
+// Every thread records into its own histograms, so recording takes no locks.
+namespace Metrics {
+#ifdef BELTS_METRICS
+  inline constexpr bool ENABLED = true;
+#else
+  inline constexpr bool ENABLED = false;
+#endif
+
+  using SeriesId = size_t;
+
+  enum class Kind {
+    SPAN,     // durations in nanoseconds
+    COUNTER,  // any values, like sizes of results
+  };
+
+  // A series per name, call sites keep their ids in static variables
+  SeriesId Register(std::string_view name, Kind kind);
+  void Record(SeriesId id, uint64_t value);
+
+  class ScopedSpan {
+   public:
+    explicit ScopedSpan(SeriesId id) : id_(id), start_(std::chrono::steady_clock::now()) {}
+    ~ScopedSpan() {
+      const auto duration = std::chrono::steady_clock::now() - start_;
+      Record(id_, std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count());
+    }
+
+    ScopedSpan(const ScopedSpan&) = delete;
+    ScopedSpan& operator=(const ScopedSpan&) = delete;
+
+   private:
+    SeriesId id_;
+    std::chrono::steady_clock::time_point start_;
+  };
+
+  // Count, total, p50, p99 and max of every series over all threads.
+  // Percentiles are accurate to 1/8 of the value. Call it when the recording threads are done.
+  void Report(std::ostream& output);
+}  // namespace Metrics
+
+#define METRICS_CONCAT_IMPL(lhs, rhs) lhs##rhs
+#define METRICS_CONCAT(lhs, rhs) METRICS_CONCAT_IMPL(lhs, rhs)
+
+#ifdef BELTS_METRICS
+// Times the rest of the scope
+#define METRICS_SPAN(name)                                                                                  \
+  static const ::Metrics::SeriesId METRICS_CONCAT(metrics_span_id_, __LINE__) =                            \
+      ::Metrics::Register(name, ::Metrics::Kind::SPAN);                                                    \
+  const ::Metrics::ScopedSpan METRICS_CONCAT(metrics_span_, __LINE__)(METRICS_CONCAT(metrics_span_id_, __LINE__))
+
+#define METRICS_COUNT(name, value)                                                                            \
+  do {                                                                                                        \
+    static const ::Metrics::SeriesId metrics_counter_id = ::Metrics::Register(name, ::Metrics::Kind::COUNTER); \
+    ::Metrics::Record(metrics_counter_id, value);                                                             \
+  } while (false)
+#else
+#define METRICS_SPAN(name) static_cast<void>(0)
+#define METRICS_COUNT(name, value) static_cast<void>(0)
+#endif
@@ -0,0 +1,231 @@
+#include "name_index.h"
+
+#include <algorithm>
+#include <iterator>
+
+using namespace std;
+
+static void SortUnique(vector<NameIndex::Id>& ids) {
+  sort(begin(ids), end(ids));
+  ids.erase(unique(begin(ids), end(ids)), end(ids));
+}
+
+NameIndex::NameIndex(vector<pair<string, Id>> entries) {
+  sort(begin(entries), end(entries));
+  entries.erase(unique(begin(entries), end(entries)), end(entries));
+
+  built_key_offsets_.push_back(0);
+  built_id_offsets_.push_back(0);
+  for (size_t entry_idx = 0; entry_idx < entries.size(); ++entry_idx) {
+    const auto& [key, id] = entries[entry_idx];
+    if (entry_idx == 0 || key != entries[entry_idx - 1].first) {
+      if (entry_idx != 0) {
+        built_key_offsets_.push_back(built_chars_.size());
+        built_id_offsets_.push_back(built_ids_.size());
+      }
+      built_chars_.insert(end(built_chars_), begin(key), end(key));
+    }
+    built_ids_.push_back(id);
+  }
+  if (!entries.empty()) {
+    built_key_offsets_.push_back(built_chars_.size());
+    built_id_offsets_.push_back(built_ids_.size());
+  }
+
+  chars_ = built_chars_;
+  key_offsets_ = built_key_offsets_;
+  ids_ = built_ids_;
+  id_offsets_ = built_id_offsets_;
+}
+
+NameIndex::NameIndex(const NameIndex& previous, const vector<optional<Id>>& new_ids,
+                     vector<pair<string, Id>> added_entries) {
+  sort(begin(added_entries), end(added_entries));
+
+  built_key_offsets_.push_back(0);
+  built_id_offsets_.push_back(0);
+  size_t added_idx = 0;
+  vector<Id> ids;
+  const auto append_added_ids = [&](string_view key) {
+    for (; added_idx < added_entries.size() && added_entries[added_idx].first == key; ++added_idx) {
+      ids.push_back(added_entries[added_idx].second);
+    }
+  };
+  const auto add_added_keys_before = [&](const optional<string_view> key) {
+    while (added_idx < added_entries.size() && (!key || added_entries[added_idx].first < *key)) {
+      const string& added_key = added_entries[added_idx].first;
+      ids.clear();
+      append_added_ids(added_key);
+      AddKey(added_key, ids);
+    }
+  };
+
+  for (size_t key_idx = 0; key_idx < previous.GetKeyCount(); ++key_idx) {
+    const string_view key = previous.GetKey(key_idx);
+    add_added_keys_before(key);
+    ids.clear();
+    for (uint64_t id_idx = previous.id_offsets_[key_idx]; id_idx < previous.id_offsets_[key_idx + 1]; ++id_idx) {
+      if (const Id id = previous.ids_[id_idx]; id < new_ids.size() && new_ids[id]) {
+        ids.push_back(*new_ids[id]);
+      }
+    }
+    append_added_ids(key);
+    AddKey(key, ids);
+  }
+  add_added_keys_before(nullopt);
+
+  chars_ = built_chars_;
+  key_offsets_ = built_key_offsets_;
+  ids_ = built_ids_;
+  id_offsets_ = built_id_offsets_;
+}
+
+void NameIndex::AddKey(string_view key, vector<Id>& ids) {
+  SortUnique(ids);
+  if (ids.empty()) {
+    return;
+  }
+  built_chars_.insert(end(built_chars_), begin(key), end(key));
+  built_ids_.insert(end(built_ids_), begin(ids), end(ids));
+  built_key_offsets_.push_back(built_chars_.size());
+  built_id_offsets_.push_back(built_ids_.size());
+}
+
+void NameIndex::Serialize(TCProto::NameIndex& proto, BaseFile::Writer& base_file) const {
+  proto.set_key_count(GetKeyCount());
+  proto.set_chars_size(chars_.size());
+  proto.set_id_count(ids_.size());
+  proto.set_chars_offset(base_file.AppendArray(chars_));
+  proto.set_key_offsets_offset(base_file.AppendArray(key_offsets_));
+  proto.set_ids_offset(base_file.AppendArray(ids_));
+  proto.set_id_offsets_offset(base_file.AppendArray(id_offsets_));
+}
+
+NameIndex NameIndex::Deserialize(const TCProto::NameIndex& proto, const BaseFile::Reader& base_file) {
+  NameIndex index;
+  index.built_chars_.clear();
+  index.built_key_offsets_.clear();
+  index.built_ids_.clear();
+  index.built_id_offsets_.clear();
+
+  index.chars_ = base_file.GetArray<char>(proto.chars_offset(), proto.chars_size());
+  index.key_offsets_ = base_file.GetArray<uint64_t>(proto.key_offsets_offset(), proto.key_count() + 1);
+  index.ids_ = base_file.GetArray<Id>(proto.ids_offset(), proto.id_count());
+  index.id_offsets_ = base_file.GetArray<uint64_t>(proto.id_offsets_offset(), proto.key_count() + 1);
+  return index;
+}
+
+string_view NameIndex::GetKey(size_t key_idx) const {
+  return {chars_.data() + key_offsets_[key_idx], key_offsets_[key_idx + 1] - key_offsets_[key_idx]};
+}
+
+void NameIndex::AppendIds(size_t key_idx, vector<Id>& ids) const {
+  ids.insert(end(ids), begin(ids_) + id_offsets_[key_idx], begin(ids_) + id_offsets_[key_idx + 1]);
+}
+
+vector<NameIndex::Id> NameIndex::FindByPrefix(string_view prefix) const {
+  size_t begin_idx = 0;
+  size_t end_idx = GetKeyCount();
+  while (begin_idx < end_idx) {  // first key not less than the prefix
+    const size_t middle_idx = begin_idx + (end_idx - begin_idx) / 2;
+    if (GetKey(middle_idx) < prefix) {
+      begin_idx = middle_idx + 1;
+    } else {
+      end_idx = middle_idx;
+    }
+  }
+
+  vector<Id> ids;
+  for (size_t key_idx = begin_idx; key_idx < GetKeyCount() && GetKey(key_idx).starts_with(prefix); ++key_idx) {
+    AppendIds(key_idx, ids);
+  }
+  SortUnique(ids);
+  return ids;
+}
+
+// Malformed sequences are taken byte by byte
+static size_t GetCodePointLength(char lead) {
+  const auto byte = static_cast<unsigned char>(lead);
+  if ((byte >> 5) == 0b110) {
+    return 2;
+  } else if ((byte >> 4) == 0b1110) {
+    return 3;
+  } else if ((byte >> 3) == 0b11110) {
+    return 4;
+  }
+  return 1;
+}
+
+static vector<string_view> SplitCodePoints(string_view text) {
+  vector<string_view> result;
+  while (!text.empty()) {
+    result.push_back(text.substr(0, GetCodePointLength(text.front())));
+    text.remove_prefix(result.back().size());
+  }
+  return result;
+}
+
+vector<NameIndex::Id> NameIndex::FindFuzzy(string_view query, uint32_t max_edits) const {
+  const vector<string_view> query_chars = SplitCodePoints(query);
+  vector<uint32_t> edit_distances(query_chars.size() + 1);
+  for (uint32_t query_prefix_size = 0; query_prefix_size < edit_distances.size(); ++query_prefix_size) {
+    edit_distances[query_prefix_size] = query_prefix_size;
+  }
+
+  vector<Id> ids;
+  SearchFuzzy(0, GetKeyCount(), 0, query_chars, edit_distances, max_edits, ids);
+  SortUnique(ids);
+  return ids;
+}
+
+void NameIndex::SearchFuzzy(size_t begin_idx, size_t end_idx, size_t depth, const vector<string_view>& query_chars,
+                            const vector<uint32_t>& edit_distances, uint32_t max_edits, vector<Id>& ids) const {
+  // The key equal to the common prefix goes first
+  if (begin_idx < end_idx && GetKey(begin_idx).size() == depth) {
+    if (edit_distances.back() <= max_edits) {
+      AppendIds(begin_idx, ids);
+    }
+    ++begin_idx;
+  }
+
+  vector<uint32_t> next_edit_distances(edit_distances.size());
+  while (begin_idx < end_idx) {
+    const string_view key = GetKey(begin_idx);
+    const string_view code_point = key.substr(depth, GetCodePointLength(key[depth]));
+    // Keys continuing with the same code point are adjacent
+    size_t group_end_idx = begin_idx + 1;
+    for (size_t step = 1; group_end_idx < end_idx; step *= 2) {  // gallop, then narrow down
+      const size_t probe_idx = min(group_end_idx + step, end_idx) - 1;
+      if (GetKey(probe_idx).substr(depth, code_point.size()) != code_point) {
+        size_t low_idx = group_end_idx;
+        size_t high_idx = probe_idx;
+        while (low_idx < high_idx) {
+          const size_t middle_idx = low_idx + (high_idx - low_idx) / 2;
+          if (GetKey(middle_idx).substr(depth, code_point.size()) == code_point) {
+            low_idx = middle_idx + 1;
+          } else {
+            high_idx = middle_idx;
+          }
+        }
+        group_end_idx = low_idx;
+        break;
+      }
+      group_end_idx = probe_idx + 1;
+    }
+
+    next_edit_distances[0] = edit_distances[0] + 1;
+    uint32_t min_edit_distance = next_edit_distances[0];
+    for (size_t query_idx = 1; query_idx < edit_distances.size(); ++query_idx) {
+      const uint32_t substitution_cost = query_chars[query_idx - 1] == code_point ? 0 : 1;
+      next_edit_distances[query_idx] =
+          min({edit_distances[query_idx] + 1, next_edit_distances[query_idx - 1] + 1,
+               edit_distances[query_idx - 1] + substitution_cost});
+      min_edit_distance = min(min_edit_distance, next_edit_distances[query_idx]);
+    }
+    if (min_edit_distance <= max_edits) {
+      SearchFuzzy(begin_idx, group_end_idx, depth + code_point.size(), query_chars, next_edit_distances, max_edits,
+                  ids);
+    }
+    begin_idx = group_end_idx;
+  }
+}
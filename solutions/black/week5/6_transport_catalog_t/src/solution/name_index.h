@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "base_file.h"
+#include "name_index.pb.h"
+
+// Sorted distinct keys with a sorted list of ids per key, kept as flat arrays to be stored in a base file
+// and used in place. Keys sharing a prefix are adjacent, so the table also serves as an implicit trie.
+class NameIndex {
+ public:
+  using Id = uint32_t;
+
+  NameIndex() : NameIndex(std::vector<std::pair<std::string, Id>>{}) {}
+  // A key may come with several ids
+  explicit NameIndex(std::vector<std::pair<std::string, Id>> entries);
+  // The entries of previous with the ids mapped by new_ids, indexed by the previous ids, where nullopt drops
+  // the entry, merged with the added entries. Only the added entries are sorted, the rest is a linear merge.
+  NameIndex(const NameIndex& previous, const std::vector<std::optional<Id>>& new_ids,
+            std::vector<std::pair<std::string, Id>> added_entries);
+
+  NameIndex(NameIndex&&) = default;
+  NameIndex& operator=(NameIndex&&) = default;
+
+  void Serialize(TCProto::NameIndex& proto, BaseFile::Writer& base_file) const;
+  // The arrays are used in place, so the base file must outlive the index
+  static NameIndex Deserialize(const TCProto::NameIndex& proto, const BaseFile::Reader& base_file);
+
+  // Results are sorted and distinct
+  std::vector<Id> FindByPrefix(std::string_view prefix) const;
+  // Keys within max_edits insertions, deletions or substitutions of UTF-8 code points from the query
+  std::vector<Id> FindFuzzy(std::string_view query, uint32_t max_edits) const;
+
+ private:
+  size_t GetKeyCount() const { return key_offsets_.size() - 1; }
+  std::string_view GetKey(size_t key_idx) const;
+  void AppendIds(size_t key_idx, std::vector<Id>& ids) const;
+  // Adds a key after the last one, if any ids are left once sorted
+  void AddKey(std::string_view key, std::vector<Id>& ids);
+
+  // Keys in [begin_idx, end_idx) share their first depth bytes, edit_distances hold the distances
+  // from that prefix to each prefix of the query
+  void SearchFuzzy(size_t begin_idx, size_t end_idx, size_t depth, const std::vector<std::string_view>& query_chars,
+                   const std::vector<uint32_t>& edit_distances, uint32_t max_edits, std::vector<Id>& ids) const;
+
+  // Filled when built, empty when the arrays are read from a base file.
+  // Vectors, unlike short strings, keep their buffers when moved, so the spans stay valid.
+  std::vector<char> built_chars_;
+  std::vector<uint64_t> built_key_offsets_;
+  std::vector<Id> built_ids_;
+  std::vector<uint64_t> built_id_offsets_;
+
+  std::span<const char> chars_;
+  std::span<const uint64_t> key_offsets_;  // key_count + 1 items
+  std::span<const Id> ids_;
+  std::span<const uint64_t> id_offsets_;  // key_count + 1 items
+};
@@ -0,0 +1,314 @@
+#pragma once
+
+#include <algorithm>
+#include <barrier>
+#include <bit>
+#include <functional>
+#include <cassert>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <queue>
+#include <span>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "base_file.h"
+#include "graph.h"
+#include "graph.pb.h"
+#include "router.h"
+
+namespace Graph {
+
+  // Floyd–Warshall over the whole graph: O(V^3) to build, O(V^2) memory, O(1) per weight query
+  template <typename Weight>
+  class PrecomputedRouter : public Router<Weight> {
+   private:
+    using Base = Router<Weight>;
+    using typename Base::Graph;
+
+   public:
+    using typename Base::RouteInfo;
+
+    // Relaxation through every vertex is split by source rows between thread_count threads
+    explicit PrecomputedRouter(const Graph& graph, size_t thread_count = 1);
+    // Repairs the tables of a router built for the same edges with other weights (see HasSameEdges):
+    // only the sources whose routes may change are searched again, with Dijkstra, by up to thread_count threads
+    // Route weights may differ from the tables built anew by rounding, as Dijkstra sums them in another order
+    PrecomputedRouter(const Graph& graph, const PrecomputedRouter& previous, size_t thread_count = 1);
+
+    void Serialize(GraphProto::Router& proto, BaseFile::Writer& base_file) const override;
+    // The tables are used in place, so the base file must outlive the router
+    static std::unique_ptr<PrecomputedRouter> Deserialize(const GraphProto::Router& proto, const Graph& graph,
+                                                          const BaseFile::Reader& base_file);
+
+    std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const override;
+    std::optional<Weight> GetWeight(VertexId from, VertexId to) const override;
+
+   private:
+    PrecomputedRouter(const Graph& graph, const GraphProto::Router& proto, const BaseFile::Reader& base_file);
+
+    // Last edge of the route from a row vertex to a column vertex, or one of the sentinels
+    using PrevEdge = uint32_t;
+    static constexpr PrevEdge NO_ROUTE = std::numeric_limits<PrevEdge>::max();
+    static constexpr PrevEdge NO_PREV_EDGE = NO_ROUTE - 1;  // route from a vertex to itself
+
+    size_t GetRouteIdx(VertexId from, VertexId to) const {
+      return from * vertex_count_ + to;
+    }
+
+    void InitializeRoutesInternalData(const Graph& graph) {
+      for (VertexId vertex = 0; vertex < vertex_count_; ++vertex) {
+        built_weights_[GetRouteIdx(vertex, vertex)] = 0;
+        built_prev_edges_[GetRouteIdx(vertex, vertex)] = NO_PREV_EDGE;
+        for (const EdgeId edge_id : graph.GetIncidentEdges(vertex)) {
+          const auto& edge = graph.GetEdge(edge_id);
+          assert(edge.weight >= 0);
+          assert(edge_id < NO_PREV_EDGE);
+          const size_t route_idx = GetRouteIdx(vertex, edge.to);
+          if (built_prev_edges_[route_idx] == NO_ROUTE || built_weights_[route_idx] > edge.weight) {
+            built_weights_[route_idx] = edge.weight;
+            built_prev_edges_[route_idx] = edge_id;
+          }
+        }
+      }
+    }
+
+    // Rows of different sources are independent: the row and column of vertex_through
+    // do not change while relaxing through it, so row ranges may be relaxed concurrently
+    void RelaxRoutesInternalDataThroughVertex(VertexId vertex_through, VertexId vertex_from_begin,
+                                              VertexId vertex_from_end) {
+      const Weight* const weights_through = &built_weights_[GetRouteIdx(vertex_through, 0)];
+      const PrevEdge* const prev_edges_through = &built_prev_edges_[GetRouteIdx(vertex_through, 0)];
+      for (VertexId vertex_from = vertex_from_begin; vertex_from < vertex_from_end; ++vertex_from) {
+        const size_t route_from_idx = GetRouteIdx(vertex_from, vertex_through);
+        const PrevEdge prev_edge_from = built_prev_edges_[route_from_idx];
+        if (prev_edge_from == NO_ROUTE) {
+          continue;
+        }
+        const Weight weight_from = built_weights_[route_from_idx];
+        Weight* const weights_relaxing = &built_weights_[GetRouteIdx(vertex_from, 0)];
+        PrevEdge* const prev_edges_relaxing = &built_prev_edges_[GetRouteIdx(vertex_from, 0)];
+        for (VertexId vertex_to = 0; vertex_to < vertex_count_; ++vertex_to) {
+          const PrevEdge prev_edge_to = prev_edges_through[vertex_to];
+          if (prev_edge_to == NO_ROUTE) {
+            continue;
+          }
+          const Weight candidate_weight = weight_from + weights_through[vertex_to];
+          if (prev_edges_relaxing[vertex_to] == NO_ROUTE || candidate_weight < weights_relaxing[vertex_to]) {
+            weights_relaxing[vertex_to] = candidate_weight;
+            prev_edges_relaxing[vertex_to] = prev_edge_to != NO_PREV_EDGE ? prev_edge_to : prev_edge_from;
+          }
+        }
+      }
+    }
+
+    // Whether a changed edge may shorten a route from the source or lies on one of its routes.
+    // The routes of other sources are still the shortest: they only lost alternatives.
+    bool NeedsRepair(VertexId vertex_from, const std::vector<EdgeId>& changed_edges,
+                     const Graph& previous_graph) const;
+    // Dijkstra over the row of the source
+    void RepairRow(VertexId vertex_from);
+
+    size_t vertex_count_;
+    // Filled when built, empty when the tables are read from a base file
+    std::vector<Weight> built_weights_;
+    std::vector<PrevEdge> built_prev_edges_;
+
+    std::span<const Weight> weights_;  // undefined where there is no route
+    std::span<const PrevEdge> prev_edges_;
+  };
+
+  template <typename Weight>
+  PrecomputedRouter<Weight>::PrecomputedRouter(const Graph& graph, size_t thread_count)
+      : Base(graph),
+        vertex_count_(graph.GetVertexCount()),
+        built_weights_(vertex_count_ * vertex_count_),
+        built_prev_edges_(vertex_count_ * vertex_count_, NO_ROUTE) {
+    InitializeRoutesInternalData(graph);
+
+    thread_count = std::clamp<size_t>(thread_count, 1, std::max<size_t>(vertex_count_, 1));
+    std::barrier vertex_through_done(thread_count);
+    auto relax_rows = [this, &vertex_through_done](VertexId vertex_from_begin, VertexId vertex_from_end) {
+      for (VertexId vertex_through = 0; vertex_through < vertex_count_; ++vertex_through) {
+        RelaxRoutesInternalDataThroughVertex(vertex_through, vertex_from_begin, vertex_from_end);
+        vertex_through_done.arrive_and_wait();
+      }
+    };
+
+    const size_t rows_per_thread = (vertex_count_ + thread_count - 1) / thread_count;
+    std::vector<std::jthread> workers;
+    workers.reserve(thread_count - 1);
+    for (size_t thread_idx = 1; thread_idx < thread_count; ++thread_idx) {
+      workers.emplace_back(relax_rows, std::min(thread_idx * rows_per_thread, vertex_count_),
+                           std::min((thread_idx + 1) * rows_per_thread, vertex_count_));
+    }
+    relax_rows(0, std::min(rows_per_thread, vertex_count_));
+    workers.clear();  // joins
+
+    weights_ = built_weights_;
+    prev_edges_ = built_prev_edges_;
+  }
+
+  template <typename Weight>
+  PrecomputedRouter<Weight>::PrecomputedRouter(const Graph& graph, const PrecomputedRouter& previous,
+                                               size_t thread_count)
+      : Base(graph),
+        vertex_count_(graph.GetVertexCount()),
+        built_weights_(previous.weights_.begin(), previous.weights_.end()),
+        built_prev_edges_(previous.prev_edges_.begin(), previous.prev_edges_.end()) {
+    const Graph& previous_graph = previous.graph_;
+    assert(graph.HasSameEdges(previous_graph));
+    std::vector<EdgeId> changed_edges;
+    for (EdgeId edge_id = 0; edge_id < graph.GetEdgeCount(); ++edge_id) {
+      const Weight weight = graph.GetEdge(edge_id).weight;
+      const Weight previous_weight = previous_graph.GetEdge(edge_id).weight;
+      if (weight < previous_weight || previous_weight < weight) {
+        changed_edges.push_back(edge_id);
+      }
+    }
+
+    std::vector<VertexId> repaired_rows;
+    if (!changed_edges.empty()) {
+      for (VertexId vertex_from = 0; vertex_from < vertex_count_; ++vertex_from) {
+        if (NeedsRepair(vertex_from, changed_edges, previous_graph)) {
+          repaired_rows.push_back(vertex_from);
+        }
+      }
+    }
+
+    const size_t row_count = repaired_rows.size();
+    thread_count = std::clamp<size_t>(thread_count, 1, std::max<size_t>(row_count, 1));
+    auto repair_rows = [this, &repaired_rows](size_t row_begin, size_t row_end) {
+      for (size_t row_idx = row_begin; row_idx < row_end; ++row_idx) {
+        RepairRow(repaired_rows[row_idx]);
+      }
+    };
+    const size_t rows_per_thread = (row_count + thread_count - 1) / thread_count;
+    std::vector<std::jthread> workers;
+    workers.reserve(thread_count - 1);
+    for (size_t thread_idx = 1; thread_idx < thread_count; ++thread_idx) {
+      workers.emplace_back(repair_rows, std::min(thread_idx * rows_per_thread, row_count),
+                           std::min((thread_idx + 1) * rows_per_thread, row_count));
+    }
+    repair_rows(0, std::min(rows_per_thread, row_count));
+    workers.clear();  // joins
+
+    weights_ = built_weights_;
+    prev_edges_ = built_prev_edges_;
+  }
+
+  template <typename Weight>
+  bool PrecomputedRouter<Weight>::NeedsRepair(VertexId vertex_from, const std::vector<EdgeId>& changed_edges,
+                                              const Graph& previous_graph) const {
+    for (const EdgeId edge_id : changed_edges) {
+      const auto& edge = this->graph_.GetEdge(edge_id);
+      const size_t route_to_idx = GetRouteIdx(vertex_from, edge.to);
+      if (built_prev_edges_[route_to_idx] == edge_id) {
+        return true;
+      }
+      const size_t route_from_idx = GetRouteIdx(vertex_from, edge.from);
+      if (built_prev_edges_[route_from_idx] == NO_ROUTE || !(edge.weight < previous_graph.GetEdge(edge_id).weight)) {
+        continue;
+      }
+      if (built_prev_edges_[route_to_idx] == NO_ROUTE ||
+          built_weights_[route_from_idx] + edge.weight < built_weights_[route_to_idx]) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  template <typename Weight>
+  void PrecomputedRouter<Weight>::RepairRow(VertexId vertex_from) {
+    const Graph& graph = this->graph_;
+    Weight* const weights = &built_weights_[GetRouteIdx(vertex_from, 0)];
+    PrevEdge* const prev_edges = &built_prev_edges_[GetRouteIdx(vertex_from, 0)];
+    std::fill(prev_edges, prev_edges + vertex_count_, NO_ROUTE);
+    weights[vertex_from] = 0;
+    prev_edges[vertex_from] = NO_PREV_EDGE;
+
+    using QueueItem = std::pair<Weight, VertexId>;
+    std::priority_queue<QueueItem, std::vector<QueueItem>, std::greater<QueueItem>> queue;
+    queue.push({0, vertex_from});
+    while (!queue.empty()) {
+      const auto [weight, vertex] = queue.top();
+      queue.pop();
+      if (weights[vertex] < weight) {
+        continue;  // outdated queue item, the vertex was settled earlier
+      }
+      for (const EdgeId edge_id : graph.GetIncidentEdges(vertex)) {
+        const auto& edge = graph.GetEdge(edge_id);
+        assert(edge.weight >= 0);
+        const Weight candidate_weight = weight + edge.weight;
+        if (prev_edges[edge.to] == NO_ROUTE || candidate_weight < weights[edge.to]) {
+          weights[edge.to] = candidate_weight;
+          prev_edges[edge.to] = edge_id;
+          queue.push({candidate_weight, edge.to});
+        }
+      }
+    }
+  }
+
+  template <typename Weight>
+  void PrecomputedRouter<Weight>::Serialize(GraphProto::Router& proto, BaseFile::Writer& base_file) const {
+    static_assert(std::is_same_v<Weight, double>, "Serialization is implemented only for double weights");
+    static_assert(std::endian::native == std::endian::little, "Tables are stored in little-endian byte order");
+
+    auto& routes_proto = *proto.mutable_precomputed_routes();
+    routes_proto.set_vertex_count(vertex_count_);
+    routes_proto.set_weights_offset(base_file.AppendArray(weights_));
+    routes_proto.set_prev_edges_offset(base_file.AppendArray(prev_edges_));
+  }
+
+  template <typename Weight>
+  PrecomputedRouter<Weight>::PrecomputedRouter(const Graph& graph, const GraphProto::Router& proto,
+                                               const BaseFile::Reader& base_file)
+      : Base(graph), vertex_count_(proto.precomputed_routes().vertex_count()) {
+    static_assert(std::is_same_v<Weight, double>, "Serialization is implemented only for double weights");
+    static_assert(std::endian::native == std::endian::little, "Tables are stored in little-endian byte order");
+
+    const auto& routes_proto = proto.precomputed_routes();
+    const size_t route_count = vertex_count_ * vertex_count_;
+    weights_ = base_file.GetArray<Weight>(routes_proto.weights_offset(), route_count);
+    prev_edges_ = base_file.GetArray<PrevEdge>(routes_proto.prev_edges_offset(), route_count);
+  }
+
+  template <typename Weight>
+  std::unique_ptr<PrecomputedRouter<Weight>> PrecomputedRouter<Weight>::Deserialize(
+      const GraphProto::Router& proto, const Graph& graph, const BaseFile::Reader& base_file) {
+    return std::unique_ptr<PrecomputedRouter>(new PrecomputedRouter(graph, proto, base_file));  // ctor is private
+  }
+
+  template <typename Weight>
+  std::optional<typename PrecomputedRouter<Weight>::RouteInfo> PrecomputedRouter<Weight>::BuildRoute(
+      VertexId from, VertexId to) const {
+    const size_t route_idx = GetRouteIdx(from, to);
+    if (prev_edges_[route_idx] == NO_ROUTE) {
+      return std::nullopt;
+    }
+    const Weight weight = weights_[route_idx];
+    std::vector<EdgeId> edges;
+    for (PrevEdge edge_id = prev_edges_[route_idx]; edge_id != NO_PREV_EDGE;
+         edge_id = prev_edges_[GetRouteIdx(from, this->graph_.GetEdge(edge_id).from)]) {
+      edges.push_back(edge_id);
+    }
+    std::reverse(std::begin(edges), std::end(edges));
+
+    return this->SaveRoute(weight, std::move(edges));
+  }
+
+  template <typename Weight>
+  std::optional<Weight> PrecomputedRouter<Weight>::GetWeight(VertexId from, VertexId to) const {
+    const size_t route_idx = GetRouteIdx(from, to);
+    if (prev_edges_[route_idx] == NO_ROUTE) {
+      return std::nullopt;
+    }
+    return weights_[route_idx];
+  }
+
+}  // namespace Graph
@@ -1,136 +1,187 @@
 #include "requests.h"
 
+#include <algorithm>
+#include <charconv>
+#include <iterator>
+#include <memory>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
 #include <vector>
 
+#include "metrics.h"
 #include "transport_router.h"
 
 using namespace std;
 
 namespace Requests {
 
-  Json::Dict Stop::Process(const TransportCatalog& db) const {
+  void Stop::Process(const TransportCatalog& db, Json::Writer& response) const {
+    METRICS_SPAN("requests: Stop");
     const auto* stop = db.GetStop(name);
-    Json::Dict dict;
     if (!stop) {
-      dict["error_message"] = Json::Node("not found"s);
-    } else {
-      Json::Array bus_nodes;
-      bus_nodes.reserve(stop->bus_names.size());
-      for (const auto& bus_name : stop->bus_names) {
-        bus_nodes.emplace_back(bus_name);
-      }
-      dict["buses"] = Json::Node(move(bus_nodes));
+      response.Key("error_message").Value("not found");
+      return;
     }
-    return dict;
+    response.Key("buses").BeginArray();
+    for (const BusId bus_id : stop->bus_ids) {
+      response.Value(db.GetBusName(bus_id));
+    }
+    response.EndArray();
   }
 
-  Json::Dict Bus::Process(const TransportCatalog& db) const {
+  void Bus::Process(const TransportCatalog& db, Json::Writer& response) const {
+    METRICS_SPAN("requests: Bus");
     const auto* bus = db.GetBus(name);
-    Json::Dict dict;
     if (!bus) {
-      dict["error_message"] = Json::Node("not found"s);
-    } else {
-      dict = {
-          {"stop_count", Json::Node(static_cast<int>(bus->stop_count))},
-          {"unique_stop_count", Json::Node(static_cast<int>(bus->unique_stop_count))},
-          {"route_length", Json::Node(static_cast<int>(bus->road_route_length))},
-          {"curvature", Json::Node(bus->road_route_length / bus->geo_route_length)},
-      };
-    }
-    return dict;
+      response.Key("error_message").Value("not found");
+      return;
+    }
+    response.Key("stop_count").Value(static_cast<int>(bus->stop_count));
+    response.Key("unique_stop_count").Value(static_cast<int>(bus->unique_stop_count));
+    response.Key("route_length").Value(static_cast<int>(bus->road_route_length));
+    response.Key("curvature").Value(bus->road_route_length / bus->geo_route_length);
   }
 
   struct RouteItemResponseBuilder {
-    Json::Dict operator()(const TransportRouter::RouteInfo::RideBusItem& bus_item) const {
-      return Json::Dict{{"type", Json::Node("RideBus"s)},
-                        {"bus", Json::Node(bus_item.bus_name)},
-                        {"time", Json::Node(bus_item.time)},
-                        {"span_count", Json::Node(static_cast<int>(bus_item.span_count))}};
-    }
-    Json::Dict operator()(const TransportRouter::RouteInfo::WaitBusItem& wait_item) const {
-      return Json::Dict{
-          {"type", Json::Node("WaitBus"s)},
-          {"stop_name", Json::Node(wait_item.stop_name)},
-          {"time", Json::Node(wait_item.time)},
-      };
-    }
-    Json::Dict operator()(const TransportRouter::RouteInfo::WalkToCompanyItem& walk_item) const {
-      return Json::Dict{
-          {"type", Json::Node("WalkToCompany"s)},
-          {"stop_name", Json::Node(walk_item.stop_name)},
-          {"company", Json::Node(walk_item.company->cached_main_name())},
-          {"time", Json::Node(walk_item.time)},
-      };
-    }
-    Json::Dict operator()(const TransportRouter::RouteInfo::WaitCompanyItem& wait_item) const {
-      return Json::Dict{
-          {"type", Json::Node("WaitCompany"s)},
-          {"company", Json::Node(wait_item.company->cached_main_name())},
-          {"time", Json::Node(wait_item.time)},
-      };
+    const TransportCatalog& db;
+    Json::Writer& response;
+
+    void operator()(const TransportRouter::RouteInfo::RideBusItem& bus_item) const {
+      response.Key("type").Value("RideBus");
+      response.Key("bus").Value(db.GetBusName(bus_item.bus_id));
+      response.Key("time").Value(bus_item.time);
+      response.Key("span_count").Value(static_cast<int>(bus_item.span_count));
+    }
+    void operator()(const TransportRouter::RouteInfo::WaitBusItem& wait_item) const {
+      response.Key("type").Value("WaitBus");
+      response.Key("stop_name").Value(db.GetStopName(wait_item.stop_id));
+      response.Key("time").Value(wait_item.time);
+    }
+    void operator()(const TransportRouter::RouteInfo::WalkToCompanyItem& walk_item) const {
+      response.Key("type").Value("WalkToCompany");
+      response.Key("stop_name").Value(db.GetStopName(walk_item.stop_id));
+      response.Key("company").Value(walk_item.company->cached_main_name());
+      response.Key("time").Value(walk_item.time);
+    }
+    void operator()(const TransportRouter::RouteInfo::WaitCompanyItem& wait_item) const {
+      response.Key("type").Value("WaitCompany");
+      response.Key("company").Value(wait_item.company->cached_main_name());
+      response.Key("time").Value(wait_item.time);
     }
   };
 
-  Json::Dict Route::Process(const TransportCatalog& db) const {
-    Json::Dict dict;
+  static void WriteRouteItems(const TransportCatalog& db, const TransportRouter::RouteInfo& route,
+                              Json::Writer& response) {
+    response.Key("total_time").Value(route.total_time);
+    response.Key("items").BeginArray();
+    for (const auto& item : route.items) {
+      response.BeginDict();
+      visit(RouteItemResponseBuilder{db, response}, item);
+      response.EndDict();
+    }
+    response.EndArray();
+  }
+
+  optional<string> Route::GetCacheKey() const {
+    return "Route\n" + stop_from + '\n' + stop_to;
+  }
+
+  void Route::Process(const TransportCatalog& db, Json::Writer& response) const {
+    METRICS_SPAN("requests: Route");
     const auto route = db.FindRoute(stop_from, stop_to);
     if (!route) {
-      dict["error_message"] = Json::Node("not found"s);
-    } else {
-      dict["total_time"] = Json::Node(route->total_time);
+      response.Key("error_message").Value("not found");
+      return;
+    }
+    WriteRouteItems(db, *route, response);
+    response.Key("map").Value(db.RenderRoute(*route));
+  }
 
-      Json::Array items;
-      items.reserve(route->items.size());
-      for (const auto& item : route->items) {
-        items.push_back(visit(RouteItemResponseBuilder{}, item));
-      }
+  void Map::Process(const TransportCatalog& db, Json::Writer& response) const {
+    METRICS_SPAN("requests: Map");
+    const auto map = visit(
+        [&db](const auto& part) {
+          if constexpr (is_same_v<decay_t<decltype(part)>, monostate>) {
+            return db.RenderMap();
+          } else {
+            return db.RenderMap(part);
+          }
+        },
+        this->part);
+    response.Key("map").Value(map);
+  }
 
-      dict["items"] = move(items);
-      dict["map"] = Json::Node(db.RenderRoute(*route));
+  static void AppendToKey(string& key, double value) {
+    char chars[32];
+    const auto result = to_chars(begin(chars), end(chars), value);  // shortest exact form
+    key += ' ';
+    key.append(chars, result.ptr);
+  }
+
+  optional<string> Map::GetCacheKey() const {
+    if (const auto* area = get_if<MapArea>(&part)) {
+      string key = "Map";
+      for (const double coord : {area->min.x, area->min.y, area->max.x, area->max.y}) {
+        AppendToKey(key, coord);
+      }
+      return key;
     }
-    return dict;
+    if (const auto* tile = get_if<MapTile>(&part)) {
+      return "Tile " + to_string(tile->zoom) + ' ' + to_string(tile->x) + ' ' + to_string(tile->y);
+    }
+    return nullopt;
   }
 
-  Json::Dict Map::Process(const TransportCatalog& db) const {
-    return Json::Dict{
-        {"map", Json::Node(db.RenderMap())},
-    };
+  static Map ReadMap(const Json::Dict& attrs) {
+    if (const auto it = attrs.find("viewport"); it != attrs.end()) {
+      const auto& viewport = it->second.AsMap();
+      return Map{MapArea{{viewport.at("min_x").AsDouble(), viewport.at("min_y").AsDouble()},
+                         {viewport.at("max_x").AsDouble(), viewport.at("max_y").AsDouble()}}};
+    }
+    if (const auto it = attrs.find("tile"); it != attrs.end()) {
+      const auto& tile = it->second.AsMap();
+      const int zoom = tile.at("zoom").AsInt();
+      const int x = tile.at("x").AsInt();
+      const int y = tile.at("y").AsInt();
+      auto in_range = [zoom](int coord) { return coord >= 0 && coord >> zoom == 0; };  // 0 <= coord < 2^zoom
+      if (zoom < 0 || zoom > static_cast<int>(MapTile::MAX_ZOOM) || !in_range(x) || !in_range(y)) {
+        throw invalid_argument("invalid tile: zoom " + to_string(zoom) + ", x " + to_string(x) + ", y " + to_string(y));
+      }
+      return Map{MapTile{static_cast<uint32_t>(zoom), static_cast<uint32_t>(x), static_cast<uint32_t>(y)}};
+    }
+    return Map{};
   }
 
-  Json::Dict FindCompanies::Process(const TransportCatalog& db) const {
-    const auto companies = db.FindCompanies(filter);
-    Json::Array items;
-    items.reserve(companies.size());
-    for (auto& company : companies) {
-      items.push_back(move(company));
+  void FindCompanies::Process(const TransportCatalog& db, Json::Writer& response) const {
+    METRICS_SPAN("requests: FindCompanies");
+    response.Key("companies").BeginArray();
+    for (const auto& company : db.FindCompanies(filter)) {
+      response.Value(company);
     }
-    return Json::Dict{{"companies", move(items)}};
+    response.EndArray();
   }
 
-  Json::Dict RouteToCompany::Process(const TransportCatalog& db) const {
-    Json::Dict dict;
+  void RouteToCompany::Process(const TransportCatalog& db, Json::Writer& response) const {
+    METRICS_SPAN("requests: RouteToCompany");
     auto route = db.FindRoute(datetime, stop_from, filter);
     if (!route) {
-      dict["error_message"] = Json::Node("not found"s);
-    } else {
-      dict["total_time"] = Json::Node(route->total_time);
-      Json::Array items;
-      items.reserve(route->items.size());
-      for (const auto& item : route->items) {
-        items.push_back(visit(RouteItemResponseBuilder{}, item));
-      }
-
-      dict["items"] = move(items);
-
-      if(!route->items.empty() && holds_alternative<TransportRouter::RouteInfo::WaitCompanyItem>(route->items.back())) {
-        // so, get rid of this hack :troll:
-        route->items.pop_back();
-      }
+      response.Key("error_message").Value("not found");
+      return;
+    }
+    WriteRouteItems(db, *route, response);
 
-      dict["map"] = Json::Node(db.RenderRoute(*route));
+    if(!route->items.empty() && holds_alternative<TransportRouter::RouteInfo::WaitCompanyItem>(route->items.back())) {
+      // so, get rid of this hack :troll:
+      route->items.pop_back();
     }
 
-    return dict;
+    response.Key("map").Value(db.RenderRoute(*route));
   }
 
   variant<Stop, Bus, Route, Map, FindCompanies, RouteToCompany> Read(const Json::Dict& attrs) {
@@ -148,19 +199,133 @@ namespace Requests {
       return RouteToCompany{attrs.at("from").AsString(), CompaniesFilter(attrs.at("companies").AsMap()),
                             DateTime{datetime[0].AsInt(), datetime[1].AsInt(), datetime[2].AsInt()}};
     } else {
-      return Map{};
+      return ReadMap(attrs);
+    }
+  }
+
+  template <typename Request>
+  static void ProcessCached(const TransportCatalog& db, const Request& request, Json::Writer& response,
+                            ResponseCache* cache) {
+    optional<string> key;
+    if constexpr (requires { request.GetCacheKey(); }) {
+      if (cache) {
+        key = request.GetCacheKey();
+      }
+    }
+    if (!key) {
+      request.Process(db, response);
+      return;
+    }
+
+    auto fields = cache->Find(*key);
+    METRICS_COUNT("requests: cache hits", fields ? 1 : 0);
+    if (!fields) {
+      string written;
+      Json::Writer writer(written);
+      request.Process(db, writer);
+      fields = make_shared<const string>(move(written));
+      cache->Add(*key, fields);
     }
+    response.Fields(*fields);
   }
 
-  Json::Array ProcessAll(const TransportCatalog& db, const Json::Array& requests) {
-    Json::Array responses;
-    responses.reserve(requests.size());
-    for (const Json::Node& request_node : requests) {
-      Json::Dict dict =
-          visit([&db](const auto& request) { return request.Process(db); }, Requests::Read(request_node.AsMap()));
-      dict["request_id"] = Json::Node(request_node.AsMap().at("id").AsInt());
-      responses.push_back(Json::Node(dict));
+  void Process(const TransportCatalog& db, const Json::Node& request_node, Json::Writer& response,
+               ResponseCache* cache) {
+    const auto& attrs = request_node.AsMap();
+    const auto request = Requests::Read(attrs);
+    response.BeginDict();
+    response.Key("request_id").Value(attrs.at("id").AsInt());
+    visit([&](const auto& request) { ProcessCached(db, request, response, cache); }, request);
+    response.EndDict();
+  }
+
+  void ProcessAll(const TransportCatalog& db, const Json::Array& requests, ostream& output, size_t thread_count,
+                  ResponseCache* cache) {
+    auto process_request = [&db, &requests, cache](size_t request_idx) {
+      METRICS_SPAN("requests: processing");
+      string response;
+      Json::Writer writer(response);
+      Process(db, requests[request_idx], writer, cache);
+      return response;
+    };
+    auto write_response = [&output](size_t request_idx, const string& response) {
+      METRICS_SPAN("requests: output");
+      if (request_idx > 0) {
+        output << ", ";
+      }
+      output << response;
+    };
+
+    output << '[';
+    thread_count = clamp<size_t>(thread_count, 1, max<size_t>(requests.size(), 1));
+    if (thread_count == 1) {
+      for (size_t request_idx = 0; request_idx < requests.size(); ++request_idx) {
+        write_response(request_idx, process_request(request_idx));
+      }
+      output << ']';
+      return;
+    }
+
+    // Requests differ in cost a lot (Route renders a map), so threads pick them one by one.
+    // They run at most `window` requests ahead of the output, so responses queued behind a slow one stay few.
+    // A failed request keeps its exception, to be rethrown here in order, as the single thread would
+    using ReadyResponse = variant<string, exception_ptr>;
+    const size_t window = thread_count * 4;
+    vector<optional<ReadyResponse>> ready_responses(window);  // by request_idx % window
+    size_t next_request_idx = 0;
+    size_t written_count = 0;
+    mutex m;
+    condition_variable state_changed;
+
+    auto process_requests = [&] {
+      unique_lock lock(m);
+      while (true) {
+        state_changed.wait(lock, [&] {
+          return next_request_idx >= requests.size() || next_request_idx < written_count + window;
+        });
+        if (next_request_idx >= requests.size()) {
+          return;
+        }
+        const size_t request_idx = next_request_idx++;
+        lock.unlock();
+        ReadyResponse response;
+        try {
+          response = process_request(request_idx);
+        } catch (...) {
+          response = current_exception();
+        }
+        lock.lock();
+        ready_responses[request_idx % window] = move(response);
+        state_changed.notify_all();
+      }
+    };
+
+    vector<jthread> workers;
+    workers.reserve(thread_count);
+    for (size_t thread_idx = 0; thread_idx < thread_count; ++thread_idx) {
+      workers.emplace_back(process_requests);
+    }
+
+    for (size_t request_idx = 0; request_idx < requests.size(); ++request_idx) {
+      ReadyResponse response;
+      {
+        METRICS_SPAN("requests: waiting for response");
+        unique_lock lock(m);
+        auto& ready_response = ready_responses[request_idx % window];
+        state_changed.wait(lock, [&ready_response] { return ready_response.has_value(); });
+        response = move(*ready_response);
+        ready_response.reset();
+        ++written_count;
+        if (holds_alternative<exception_ptr>(response)) {
+          next_request_idx = requests.size();  // the workers finish what they have taken and stop
+        }
+      }
+      state_changed.notify_all();
+      if (holds_alternative<exception_ptr>(response)) {
+        rethrow_exception(get<exception_ptr>(response));
+      }
+      write_response(request_idx, get<string>(response));
     }
-    return responses;
+    output << ']';
   }
 }  // namespace Requests
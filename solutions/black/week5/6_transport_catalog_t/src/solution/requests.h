@@ -1,10 +1,14 @@
 #pragma once
 
+#include <optional>
+#include <ostream>
 #include <string>
 #include <variant>
 
 #include "filters.h"
 #include "json.h"
+#include "map_grid.h"
+#include "response_cache.h"
 #include "transport_catalog.h"
 #include "datetime.h"
 
@@ -12,30 +16,35 @@ namespace Requests {
   struct Stop {
     std::string name;
 
-    Json::Dict Process(const TransportCatalog& db) const;
+    void Process(const TransportCatalog& db, Json::Writer& response) const;
   };
 
   struct Bus {
     std::string name;
 
-    Json::Dict Process(const TransportCatalog& db) const;
+    void Process(const TransportCatalog& db, Json::Writer& response) const;
   };
 
   struct Route {
     std::string stop_from;
     std::string stop_to;
 
-    Json::Dict Process(const TransportCatalog& db) const;
+    void Process(const TransportCatalog& db, Json::Writer& response) const;
+    std::optional<std::string> GetCacheKey() const;
   };
 
   struct Map {
-    Json::Dict Process(const TransportCatalog& db) const;
+    std::variant<std::monostate, MapArea, MapTile> part;  // the whole map by default
+
+    void Process(const TransportCatalog& db, Json::Writer& response) const;
+    // The whole map is rendered once anyway, so only its parts are cached
+    std::optional<std::string> GetCacheKey() const;
   };
 
   struct FindCompanies {
     CompaniesFilter filter;
 
-    Json::Dict Process(const TransportCatalog& db) const;
+    void Process(const TransportCatalog& db, Json::Writer& response) const;
   };
 
   struct RouteToCompany {
@@ -43,10 +52,19 @@ namespace Requests {
     CompaniesFilter filter;
     DateTime datetime;
 
-    Json::Dict Process(const TransportCatalog& db) const;
+    void Process(const TransportCatalog& db, Json::Writer& response) const;
   };
 
   std::variant<Stop, Bus, Route, Map, FindCompanies, RouteToCompany> Read(const Json::Dict& attrs);
 
-  Json::Array ProcessAll(const TransportCatalog& db, const Json::Array& requests);
+  // Response to a single stat request, tagged with its request_id.
+  // Each Process above writes its fields into the response dict opened here.
+  // Requests with a GetCacheKey keep their fields in the cache, if one is given.
+  void Process(const TransportCatalog& db, const Json::Node& request_node, Json::Writer& response,
+               ResponseCache* cache = nullptr);
+
+  // Requests are spread over thread_count threads. Responses are written as a JSON array in the order of requests,
+  // each one as soon as it and all the previous ones are ready.
+  void ProcessAll(const TransportCatalog& db, const Json::Array& requests, std::ostream& output,
+                  size_t thread_count = 1, ResponseCache* cache = nullptr);
 }  // namespace Requests
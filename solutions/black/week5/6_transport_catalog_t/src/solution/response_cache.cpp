@@ -0,0 +1,47 @@
+#include "response_cache.h"
+
+#include <utility>
+
+using namespace std;
+
+ResponseCache::Response ResponseCache::Find(const string& key) {
+  lock_guard guard(mutex_);
+  const auto it = entry_by_key_.find(key);
+  if (it == entry_by_key_.end()) {
+    ++misses_;
+    return nullptr;
+  }
+  ++hits_;
+  entries_.splice(entries_.begin(), entries_, it->second);
+  return it->second->response;
+}
+
+void ResponseCache::Add(const string& key, Response response) {
+  const size_t size = key.size() + response->size();
+  if (size > max_size_) {
+    return;
+  }
+
+  lock_guard guard(mutex_);
+  if (entry_by_key_.count(key)) {
+    return;  // added by another thread that missed at the same time
+  }
+  Evict(max_size_ - size);
+  entries_.push_front(Entry{key, move(response)});
+  entry_by_key_.emplace(entries_.front().key, entries_.begin());
+  size_ += size;
+}
+
+ResponseCache::Stats ResponseCache::GetStats() const {
+  lock_guard guard(mutex_);
+  return {hits_, misses_, size_, entries_.size()};
+}
+
+void ResponseCache::Evict(size_t max_size) {
+  while (size_ > max_size) {
+    const Entry& entry = entries_.back();
+    size_ -= entry.GetSize();
+    entry_by_key_.erase(entry.key);
+    entries_.pop_back();
+  }
+}
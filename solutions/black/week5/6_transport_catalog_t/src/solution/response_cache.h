@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+// Serialized responses by normalized requests, least recently used ones are evicted to stay within max_size bytes.
+// Safe to share between threads.
+class ResponseCache {
+ public:
+  using Response = std::shared_ptr<const std::string>;
+
+  explicit ResponseCache(size_t max_size) : max_size_(max_size) {}
+
+  // Returns nullptr on a miss
+  Response Find(const std::string& key);
+  // Responses bigger than the whole cache are not kept
+  void Add(const std::string& key, Response response);
+
+  struct Stats {
+    size_t hits = 0;
+    size_t misses = 0;
+    size_t size = 0;  // bytes of keys and responses
+    size_t entry_count = 0;
+  };
+  Stats GetStats() const;
+
+ private:
+  struct Entry {
+    std::string key;
+    Response response;
+
+    size_t GetSize() const { return key.size() + response->size(); }
+  };
+  using Entries = std::list<Entry>;  // most recently used first
+
+  void Evict(size_t max_size);
+
+  const size_t max_size_;
+  mutable std::mutex mutex_;
+  Entries entries_;
+  std::unordered_map<std::string_view, Entries::iterator> entry_by_key_;  // keys point into the entries
+  size_t size_ = 0;
+  size_t hits_ = 0;
+  size_t misses_ = 0;
+};
@@ -1,31 +1,33 @@
 #pragma once
 
-#include <algorithm>
-#include <cassert>
 #include <cstdint>
-#include <iterator>
-#include <memory>
+#include <functional>
+#include <mutex>
 #include <optional>
-#include <type_traits>
 #include <unordered_map>
 #include <utility>
 #include <vector>
 
+#include "base_file.h"
 #include "graph.h"
 #include "graph.pb.h"
 
 namespace Graph {
 
+  // Common interface of shortest path engines over DirectedWeightedGraph.
+  // Implementations differ in what they precompute, the expanded routes cache is shared.
+  // Queries are safe to run concurrently: engines keep no per-query state, the cache is locked.
   template <typename Weight>
   class Router {
-   private:
+   protected:
     using Graph = DirectedWeightedGraph<Weight>;
 
    public:
-    Router(const Graph& graph);
+    explicit Router(const Graph& graph) : graph_(graph) {}
+    virtual ~Router() = default;
 
-    void Serialize(GraphProto::Router& proto);
-    static std::unique_ptr<Router> Deserialize(const GraphProto::Router& proto, const Graph& graph);
+    // Large tables go to the base file as flat arrays, the rest to the message
+    virtual void Serialize(GraphProto::Router& proto, BaseFile::Writer& base_file) const = 0;
 
     using RouteId = uint64_t;
 
@@ -35,160 +37,77 @@ namespace Graph {
       size_t edge_count;
     };
 
-    std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const;
-    std::optional<Weight> GetWeight(VertexId from, VertexId to) const;
+    virtual std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const = 0;
+    virtual std::optional<Weight> GetWeight(VertexId from, VertexId to) const = 0;
+
+    // Full cost of finishing at targets[target_idx] after a route of the given weight.
+    // Must be not less than the weight and must not decrease as the weight grows.
+    using TargetCost = std::function<Weight(size_t target_idx, Weight route_weight)>;
+
+    struct TargetRouteInfo {
+      size_t target_idx;
+      Weight cost;
+      RouteInfo route;
+    };
+
+    // Route to the target of the least cost, ties go to the least target_idx.
+    // Queries every target separately unless the engine can search one-to-many.
+    virtual std::optional<TargetRouteInfo> BuildRouteToBestTarget(VertexId from, const std::vector<VertexId>& targets,
+                                                                  const TargetCost& target_cost) const;
+
     EdgeId GetRouteEdge(RouteId route_id, size_t edge_idx) const;
     void ReleaseRoute(RouteId route_id);
 
-   private:
-    Router(const Graph& graph, const GraphProto::Router& proto);
+   protected:
+    RouteInfo SaveRoute(Weight weight, std::vector<EdgeId> edges) const;
 
     const Graph& graph_;
 
-    struct RouteInternalData {
-      Weight weight;
-      std::optional<EdgeId> prev_edge;
-    };
-    using RoutesInternalData = std::vector<std::vector<std::optional<RouteInternalData>>>;
-
+   private:
     using ExpandedRoute = std::vector<EdgeId>;
+    mutable std::mutex expanded_routes_mutex_;
     mutable RouteId next_route_id_ = 0;
     mutable std::unordered_map<RouteId, ExpandedRoute> expanded_routes_cache_;
-
-    void InitializeRoutesInternalData(const Graph& graph) {
-      const size_t vertex_count = graph.GetVertexCount();
-      for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
-        routes_internal_data_[vertex][vertex] = RouteInternalData{0, std::nullopt};
-        for (const EdgeId edge_id : graph.GetIncidentEdges(vertex)) {
-          const auto& edge = graph.GetEdge(edge_id);
-          assert(edge.weight >= 0);
-          auto& route_internal_data = routes_internal_data_[vertex][edge.to];
-          if (!route_internal_data || route_internal_data->weight > edge.weight) {
-            route_internal_data = RouteInternalData{edge.weight, edge_id};
-          }
-        }
-      }
-    }
-
-    void RelaxRoute(VertexId vertex_from, VertexId vertex_to, const RouteInternalData& route_from,
-                    const RouteInternalData& route_to) {
-      auto& route_relaxing = routes_internal_data_[vertex_from][vertex_to];
-      const Weight candidate_weight = route_from.weight + route_to.weight;
-      if (!route_relaxing || candidate_weight < route_relaxing->weight) {
-        route_relaxing = {candidate_weight, route_to.prev_edge ? route_to.prev_edge : route_from.prev_edge};
-      }
-    }
-
-    void RelaxRoutesInternalDataThroughVertex(size_t vertex_count, VertexId vertex_through) {
-      for (VertexId vertex_from = 0; vertex_from < vertex_count; ++vertex_from) {
-        if (const auto& route_from = routes_internal_data_[vertex_from][vertex_through]) {
-          for (VertexId vertex_to = 0; vertex_to < vertex_count; ++vertex_to) {
-            if (const auto& route_to = routes_internal_data_[vertex_through][vertex_to]) {
-              RelaxRoute(vertex_from, vertex_to, *route_from, *route_to);
-            }
-          }
-        }
-      }
-    }
-
-    RoutesInternalData routes_internal_data_;
   };
 
   template <typename Weight>
-  Router<Weight>::Router(const Graph& graph)
-      : graph_(graph),
-        routes_internal_data_(graph.GetVertexCount(),
-                              std::vector<std::optional<RouteInternalData>>(graph.GetVertexCount())) {
-    InitializeRoutesInternalData(graph);
-
-    const size_t vertex_count = graph.GetVertexCount();
-    for (VertexId vertex_through = 0; vertex_through < vertex_count; ++vertex_through) {
-      RelaxRoutesInternalDataThroughVertex(vertex_count, vertex_through);
-    }
-  }
-
-  template <typename Weight>
-  void Router<Weight>::Serialize(GraphProto::Router& proto) {
-    static_assert(std::is_same_v<Weight, double>, "Serialization is implemented only for double weights");
-
-    for (const auto& source_data : routes_internal_data_) {
-      auto& source_data_proto = *proto.add_sources_data();
-      for (const auto& route_data : source_data) {
-        auto& route_data_proto = *source_data_proto.add_targets_data();
-        if (route_data) {
-          route_data_proto.set_exists(true);
-          route_data_proto.set_weight(route_data->weight);
-          if (route_data->prev_edge) {
-            route_data_proto.set_has_prev_edge(true);
-            route_data_proto.set_prev_edge(*route_data->prev_edge);
-          }
+  std::optional<typename Router<Weight>::TargetRouteInfo> Router<Weight>::BuildRouteToBestTarget(
+      VertexId from, const std::vector<VertexId>& targets, const TargetCost& target_cost) const {
+    std::optional<std::pair<size_t, Weight>> best_target;
+    for (size_t target_idx = 0; target_idx < targets.size(); ++target_idx) {
+      if (const auto weight = GetWeight(from, targets[target_idx])) {
+        const Weight cost = target_cost(target_idx, *weight);
+        if (!best_target || cost < best_target->second) {
+          best_target = {target_idx, cost};
         }
       }
     }
-  }
-
-  template <typename Weight>
-  Router<Weight>::Router(const Graph& graph, const GraphProto::Router& proto) : graph_(graph) {
-    static_assert(std::is_same_v<Weight, double>, "Serialization is implemented only for double weights");
-
-    routes_internal_data_.reserve(proto.sources_data_size());
-    for (const auto& source_data_proto : proto.sources_data()) {
-      auto& source_data = routes_internal_data_.emplace_back();
-      source_data.reserve(source_data_proto.targets_data_size());
-      for (const auto& route_data_proto : source_data_proto.targets_data()) {
-        auto& route_data = source_data.emplace_back();
-        if (route_data_proto.exists()) {
-          route_data = RouteInternalData{route_data_proto.weight(), std::nullopt};
-          if (route_data_proto.has_prev_edge()) {
-            route_data->prev_edge = route_data_proto.prev_edge();
-          }
-        }
-      }
-    }
-  }
-
-  template <typename Weight>
-  std::unique_ptr<Router<Weight>> Router<Weight>::Deserialize(const GraphProto::Router& proto, const Graph& graph) {
-    return std::unique_ptr<Router>(new Router(graph, proto));  // ctor is private, so can't use make_unique
-  }
-
-  template <typename Weight>
-  std::optional<typename Router<Weight>::RouteInfo> Router<Weight>::BuildRoute(VertexId from, VertexId to) const {
-    const auto& route_internal_data = routes_internal_data_[from][to];
-    if (!route_internal_data) {
-      return std::nullopt;
-    }
-    const Weight weight = route_internal_data->weight;
-    std::vector<EdgeId> edges;
-    for (std::optional<EdgeId> edge_id = route_internal_data->prev_edge; edge_id;
-         edge_id = routes_internal_data_[from][graph_.GetEdge(*edge_id).from]->prev_edge) {
-      edges.push_back(*edge_id);
-    }
-    std::reverse(std::begin(edges), std::end(edges));
-
-    const RouteId route_id = next_route_id_++;
-    const size_t route_edge_count = edges.size();
-    expanded_routes_cache_[route_id] = std::move(edges);
-    return RouteInfo{route_id, weight, route_edge_count};
-  }
-
-  template <typename Weight>
-  std::optional<Weight> Router<Weight>::GetWeight(VertexId from, VertexId to) const {
-    const auto& route_internal_data_ = routes_internal_data_[from][to];
-    if (!route_internal_data_) {
+    if (!best_target) {
       return std::nullopt;
     }
-    return route_internal_data_->weight;
+    const auto& [target_idx, cost] = *best_target;
+    return TargetRouteInfo{target_idx, cost, *BuildRoute(from, targets[target_idx])};
   }
 
   template <typename Weight>
   EdgeId Router<Weight>::GetRouteEdge(RouteId route_id, size_t edge_idx) const {
+    std::lock_guard guard(expanded_routes_mutex_);
     return expanded_routes_cache_.at(route_id)[edge_idx];
   }
 
   template <typename Weight>
   void Router<Weight>::ReleaseRoute(RouteId route_id) {
+    std::lock_guard guard(expanded_routes_mutex_);
     expanded_routes_cache_.erase(route_id);
   }
 
+  template <typename Weight>
+  typename Router<Weight>::RouteInfo Router<Weight>::SaveRoute(Weight weight, std::vector<EdgeId> edges) const {
+    const size_t route_edge_count = edges.size();
+    std::lock_guard guard(expanded_routes_mutex_);
+    const RouteId route_id = next_route_id_++;
+    expanded_routes_cache_[route_id] = std::move(edges);
+    return RouteInfo{route_id, weight, route_edge_count};
+  }
+
 }  // namespace Graph
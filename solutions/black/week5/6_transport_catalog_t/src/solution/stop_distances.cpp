@@ -0,0 +1,50 @@
+#include "stop_distances.h"
+
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+
+using namespace std;
+
+StopDistances::StopDistances(const Descriptions::StopsDict& stops_dict, const Interner& stop_names)
+    : offsets_(stop_names.GetSize() + 1, 0) {
+  // Stops of the dict go in the order of their ids
+  for (const auto& [stop_name, stop] : stops_dict) {
+    const StopId stop_id = stop_names.GetId(stop_name);
+    for (const auto& [neighbour_name, distance] : stop->distances) {
+      if (const auto neighbour_id = stop_names.FindId(neighbour_name)) {
+        neighbours_.push_back({*neighbour_id, static_cast<uint32_t>(distance)});
+      }
+    }
+    offsets_[stop_id + 1] = neighbours_.size();
+    sort(begin(neighbours_) + offsets_[stop_id], end(neighbours_),
+         [](const Neighbour& lhs, const Neighbour& rhs) { return lhs.stop_id < rhs.stop_id; });
+  }
+}
+
+const StopDistances::Neighbour* StopDistances::Find(StopId from, StopId to) const {
+  const auto row_begin = begin(neighbours_) + offsets_[from];
+  const auto row_end = begin(neighbours_) + offsets_[from + 1];
+  const auto it = lower_bound(row_begin, row_end, to,
+                              [](const Neighbour& neighbour, StopId stop_id) { return neighbour.stop_id < stop_id; });
+  return it != row_end && it->stop_id == to ? &*it : nullptr;
+}
+
+uint32_t StopDistances::Get(StopId from, StopId to) const {
+  if (const Neighbour* neighbour = Find(from, to)) {
+    return neighbour->distance;
+  }
+  if (const Neighbour* neighbour = Find(to, from)) {
+    return neighbour->distance;
+  }
+  throw out_of_range("no road distance between stops");
+}
+
+vector<uint32_t> StopDistances::GetSegments(const vector<StopId>& stops) const {
+  vector<uint32_t> segments;
+  segments.reserve(stops.size());
+  for (size_t stop_idx = 1; stop_idx < stops.size(); ++stop_idx) {
+    segments.push_back(Get(stops[stop_idx - 1], stops[stop_idx]));
+  }
+  return segments;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "descriptions.h"
+#include "interner.h"
+
+// Road distances from every stop to its neighbours, rows of (neighbour id, meters) sorted by neighbour id.
+// Built once for a base, so that distances along routes are found without hashing stop names.
+class StopDistances {
+ public:
+  StopDistances(const Descriptions::StopsDict& stops_dict, const Interner& stop_names);
+
+  // The distance given for this direction, or else for the opposite one.
+  // Throws std::out_of_range if neither is given.
+  uint32_t Get(StopId from, StopId to) const;
+  // Distances between consecutive stops of a route
+  std::vector<uint32_t> GetSegments(const std::vector<StopId>& stops) const;
+
+ private:
+  struct Neighbour {
+    StopId stop_id;
+    uint32_t distance;
+  };
+
+  const Neighbour* Find(StopId from, StopId to) const;
+
+  std::vector<uint32_t> offsets_;  // stop count + 1 items, row of a stop is [offsets[id], offsets[id + 1])
+  std::vector<Neighbour> neighbours_;
+};
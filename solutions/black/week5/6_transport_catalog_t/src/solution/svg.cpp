@@ -1,24 +1,74 @@
 #include "svg.h"
 
+#include <charconv>
+
+#include "json.h"
+
 using namespace std;
 
 namespace Svg {
 
-  void RenderColor(ostream& out, monostate) { out << "none"; }
+  Writer& Writer::operator<<(char c) {
+    if (escaping_ == Escaping::JSON) {
+      Json::AppendEscaped(buffer_, string_view(&c, 1));
+    } else {
+      buffer_ += c;
+    }
+    return *this;
+  }
+
+  Writer& Writer::operator<<(string_view text) {
+    if (escaping_ == Escaping::NONE) {
+      buffer_ += text;
+      return *this;
+    }
+    Json::AppendEscaped(buffer_, text);
+    return *this;
+  }
+
+  Writer& Writer::operator<<(double value) {
+    char chars[32];
+    const auto result = to_chars(begin(chars), end(chars), value, chars_format::general, 6);
+    buffer_.append(chars, result.ptr);
+    return *this;
+  }
+
+  Writer& Writer::operator<<(int value) {
+    char chars[16];
+    const auto result = to_chars(begin(chars), end(chars), value);
+    buffer_.append(chars, result.ptr);
+    return *this;
+  }
+
+  Writer& Writer::operator<<(uint32_t value) {
+    char chars[16];
+    const auto result = to_chars(begin(chars), end(chars), value);
+    buffer_.append(chars, result.ptr);
+    return *this;
+  }
+
+  void Object::Render(ostream& out) const {
+    string buffer;
+    Writer writer(buffer);
+    Render(writer);
+    out << buffer;
+  }
 
-  void RenderColor(ostream& out, const string& value) { out << value; }
+  void RenderColor(Writer& out, monostate) { out << "none"; }
 
-  void RenderColor(ostream& out, Rgb rgb) {
+  void RenderColor(Writer& out, const string& value) { out << value; }
+
+  void RenderColor(Writer& out, Rgb rgb) {
     out << "rgb(" << static_cast<int>(rgb.red) << "," << static_cast<int>(rgb.green) << ","
         << static_cast<int>(rgb.blue) << ")";
   }
 
-  void RenderColor(ostream& out, Rgba rgba) {
+  void RenderColor(Writer& out, Rgba rgba) {
     out << "rgba(" << static_cast<int>(rgba.red) << "," << static_cast<int>(rgba.green) << ","
         << static_cast<int>(rgba.blue) << "," << rgba.opacity << ")";
   }
 
-  void RenderColor(ostream& out, const Color& color) {
+  void RenderColor(Writer& out, const Color& color) {
     visit([&out](const auto& value) { RenderColor(out, value); }, color);
   }
 
@@ -31,13 +81,10 @@ namespace Svg {
     return *this;
   }
 
-  void Circle::Render(ostream& out) const {
-    out << "<circle ";
-    out << "cx=\"" << center_.x << "\" ";
-    out << "cy=\"" << center_.y << "\" ";
-    out << "r=\"" << radius_ << "\" ";
-    PathProps::RenderAttrs(out);
-    out << "/>";
+  void Circle::Render(Writer& out) const {
+    Document document;
+    document.Add(*this);
+    document.RenderObjects(out);
   }
 
   Polyline& Polyline::AddPoint(Point point) {
@@ -45,15 +92,10 @@ namespace Svg {
     return *this;
   }
 
-  void Polyline::Render(ostream& out) const {
-    out << "<polyline ";
-    out << "points=\"";
-    for (const Point point : points_) {
-      out << point.x << "," << point.y << " ";
-    }
-    out << "\" ";
-    PathProps::RenderAttrs(out);
-    out << "/>";
+  void Polyline::Render(Writer& out) const {
+    Document document;
+    document.Add(*this);
+    document.RenderObjects(out);
   }
 
   Rectangle& Rectangle::SetTopLeftPoint(Point point) {
@@ -65,14 +107,10 @@ namespace Svg {
     return *this;
   }
 
-  void Rectangle::Render(ostream& out) const {
-    out << "<rect ";
-    out << "x=\"" << top_left_point_.x << "\" ";
-    out << "y=\"" << top_left_point_.y << "\" ";
-    out << "width=\"" << (bottom_right_point_.x - top_left_point_.x) << "\" ";
-    out << "height=\"" << (bottom_right_point_.y - top_left_point_.y) << "\" ";
-    PathProps::RenderAttrs(out);
-    out << "/>";
+  void Rectangle::Render(Writer& out) const {
+    Document document;
+    document.Add(*this);
+    document.RenderObjects(out);
   }
 
   Text& Text::SetPoint(Point point) {
@@ -105,12 +143,7 @@ namespace Svg {
     return *this;
   }
 
-  void Text::Render(ostream& out) const {
-    out << "<text ";
-    out << "x=\"" << point_.x << "\" ";
-    out << "y=\"" << point_.y << "\" ";
-    out << "dx=\"" << offset_.x << "\" ";
-    out << "dy=\"" << offset_.y << "\" ";
+  void Text::RenderFontAttrs(Writer& out) const {
     out << "font-size=\"" << font_size_ << "\" ";
     if (font_family_) {
       out << "font-family=\"" << *font_family_ << "\" ";
@@ -118,34 +151,98 @@ namespace Svg {
     if (font_weight_) {
       out << "font-weight=\"" << *font_weight_ << "\" ";
     }
-    PathProps::RenderAttrs(out);
-    out << ">";
-    out << data_;
-    out << "</text>";
   }
 
-  Document::Document(const Document& other) {
-    objects_.reserve(other.objects_.size());
-    for (const auto& object : other.objects_) {
-      objects_.push_back(object->Copy());
+  void Text::Render(Writer& out) const {
+    Document document;
+    document.Add(*this);
+    document.RenderObjects(out);
+  }
+
+  void Document::Add(const Circle& circle) {
+    shapes_.push_back(CircleShape{circle.center_, circle.radius_, InternPathAttrs(circle)});
+  }
+
+  void Document::Add(const Polyline& polyline) {
+    const auto points_begin = static_cast<uint32_t>(points_.size());
+    points_.insert(end(points_), begin(polyline.points_), end(polyline.points_));
+    shapes_.push_back(PolylineShape{points_begin, static_cast<uint32_t>(points_.size()), InternPathAttrs(polyline)});
+  }
+
+  void Document::Add(const Rectangle& rectangle) {
+    shapes_.push_back(
+        RectangleShape{rectangle.top_left_point_, rectangle.bottom_right_point_, InternPathAttrs(rectangle)});
+  }
+
+  void Document::Add(const Text& text) {
+    attrs_buffer_.clear();
+    Writer writer(attrs_buffer_);
+    text.RenderFontAttrs(writer);
+    const StringId font_attrs = Intern(attrs_buffer_);
+    shapes_.push_back(TextShape{text.point_, text.offset_, font_attrs, InternPathAttrs(text), Intern(text.data_)});
+  }
+
+  Document::StringId Document::Intern(const string& value) {
+    const auto [it, inserted] = string_ids_.try_emplace(value, static_cast<StringId>(strings_.size()));
+    if (inserted) {
+      strings_.push_back(value);
     }
+    return it->second;
+  }
+
+  void Document::Render(Writer& out) const {
+    out << DOCUMENT_HEADER;
+    RenderObjects(out);
+    out << DOCUMENT_FOOTER;
   }
 
-  Document& Document::operator=(const Document& other) {
-    if (this != &other) {
-      Document other_copy(other);
-      swap(*this, other_copy);
+  void Document::RenderObjects(Writer& out) const {
+    for (const Shape& shape : shapes_) {
+      visit([this, &out](const auto& typed_shape) { RenderShape(out, typed_shape); }, shape);
     }
-    return *this;
   }
 
-  void Document::Render(ostream& out) const {
-    out << "<?xml version=\"1.0\" encoding=\"UTF-8\" ?>";
-    out << "<svg xmlns=\"http://www.w3.org/2000/svg\" version=\"1.1\">";
-    for (const auto& object_ptr : objects_) {
-      object_ptr->Render(out);
+  void Document::RenderShape(Writer& out, const CircleShape& circle) const {
+    out << "<circle ";
+    out << "cx=\"" << circle.center.x << "\" ";
+    out << "cy=\"" << circle.center.y << "\" ";
+    out << "r=\"" << circle.radius << "\" ";
+    out << strings_[circle.path_attrs];
+    out << "/>";
+  }
+
+  void Document::RenderShape(Writer& out, const PolylineShape& polyline) const {
+    out << "<polyline ";
+    out << "points=\"";
+    for (uint32_t point_idx = polyline.points_begin; point_idx < polyline.points_end; ++point_idx) {
+      out << points_[point_idx].x << ',' << points_[point_idx].y << ' ';
     }
-    out << "</svg>";
+    out << "\" ";
+    out << strings_[polyline.path_attrs];
+    out << "/>";
+  }
+
+  void Document::RenderShape(Writer& out, const RectangleShape& rectangle) const {
+    out << "<rect ";
+    out << "x=\"" << rectangle.top_left_point.x << "\" ";
+    out << "y=\"" << rectangle.top_left_point.y << "\" ";
+    out << "width=\"" << (rectangle.bottom_right_point.x - rectangle.top_left_point.x) << "\" ";
+    out << "height=\"" << (rectangle.bottom_right_point.y - rectangle.top_left_point.y) << "\" ";
+    out << strings_[rectangle.path_attrs];
+    out << "/>";
+  }
+
+  void Document::RenderShape(Writer& out, const TextShape& text) const {
+    out << "<text ";
+    out << "x=\"" << text.point.x << "\" ";
+    out << "y=\"" << text.point.y << "\" ";
+    out << "dx=\"" << text.offset.x << "\" ";
+    out << "dy=\"" << text.offset.y << "\" ";
+    out << strings_[text.font_attrs];
+    out << strings_[text.path_attrs];
+    out << ">";
+    out << strings_[text.data];
+    out << "</text>";
   }
 
 }  // namespace Svg
@@ -1,10 +1,12 @@
 #pragma once
 
+#include <cstdint>
 #include <iostream>
 #include <memory>
 #include <optional>
 #include <string>
-#include <utility>
+#include <string_view>
+#include <unordered_map>
 #include <variant>
 #include <vector>
 
@@ -28,16 +30,37 @@ namespace Svg {
   using Color = std::variant<std::monostate, std::string, Rgb, Rgba>;
   const Color NoneColor{};
 
-  void RenderColor(std::ostream& out, std::monostate);
-  void RenderColor(std::ostream& out, const std::string& value);
-  void RenderColor(std::ostream& out, Rgb rgb);
-  void RenderColor(std::ostream& out, Rgba rgba);
-  void RenderColor(std::ostream& out, const Color& color);
+  // Appends markup right to a string, without stream state and locale.
+  // Doubles look as with default ostream formatting: %g with 6 significant digits.
+  // JSON escaping makes the markup ready to go into a JSON string literal as is.
+  class Writer {
+   public:
+    enum class Escaping { NONE, JSON };
+
+    explicit Writer(std::string& buffer, Escaping escaping = Escaping::NONE) : buffer_(buffer), escaping_(escaping) {}
+
+    Writer& operator<<(char c);
+    Writer& operator<<(std::string_view text);
+    Writer& operator<<(double value);
+    Writer& operator<<(int value);
+    Writer& operator<<(uint32_t value);
+
+   private:
+    std::string& buffer_;
+    Escaping escaping_;
+  };
+
+  void RenderColor(Writer& out, std::monostate);
+  void RenderColor(Writer& out, const std::string& value);
+  void RenderColor(Writer& out, Rgb rgb);
+  void RenderColor(Writer& out, Rgba rgba);
+  void RenderColor(Writer& out, const Color& color);
 
   class Object {
    public:
     virtual std::unique_ptr<Object> Copy() const = 0;
-    virtual void Render(std::ostream& out) const = 0;
+    virtual void Render(Writer& out) const = 0;
+    void Render(std::ostream& out) const;
     virtual ~Object() = default;
   };
 
@@ -56,7 +79,7 @@ namespace Svg {
     Owner& SetStrokeWidth(double value);
     Owner& SetStrokeLineCap(const std::string& value);
     Owner& SetStrokeLineJoin(const std::string& value);
-    void RenderAttrs(std::ostream& out) const;
+    void RenderAttrs(Writer& out) const;
 
    protected:
     Color fill_color_;
@@ -73,9 +96,12 @@ namespace Svg {
    public:
     Circle& SetCenter(Point point);
     Circle& SetRadius(double radius);
-    void Render(std::ostream& out) const override;
+    using Object::Render;
+    void Render(Writer& out) const override;
 
    private:
+    friend class Document;
+
     Point center_;
     double radius_ = 1;
   };
@@ -83,9 +109,12 @@ namespace Svg {
   class Polyline : public CopyableObject<Polyline>, public PathProps<Polyline> {
    public:
     Polyline& AddPoint(Point point);
-    void Render(std::ostream& out) const override;
+    using Object::Render;
+    void Render(Writer& out) const override;
 
    private:
+    friend class Document;
+
     std::vector<Point> points_;
   };
 
@@ -93,9 +122,12 @@ namespace Svg {
    public:
     Rectangle& SetTopLeftPoint(Point point);
     Rectangle& SetBottomRightPoint(Point point);
-    void Render(std::ostream& out) const override;
+    using Object::Render;
+    void Render(Writer& out) const override;
 
    private:
+    friend class Document;
+
     Point top_left_point_;
     Point bottom_right_point_;
   };
@@ -108,9 +140,14 @@ namespace Svg {
     Text& SetFontFamily(const std::string& value);
     Text& SetFontWeight(const std::string& value);
     Text& SetData(const std::string& data);
-    void Render(std::ostream& out) const override;
+    using Object::Render;
+    void Render(Writer& out) const override;
 
    private:
+    friend class Document;
+
+    void RenderFontAttrs(Writer& out) const;
+
     Point point_;
     Point offset_;
     uint32_t font_size_ = 1;
@@ -119,22 +156,69 @@ namespace Svg {
     std::string data_;
   };
 
+  inline constexpr std::string_view DOCUMENT_HEADER =
+      "<?xml version=\"1.0\" encoding=\"UTF-8\" ?><svg xmlns=\"http://www.w3.org/2000/svg\" version=\"1.1\">";
+  inline constexpr std::string_view DOCUMENT_FOOTER = "</svg>";
+
+  // Shapes are stored by value in one vector, polyline points share one pool,
+  // and the rendered style attributes and texts are interned, as maps repeat them a lot
   class Document : public CopyableObject<Document> {
    public:
-    Document() = default;
-    Document(const Document& other);
-    Document& operator=(const Document& other);
+    void Add(const Circle& circle);
+    void Add(const Polyline& polyline);
+    void Add(const Rectangle& rectangle);
+    void Add(const Text& text);
 
-    Document(Document&&) = default;
-    Document& operator=(Document&&) = default;
-
-    template <typename ObjectType>
-    void Add(ObjectType object);
-
-    void Render(std::ostream& out) const override;
+    using Object::Render;
+    void Render(Writer& out) const override;
+    // Objects only, without the header and footer, to be composed with other rendered documents
+    void RenderObjects(Writer& out) const;
 
    private:
-    std::vector<std::unique_ptr<Object>> objects_;
+    using StringId = uint32_t;
+
+    struct CircleShape {
+      Point center;
+      double radius;
+      StringId path_attrs;
+    };
+
+    struct PolylineShape {
+      uint32_t points_begin;
+      uint32_t points_end;
+      StringId path_attrs;
+    };
+
+    struct RectangleShape {
+      Point top_left_point;
+      Point bottom_right_point;
+      StringId path_attrs;
+    };
+
+    struct TextShape {
+      Point point;
+      Point offset;
+      StringId font_attrs;
+      StringId path_attrs;
+      StringId data;
+    };
+
+    using Shape = std::variant<CircleShape, PolylineShape, RectangleShape, TextShape>;
+
+    StringId Intern(const std::string& value);
+    template <typename Owner>
+    StringId InternPathAttrs(const PathProps<Owner>& props);
+
+    void RenderShape(Writer& out, const CircleShape& circle) const;
+    void RenderShape(Writer& out, const PolylineShape& polyline) const;
+    void RenderShape(Writer& out, const RectangleShape& rectangle) const;
+    void RenderShape(Writer& out, const TextShape& text) const;
+
+    std::vector<Shape> shapes_;
+    std::vector<Point> points_;
+    std::vector<std::string> strings_;
+    std::unordered_map<std::string, StringId> string_ids_;
+    std::string attrs_buffer_;  // reused to render attributes before interning them
   };
 
   template <typename Owner>
@@ -178,7 +262,7 @@ namespace Svg {
   }
 
   template <typename Owner>
-  void PathProps<Owner>::RenderAttrs(std::ostream& out) const {
+  void PathProps<Owner>::RenderAttrs(Writer& out) const {
     out << "fill=\"";
     RenderColor(out, fill_color_);
     out << "\" ";
@@ -194,9 +278,12 @@ namespace Svg {
     }
   }
 
-  template <typename ObjectType>
-  void Document::Add(ObjectType object) {
-    objects_.push_back(std::make_unique<ObjectType>(std::move(object)));
+  template <typename Owner>
+  Document::StringId Document::InternPathAttrs(const PathProps<Owner>& props) {
+    attrs_buffer_.clear();
+    Writer writer(attrs_buffer_);
+    props.RenderAttrs(writer);
+    return Intern(attrs_buffer_);
   }
 
 }  // namespace Svg
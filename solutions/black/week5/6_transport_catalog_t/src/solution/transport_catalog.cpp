@@ -1,158 +1,368 @@
 #include "transport_catalog.h"
 
 #include <algorithm>
+#include <future>
 #include <iterator>
 #include <map>
 #include <optional>
-#include <sstream>
+#include <span>
+#include <stdexcept>
+#include <string_view>
 #include <unordered_map>
 
+#include "metrics.h"
+#include "profile.h"
 #include "transport_catalog.pb.h"
 #include "utils.h"
 
 using namespace std;
 
 TransportCatalog::TransportCatalog(vector<Descriptions::InputQuery> data, YellowPages::Database yellow_pages,
-                                   const Json::Dict& routing_settings_json, const Json::Dict& render_settings_json) {
+                                   const Json::Dict& routing_settings_json, const Json::Dict& render_settings_json,
+                                   size_t thread_count)
+    : TransportCatalog(move(data), move(yellow_pages), routing_settings_json, render_settings_json, thread_count,
+                       ReusedParts{}) {}
+
+TransportCatalog::TransportCatalog(vector<Descriptions::InputQuery> data, YellowPages::Database yellow_pages,
+                                   const Json::Dict& routing_settings_json, const Json::Dict& render_settings_json,
+                                   size_t thread_count, ReusedParts reused_parts) {
   auto stops_end =
       partition(begin(data), end(data), [](const auto& item) { return holds_alternative<Descriptions::Stop>(item); });
 
   Descriptions::StopsDict stops_dict;
+  vector<string> stop_names;
   for (const auto& item : Range{begin(data), stops_end}) {
     const auto& stop = get<Descriptions::Stop>(item);
     stops_dict[stop.name] = &stop;
-    stops_.insert({stop.name, {}});
+    stop_names.push_back(stop.name);
   }
 
   Descriptions::BusesDict buses_dict;
+  vector<string> bus_names;
   for (const auto& item : Range{stops_end, end(data)}) {
     const auto& bus = get<Descriptions::Bus>(item);
-
     buses_dict[bus.name] = &bus;
-    buses_[bus.name] =
-        Bus{bus.stops.size(), ComputeUniqueItemsCount(AsRange(bus.stops)),
-            ComputeRoadRouteLength(bus.stops, stops_dict), ComputeGeoRouteDistance(bus.stops, stops_dict)};
+    bus_names.push_back(bus.name);
+  }
 
-    for (const string& stop_name : bus.stops) {
-      stops_.at(stop_name).bus_names.insert(bus.name);
+  names_ = make_shared<CatalogNames>(CatalogNames{Interner(move(stop_names)), Interner(move(bus_names))});
+  stops_.resize(names_->stops.GetSize());
+  buses_.resize(names_->buses.GetSize());
+
+  const StopDistances distances(stops_dict, names_->stops);
+
+  // Stages only read the descriptions and write their own members
+  auto router_built = async(launch::async, [&] {
+    if (reused_parts.router) {
+      router_ = move(reused_parts.router);
+      return;
+    }
+    LOG_DURATION("make_base: router");
+    router_ = make_unique<TransportRouter>(buses_dict, names_, distances, routing_settings_json, thread_count,
+                                           reused_parts.previous_router.get());
+  });
+  auto map_built = async(launch::async, [&] {
+    {
+      LOG_DURATION("make_base: map");
+      map_renderer_ = make_unique<MapRenderer>(stops_dict, buses_dict, names_, yellow_pages, render_settings_json);
+      rendered_map_ = RenderWholeMap(*map_renderer_);
+    }
+    if (reused_parts.yellow_pages_catalog) {
+      yellow_pages_catalog_ = move(reused_parts.yellow_pages_catalog);
+      return;
+    }
+    LOG_DURATION("make_base: yellow pages");
+    // The map is done with the companies
+    if (reused_parts.previous_yellow_pages_index) {
+      yellow_pages_catalog_ = make_unique<YellowPagesCatalog>(
+          move(yellow_pages), *reused_parts.previous_yellow_pages_index, *reused_parts.previous_base_file,
+          reused_parts.previous_company_ids);
+    } else {
+      yellow_pages_catalog_ = make_unique<YellowPagesCatalog>(move(yellow_pages));
+    }
+  });
+
+  {
+    LOG_DURATION("make_base: buses stats");
+    vector<Sphere::Point> stops_positions;
+    stops_positions.reserve(stops_dict.size());
+    for (const auto& [_, stop] : stops_dict) {
+      stops_positions.push_back(stop->position);  // the dict goes in the order of ids
+    }
+
+    // Buses go in the order of ids, so the lists of stops stay sorted
+    for (const auto& [name, bus] : buses_dict) {
+      const BusId bus_id = names_->buses.GetId(name);
+      const vector<StopId> stop_ids = names_->stops.GetIds(bus->stops);
+      if (const auto it = reused_parts.buses.find(name); it != reused_parts.buses.end()) {
+        buses_[bus_id] = it->second;
+      } else {
+        buses_[bus_id] = Bus{stop_ids.size(), ComputeUniqueItemsCount(AsRange(stop_ids)),
+                             ComputeRoadRouteLength(stop_ids, distances),
+                             ComputeGeoRouteDistance(stop_ids, stops_positions)};
+      }
+
+      for (const StopId stop_id : stop_ids) {
+        auto& bus_ids = stops_[stop_id].bus_ids;
+        if (bus_ids.empty() || bus_ids.back() != bus_id) {
+          bus_ids.push_back(bus_id);
+        }
+      }
     }
   }
 
-  router_ = make_unique<TransportRouter>(stops_dict, buses_dict, routing_settings_json);
+  sources_.routing_settings = routing_settings_json;
+  sources_.render_settings = render_settings_json;
+  for (const auto& [_, stop] : stops_dict) {
+    sources_.stops.push_back(*stop);
+  }
+  for (const auto& [_, bus] : buses_dict) {
+    sources_.buses.push_back(*bus);
+  }
 
-  map_renderer_ = make_unique<MapRenderer>(stops_dict, buses_dict, yellow_pages, render_settings_json);
-  map_ = map_renderer_->Render();
-  yellow_pages_catalog_ = make_unique<YellowPagesCatalog>(move(yellow_pages));
+  router_built.get();
+  map_built.get();
 }
 
 const TransportCatalog::Stop* TransportCatalog::GetStop(const string& name) const {
-  return GetValuePointer(stops_, name);
+  const auto id = names_->stops.FindId(name);
+  return id ? &stops_[*id] : nullptr;
 }
 
 const TransportCatalog::Bus* TransportCatalog::GetBus(const string& name) const {
-  return GetValuePointer(buses_, name);
+  const auto id = names_->buses.FindId(name);
+  return id ? &buses_[*id] : nullptr;
 }
 
 optional<TransportRouter::RouteInfo> TransportCatalog::FindRoute(const string& stop_from, const string& stop_to) const {
-  return router_->FindRoute(stop_from, stop_to);
+  return router_->FindRoute(names_->stops.GetId(stop_from), names_->stops.GetId(stop_to));
 }
 
 optional<TransportRouter::RouteInfo> TransportCatalog::FindRoute(const DateTime& datetime, const string& stop_from,
                                                                  const CompaniesFilter& filter) const {
   const auto companies = yellow_pages_catalog_->FindCompanies(filter);
-  return router_->FindFastestRouteToAnyCompany(datetime, stop_from, companies);
+  vector<const WeeklySchedule*> schedules;
+  schedules.reserve(companies.size());
+  for (const auto* company : companies) {
+    schedules.push_back(&yellow_pages_catalog_->GetSchedule(*company));
+  }
+  return router_->FindFastestRouteToAnyCompany(datetime, names_->stops.GetId(stop_from), companies, schedules);
+}
+
+Json::EscapedString TransportCatalog::RenderMap() const {
+  return {rendered_map_};
+}
+
+Json::EscapedString TransportCatalog::RenderMap(MapArea area) const {
+  METRICS_SPAN("catalog: RenderMap area");
+  Json::EscapedString result;
+  Svg::Writer writer(result.value, Svg::Writer::Escaping::JSON);
+  map_renderer_->Render(area).Render(writer);
+  return result;
 }
 
-string TransportCatalog::RenderMap() const {
-  ostringstream out;
-  map_.Render(out);
-  return out.str();
+Json::EscapedString TransportCatalog::RenderMap(MapTile tile) const {
+  return RenderMap(map_renderer_->GetTileArea(tile));
 }
 
-string TransportCatalog::RenderRoute(const TransportRouter::RouteInfo& route) const {
-  ostringstream out;
-  BuildRouteMap(route).Render(out);
-  return out.str();
+Json::EscapedString TransportCatalog::RenderRoute(const TransportRouter::RouteInfo& route) const {
+  METRICS_SPAN("catalog: RenderRoute");
+  // The whole map is copied as is, the route layers go right before its footer
+  // (the footer has nothing to escape, so its length is the same in the escaped map)
+  const string_view map_body = string_view(rendered_map_).substr(0, rendered_map_.size() - Svg::DOCUMENT_FOOTER.size());
+  Json::EscapedString result;
+  result.value.reserve(rendered_map_.size() + rendered_map_.size() / 8);
+  result.value += map_body;
+  Svg::Writer writer(result.value, Svg::Writer::Escaping::JSON);
+  map_renderer_->RenderRoute(route).RenderObjects(writer);
+  writer << Svg::DOCUMENT_FOOTER;
+  return result;
 }
 
-size_t TransportCatalog::ComputeRoadRouteLength(const vector<string>& stops,
-                                                const Descriptions::StopsDict& stops_dict) {
+size_t TransportCatalog::ComputeRoadRouteLength(const vector<StopId>& stops, const StopDistances& distances) {
   size_t result = 0;
   for (size_t i = 1; i < stops.size(); ++i) {
-    result += Descriptions::ComputeStopsDistance(*stops_dict.at(stops[i - 1]), *stops_dict.at(stops[i]));
+    result += distances.Get(stops[i - 1], stops[i]);
   }
   return result;
 }
 
-double TransportCatalog::ComputeGeoRouteDistance(const vector<string>& stops,
-                                                 const Descriptions::StopsDict& stops_dict) {
+double TransportCatalog::ComputeGeoRouteDistance(const vector<StopId>& stops,
+                                                 const vector<Sphere::Point>& stops_positions) {
   double result = 0;
   for (size_t i = 1; i < stops.size(); ++i) {
-    result += Sphere::Distance(stops_dict.at(stops[i - 1])->position, stops_dict.at(stops[i])->position);
+    result += Sphere::Distance(stops_positions[stops[i - 1]], stops_positions[stops[i]]);
   }
   return result;
 }
 
-Svg::Document TransportCatalog::BuildRouteMap(const TransportRouter::RouteInfo& route) const {
-  return map_renderer_->RenderRoute(map_, route);
+string TransportCatalog::RenderWholeMap(const MapRenderer& map_renderer) {
+  string result;
+  Svg::Writer writer(result, Svg::Writer::Escaping::JSON);
+  map_renderer.Render().Render(writer);
+  return result;
 }
 
 string TransportCatalog::Serialize() const {
   TCProto::TransportCatalog db_proto;
-  for (const auto& [name, stop] : stops_) {
+  names_->stops.Serialize(*db_proto.mutable_stop_names());
+  names_->buses.Serialize(*db_proto.mutable_bus_names());
+
+  for (const auto& stop : stops_) {
     TCProto::StopResponse& stop_proto = *db_proto.add_stops();
-    stop_proto.set_name(name);
-    for (const string& bus_name : stop.bus_names) {
-      stop_proto.add_bus_names(bus_name);
-    }
+    stop_proto.mutable_bus_ids()->Add(begin(stop.bus_ids), end(stop.bus_ids));
   }
 
-  for (const auto& [name, bus] : buses_) {
+  for (const auto& bus : buses_) {
     TCProto::BusResponse& bus_proto = *db_proto.add_buses();
-    bus_proto.set_name(name);
     bus_proto.set_stop_count(bus.stop_count);
     bus_proto.set_unique_stop_count(bus.unique_stop_count);
     bus_proto.set_road_route_length(bus.road_route_length);
     bus_proto.set_geo_route_length(bus.geo_route_length);
   }
 
-  router_->Serialize(*db_proto.mutable_router());
+  BaseFile::Writer base_file;
+  {
+    TCProto::BaseSources sources_proto;
+    sources_.Serialize(sources_proto);
+    const string sources_data = sources_proto.SerializeAsString();
+    db_proto.set_sources_offset(base_file.AppendArray(span<const char>(sources_data)));
+    db_proto.set_sources_size(sources_data.size());
+  }
+  router_->Serialize(*db_proto.mutable_router(), base_file);
   map_renderer_->Serialize(*db_proto.mutable_renderer());
-  yellow_pages_catalog_->Serialize(*db_proto.mutable_yellow_pages());
-  return db_proto.SerializeAsString();
+  yellow_pages_catalog_->Serialize(*db_proto.mutable_yellow_pages(), *db_proto.mutable_yellow_pages_index(),
+                                   base_file);
+  return base_file.Finish(db_proto);
 }
 
-TransportCatalog TransportCatalog::Deserialize(const string& data) {
+static TCProto::TransportCatalog ParseBase(const BaseFile::Reader& base_file) {
+  const string_view data = base_file.GetMessageData();
   TCProto::TransportCatalog proto;
-  assert(proto.ParseFromString(data));
+  if (!proto.ParseFromArray(data.data(), static_cast<int>(data.size()))) {
+    throw runtime_error("corrupt base: can't parse the catalog");
+  }
+  return proto;
+}
+
+TransportCatalog::Bus TransportCatalog::DeserializeBus(const TCProto::BusResponse& proto) {
+  Bus bus;
+  bus.stop_count = proto.stop_count();
+  bus.unique_stop_count = proto.unique_stop_count();
+  bus.road_route_length = proto.road_route_length();
+  bus.geo_route_length = proto.geo_route_length();
+  return bus;
+}
+
+TransportCatalog TransportCatalog::Deserialize(shared_ptr<const BaseFile::Reader> base_file) {
+  TCProto::TransportCatalog proto = ParseBase(*base_file);
 
   TransportCatalog catalog;
+  catalog.base_file_ = move(base_file);
+
+  catalog.names_ = make_shared<CatalogNames>(
+      CatalogNames{Interner::Deserialize(proto.stop_names()), Interner::Deserialize(proto.bus_names())});
 
+  catalog.stops_.reserve(proto.stops_size());
   for (const TCProto::StopResponse& stop_proto : proto.stops()) {
-    Stop& stop = catalog.stops_[stop_proto.name()];
-    for (const string& bus_name : stop_proto.bus_names()) {
-      stop.bus_names.insert(bus_name);
-    }
+    catalog.stops_.push_back({{begin(stop_proto.bus_ids()), end(stop_proto.bus_ids())}});
   }
 
+  catalog.buses_.reserve(proto.buses_size());
   for (const TCProto::BusResponse& bus_proto : proto.buses()) {
-    Bus& bus = catalog.buses_[bus_proto.name()];
-    bus.stop_count = bus_proto.stop_count();
-    bus.unique_stop_count = bus_proto.unique_stop_count();
-    bus.road_route_length = bus_proto.road_route_length();
-    bus.geo_route_length = bus_proto.geo_route_length();
+    catalog.buses_.push_back(DeserializeBus(bus_proto));
+  }
+
+  {
+    METRICS_SPAN("catalog: loading router");
+    catalog.router_ = TransportRouter::Deserialize(proto.router(), *catalog.base_file_, catalog.names_);
+  }
+  {
+    METRICS_SPAN("catalog: loading map");
+    catalog.map_renderer_ = MapRenderer::Deserialize(proto.renderer(), catalog.names_);
+    catalog.rendered_map_ = RenderWholeMap(*catalog.map_renderer_);
+  }
+  METRICS_SPAN("catalog: loading yellow pages");
+  catalog.yellow_pages_catalog_ = YellowPagesCatalog::Deserialize(move(*proto.mutable_yellow_pages()),
+                                                                  proto.yellow_pages_index(), *catalog.base_file_);
+
+  return catalog;
+}
+
+static vector<string> ReadNames(const Json::Dict& settings, const string& key) {
+  vector<string> names;
+  if (const auto it = settings.find(key); it != settings.end()) {
+    for (const auto& name_node : it->second.AsArray()) {
+      names.push_back(name_node.AsString());
+    }
+  }
+  return names;
+}
+
+TransportCatalog TransportCatalog::Update(shared_ptr<const BaseFile::Reader> base_file,
+                                          Descriptions::BaseInput changes, size_t thread_count) {
+  TCProto::TransportCatalog proto = ParseBase(*base_file);
+
+  TCProto::BaseSources sources_proto;
+  const auto sources_data = base_file->GetArray<char>(proto.sources_offset(), proto.sources_size());
+  if (!sources_proto.ParseFromArray(sources_data.data(), static_cast<int>(sources_data.size()))) {
+    throw runtime_error("corrupt base: can't parse the sources");
+  }
+  const auto sources = Descriptions::BaseSources::Deserialize(sources_proto);
+
+  auto updated_sources = sources;
+  updated_sources.Update(move(changes.descriptions), ReadNames(changes.settings, "removed_stops"),
+                         ReadNames(changes.settings, "removed_buses"));
+  if (const auto it = changes.settings.find("routing_settings"); it != changes.settings.end()) {
+    updated_sources.routing_settings = it->second.AsMap();
+  }
+  if (const auto it = changes.settings.find("render_settings"); it != changes.settings.end()) {
+    updated_sources.render_settings = it->second.AsMap();
+  }
+
+  const auto removed_companies = ReadNames(changes.settings, "removed_companies");
+  const bool companies_changed = changes.yellow_pages.companies_size() > 0 ||
+                                 changes.yellow_pages.rubrics_size() > 0 || !removed_companies.empty();
+  YellowPages::Database yellow_pages = move(*proto.mutable_yellow_pages());
+  auto previous_company_ids =
+      Descriptions::UpdateYellowPages(yellow_pages, move(changes.yellow_pages), removed_companies);
+  Descriptions::CheckStopReferences(updated_sources, yellow_pages);
+
+  ReusedParts reused_parts;
+  auto names = make_shared<CatalogNames>(
+      CatalogNames{Interner::Deserialize(proto.stop_names()), Interner::Deserialize(proto.bus_names())});
+  for (const string& bus_name : Descriptions::FindBusesWithSameStats(sources, updated_sources)) {
+    reused_parts.buses.emplace(bus_name, DeserializeBus(proto.buses(names->buses.GetId(bus_name))));
+  }
+  auto previous_router = TransportRouter::Deserialize(proto.router(), *base_file, move(names));
+  if (Descriptions::HaveSameRoutes(sources, updated_sources)) {
+    reused_parts.router = move(previous_router);  // same names, so the ids in the router stay valid
+  } else {
+    reused_parts.previous_router = move(previous_router);
+  }
+  if (!companies_changed) {
+    reused_parts.yellow_pages_catalog =
+        YellowPagesCatalog::Deserialize(yellow_pages, proto.yellow_pages_index(), *base_file);
+  } else {
+    reused_parts.previous_yellow_pages_index = &proto.yellow_pages_index();
+    reused_parts.previous_base_file = base_file.get();
+    reused_parts.previous_company_ids = move(previous_company_ids);
   }
 
-  catalog.router_ = TransportRouter::Deserialize(proto.router());
-  catalog.map_renderer_ = MapRenderer::Deserialize(proto.renderer());
-  catalog.map_ = catalog.map_renderer_->Render();
-  catalog.yellow_pages_catalog_ = YellowPagesCatalog::Deserialize(move(*proto.mutable_yellow_pages()));
+  vector<Descriptions::InputQuery> data;
+  data.reserve(updated_sources.stops.size() + updated_sources.buses.size());
+  move(begin(updated_sources.stops), end(updated_sources.stops), back_inserter(data));
+  move(begin(updated_sources.buses), end(updated_sources.buses), back_inserter(data));
 
+  TransportCatalog catalog(move(data), move(yellow_pages), updated_sources.routing_settings,
+                           updated_sources.render_settings, thread_count, move(reused_parts));
+  catalog.base_file_ = move(base_file);  // the reused parts use its arrays
   return catalog;
 }
 
 vector<string> TransportCatalog::FindCompanies(const CompaniesFilter& filter) const {
   const auto companies = yellow_pages_catalog_->FindCompanies(filter);
+  METRICS_COUNT("yellow pages: found companies", companies.size());
   vector<string> names;
   names.reserve(companies.size());
   transform(companies.begin(), companies.end(), back_inserter(names),
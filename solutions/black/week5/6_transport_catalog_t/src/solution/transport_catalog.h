@@ -1,17 +1,21 @@
 #pragma once
 
+#include <memory>
 #include <optional>
-#include <set>
 #include <string>
 #include <unordered_map>
 #include <variant>
 #include <vector>
 
+#include "base_file.h"
 #include "descriptions.h"
 #include "filters.h"
+#include "interner.h"
 #include "json.h"
 #include "map_renderer.h"
+#include "stop_distances.h"
 #include "svg.h"
+#include "transport_catalog.pb.h"
 #include "transport_router.h"
 #include "utils.h"
 #include "yellow_pages_catalog.h"
@@ -19,7 +23,7 @@
 
 namespace Responses {
   struct Stop {
-    std::set<std::string> bus_names;
+    std::vector<BusId> bus_ids;  // ascending, that is the alphabetical order of names
   };
 
   struct Bus {
@@ -36,41 +40,79 @@ class TransportCatalog {
   using Stop = Responses::Stop;
 
  public:
+  // Independent build stages run concurrently, routes are precomputed with up to thread_count threads
   TransportCatalog(std::vector<Descriptions::InputQuery> data, YellowPages::Database yellow_pages,
-                   const Json::Dict& routing_settings_json, const Json::Dict& render_settings_json);
+                   const Json::Dict& routing_settings_json, const Json::Dict& render_settings_json,
+                   size_t thread_count = 1);
 
   const Stop* GetStop(const std::string& name) const;
   const Bus* GetBus(const std::string& name) const;
 
+  const std::string& GetStopName(StopId id) const { return names_->stops.GetName(id); }
+  const std::string& GetBusName(BusId id) const { return names_->buses.GetName(id); }
+
   std::optional<TransportRouter::RouteInfo> FindRoute(const std::string& stop_from, const std::string& stop_to) const;
   std::optional<TransportRouter::RouteInfo> FindRoute(const DateTime& datetime, const std::string& stop_from,
                                                       const CompaniesFilter& filter) const;
 
-  std::string RenderMap() const;
-  std::string RenderRoute(const TransportRouter::RouteInfo& route) const;
+  // SVG maps come escaped for JSON right away, they are only sent as JSON strings
+  Json::EscapedString RenderMap() const;
+  Json::EscapedString RenderMap(MapArea area) const;
+  Json::EscapedString RenderMap(MapTile tile) const;
+  Json::EscapedString RenderRoute(const TransportRouter::RouteInfo& route) const;
 
   std::vector<std::string> FindCompanies(const CompaniesFilter& filter) const;
 
+  // Only catalogs built from descriptions have sources to store for update_base
   std::string Serialize() const;
-  static TransportCatalog Deserialize(const std::string& data);
+  // The catalog keeps the base file, parts of it are used in place
+  static TransportCatalog Deserialize(std::shared_ptr<const BaseFile::Reader> base_file);
+  // Rebuilds the base with update_base changes applied, reusing what they leave valid. The router and
+  // the yellow pages indexes are taken from the base as is when the changes don't touch them. Otherwise only
+  // the precomputed routes from the sources that changed edge weights affect are searched again, provided
+  // the graph keeps its edges, and only the changed companies are indexed anew. Stats are computed for
+  // the changed buses only. The map is always drawn anew.
+  static TransportCatalog Update(std::shared_ptr<const BaseFile::Reader> base_file, Descriptions::BaseInput changes,
+                                 size_t thread_count = 1);
 
  private:
   TransportCatalog() = default;
 
-  static size_t ComputeRoadRouteLength(const std::vector<std::string>& stops,
-                                       const Descriptions::StopsDict& stops_dict);
+  // Parts of a previous base that are still valid for the new descriptions or only need a repair
+  struct ReusedParts {
+    std::unique_ptr<TransportRouter> router;
+    std::unique_ptr<TransportRouter> previous_router;  // for a router that is built anew
+    std::unique_ptr<YellowPagesCatalog> yellow_pages_catalog;
+    // For a yellow pages catalog that is built anew: the name indexes with the previous company ids
+    const TCProto::YellowPagesIndex* previous_yellow_pages_index = nullptr;
+    const BaseFile::Reader* previous_base_file = nullptr;
+    std::vector<std::optional<size_t>> previous_company_ids;
+    std::unordered_map<std::string, Bus> buses;  // by names
+  };
+
+  TransportCatalog(std::vector<Descriptions::InputQuery> data, YellowPages::Database yellow_pages,
+                   const Json::Dict& routing_settings_json, const Json::Dict& render_settings_json,
+                   size_t thread_count, ReusedParts reused_parts);
+
+  static Bus DeserializeBus(const TCProto::BusResponse& proto);
+
+  static size_t ComputeRoadRouteLength(const std::vector<StopId>& stops, const StopDistances& distances);
+
+  static double ComputeGeoRouteDistance(const std::vector<StopId>& stops,
+                                        const std::vector<Sphere::Point>& stops_positions);
 
-  static double ComputeGeoRouteDistance(const std::vector<std::string>& stops,
-                                        const Descriptions::StopsDict& stops_dict);
+  static std::string RenderWholeMap(const MapRenderer& map_renderer);
 
   static Svg::Document BuildMap(const Descriptions::StopsDict& stops_dict, const Descriptions::BusesDict& buses_dict,
                                 const Json::Dict& render_settings_json);
-  Svg::Document BuildRouteMap(const TransportRouter::RouteInfo& route) const;
 
-  std::unordered_map<std::string, Stop> stops_;
-  std::unordered_map<std::string, Bus> buses_;
+  std::shared_ptr<const BaseFile::Reader> base_file_;
+  std::shared_ptr<const CatalogNames> names_;
+  std::vector<Stop> stops_;  // indexed by stop id
+  std::vector<Bus> buses_;   // indexed by bus id
   std::unique_ptr<TransportRouter> router_;
   std::unique_ptr<MapRenderer> map_renderer_;
-  Svg::Document map_;
+  std::string rendered_map_;  // rendered once and escaped for JSON, route maps are composed over it
   std::unique_ptr<YellowPagesCatalog> yellow_pages_catalog_;
+  Descriptions::BaseSources sources_;
 };
@@ -1,21 +1,38 @@
 #include "transport_router.h"
 
+#include "metrics.h"
 #include "yellow_pages_catalog.h"
 #include "utils.h"
 
 using namespace std;
 
-TransportRouter::TransportRouter(const Descriptions::StopsDict& stops_dict, const Descriptions::BusesDict& buses_dict,
-                                 const Json::Dict& routing_settings_json)
-    : routing_settings_(MakeRoutingSettings(routing_settings_json)) {
-  const size_t vertex_count = stops_dict.size() * 2;
+TransportRouter::TransportRouter(const Descriptions::BusesDict& buses_dict, shared_ptr<const CatalogNames> names,
+                                 const StopDistances& distances, const Json::Dict& routing_settings_json,
+                                 size_t thread_count, const TransportRouter* previous)
+    : routing_settings_(MakeRoutingSettings(routing_settings_json)), names_(move(names)) {
+  size_t vertex_count = names_->stops.GetSize() * 2;
+  if (routing_settings_.graph_model == GraphModel::BUS_CHAINS) {
+    for (const auto& [_, bus_item] : buses_dict) {
+      if (bus_item->stops.size() > 1) {
+        vertex_count += bus_item->stops.size();
+      }
+    }
+  }
   vertices_info_.resize(vertex_count);
   graph_ = BusGraph(vertex_count);
 
-  FillGraphWithStops(stops_dict);
-  FillGraphWithBuses(stops_dict, buses_dict);
+  FillGraphWithStops();
+  switch (routing_settings_.graph_model) {
+    case GraphModel::ALL_PAIRS:
+      FillGraphWithBuses(buses_dict, distances);
+      break;
+    case GraphModel::BUS_CHAINS:
+      FillGraphWithBusChains(buses_dict, distances);
+      break;
+  }
+  FinalizeGraph();
 
-  router_ = std::make_unique<Router>(graph_);
+  BuildRouter(thread_count, previous);
 }
 
 TransportRouter::RoutingSettings TransportRouter::MakeRoutingSettings(const Json::Dict& json) {
@@ -23,52 +40,102 @@ TransportRouter::RoutingSettings TransportRouter::MakeRoutingSettings(const Json
       json.at("bus_wait_time").AsInt(),
       json.at("bus_velocity").AsDouble(),
       json.at("pedestrian_velocity").AsDouble(),
+      json.count("router_mode") ? ParseRouterMode(json.at("router_mode").AsString()) : RouterMode::PRECOMPUTED,
+      json.count("graph_model") ? ParseGraphModel(json.at("graph_model").AsString()) : GraphModel::ALL_PAIRS,
   };
 }
 
-void TransportRouter::FillGraphWithStops(const Descriptions::StopsDict& stops_dict) {
+TransportRouter::GraphModel TransportRouter::ParseGraphModel(const string& model) {
+  if (model == "all_pairs") {
+    return GraphModel::ALL_PAIRS;
+  } else if (model == "bus_chains") {
+    return GraphModel::BUS_CHAINS;
+  }
+  throw invalid_argument("unknown graph model: " + model);
+}
+
+TransportRouter::RouterMode TransportRouter::ParseRouterMode(const string& mode) {
+  if (mode == "precomputed") {
+    return RouterMode::PRECOMPUTED;
+  } else if (mode == "on_demand") {
+    return RouterMode::ON_DEMAND;
+  } else if (mode == "contraction_hierarchy") {
+    return RouterMode::CONTRACTION_HIERARCHY;
+  }
+  throw invalid_argument("unknown router mode: " + mode);
+}
+
+void TransportRouter::BuildRouter(size_t thread_count, const TransportRouter* previous) {
+  switch (routing_settings_.router_mode) {
+    case RouterMode::PRECOMPUTED:
+      if (previous && previous->routing_settings_.router_mode == RouterMode::PRECOMPUTED &&
+          graph_.HasSameEdges(previous->graph_)) {
+        const auto& previous_router = static_cast<const Graph::PrecomputedRouter<double>&>(*previous->router_);
+        router_ = make_unique<Graph::PrecomputedRouter<double>>(graph_, previous_router, thread_count);
+      } else {
+        router_ = make_unique<Graph::PrecomputedRouter<double>>(graph_, thread_count);
+      }
+      break;
+    case RouterMode::ON_DEMAND:
+      router_ = make_unique<Graph::DijkstraRouter<double>>(graph_);
+      break;
+    case RouterMode::CONTRACTION_HIERARCHY:
+      router_ = make_unique<Graph::ContractionHierarchyRouter<double>>(graph_);
+      break;
+  }
+}
+
+void TransportRouter::FinalizeGraph() {
+  const vector<Graph::EdgeId> edge_ids = graph_.Finalize();
+  vector<EdgeInfo> edges_info(edges_info_.size());
+  for (size_t edge_idx = 0; edge_idx < edge_ids.size(); ++edge_idx) {
+    edges_info[edge_ids[edge_idx]] = edges_info_[edge_idx];
+  }
+  edges_info_ = move(edges_info);
+}
+
+void TransportRouter::FillGraphWithStops() {
   Graph::VertexId vertex_id = 0;
 
-  for (const auto& [stop_name, _] : stops_dict) {
-    auto& vertex_ids = stops_vertex_ids_[stop_name];
+  stops_vertex_ids_.resize(names_->stops.GetSize());
+  for (StopId stop_id = 0; stop_id < stops_vertex_ids_.size(); ++stop_id) {
+    auto& vertex_ids = stops_vertex_ids_[stop_id];
     vertex_ids.in = vertex_id++;
     vertex_ids.out = vertex_id++;
-    vertices_info_[vertex_ids.in] = {stop_name};
-    vertices_info_[vertex_ids.out] = {stop_name};
+    vertices_info_[vertex_ids.in] = {stop_id};
+    vertices_info_[vertex_ids.out] = {stop_id};
 
     edges_info_.push_back(WaitEdgeInfo{});
-    const Graph::EdgeId edge_id =
+    [[maybe_unused]] const Graph::EdgeId edge_id =
         graph_.AddEdge({vertex_ids.out, vertex_ids.in, static_cast<double>(routing_settings_.bus_wait_time)});
     assert(edge_id == edges_info_.size() - 1);
   }
 
-  assert(vertex_id == graph_.GetVertexCount());
+  assert(vertex_id == stops_vertex_ids_.size() * 2);
 }
 
-void TransportRouter::FillGraphWithBuses(const Descriptions::StopsDict& stops_dict,
-                                         const Descriptions::BusesDict& buses_dict) {
+void TransportRouter::FillGraphWithBuses(const Descriptions::BusesDict& buses_dict, const StopDistances& distances) {
   for (const auto& [_, bus_item] : buses_dict) {
     const auto& bus = *bus_item;
     const size_t stop_count = bus.stops.size();
     if (stop_count <= 1) {
       continue;
     }
-    auto compute_distance_from = [&stops_dict, &bus](size_t lhs_idx) {
-      return Descriptions::ComputeStopsDistance(*stops_dict.at(bus.stops[lhs_idx]),
-                                                *stops_dict.at(bus.stops[lhs_idx + 1]));
-    };
+    const BusId bus_id = names_->buses.GetId(bus.name);
+    const vector<StopId> stop_ids = names_->stops.GetIds(bus.stops);
+    const vector<uint32_t> segments = distances.GetSegments(stop_ids);
     for (size_t start_stop_idx = 0; start_stop_idx + 1 < stop_count; ++start_stop_idx) {
-      const Graph::VertexId start_vertex = stops_vertex_ids_[bus.stops[start_stop_idx]].in;
+      const Graph::VertexId start_vertex = stops_vertex_ids_[stop_ids[start_stop_idx]].in;
       int total_distance = 0;
       for (size_t finish_stop_idx = start_stop_idx + 1; finish_stop_idx < stop_count; ++finish_stop_idx) {
-        total_distance += compute_distance_from(finish_stop_idx - 1);
+        total_distance += segments[finish_stop_idx - 1];
         edges_info_.push_back(BusEdgeInfo{
-            .bus_name = bus.name,
+            .bus_id = bus_id,
             .start_stop_idx = start_stop_idx,
             .finish_stop_idx = finish_stop_idx,
         });
-        const Graph::EdgeId edge_id = graph_.AddEdge({
-            start_vertex, stops_vertex_ids_[bus.stops[finish_stop_idx]].out,
+        [[maybe_unused]] const Graph::EdgeId edge_id = graph_.AddEdge({
+            start_vertex, stops_vertex_ids_[stop_ids[finish_stop_idx]].out,
             total_distance * 1.0 / (routing_settings_.bus_velocity * 1000.0 / 60)  // m / (km/h * 1000 / 60) = min
         });
         assert(edge_id == edges_info_.size() - 1);
@@ -77,24 +144,74 @@ void TransportRouter::FillGraphWithBuses(const Descriptions::StopsDict& stops_di
   }
 }
 
-void TransportRouter::Serialize(TCProto::TransportRouter& proto) const {
+void TransportRouter::FillGraphWithBusChains(const Descriptions::BusesDict& buses_dict,
+                                             const StopDistances& distances) {
+  Graph::VertexId ride_vertex_id = stops_vertex_ids_.size() * 2;
+
+  for (const auto& [_, bus_item] : buses_dict) {
+    const auto& bus = *bus_item;
+    const size_t stop_count = bus.stops.size();
+    if (stop_count <= 1) {
+      continue;
+    }
+    const BusId bus_id = names_->buses.GetId(bus.name);
+    const vector<StopId> stop_ids = names_->stops.GetIds(bus.stops);
+    // One riding vertex per stop of the route: being on this bus at this stop
+    const Graph::VertexId first_ride_vertex = ride_vertex_id;
+    ride_vertex_id += stop_count;
+
+    for (size_t stop_idx = 0; stop_idx < stop_count; ++stop_idx) {
+      const StopId stop_id = stop_ids[stop_idx];
+      const StopVertexIds& stop_vertex_ids = stops_vertex_ids_[stop_id];
+      const Graph::VertexId ride_vertex = first_ride_vertex + stop_idx;
+      vertices_info_[ride_vertex] = {stop_id};
+
+      if (stop_idx + 1 < stop_count) {
+        edges_info_.push_back(BoardEdgeInfo{.bus_id = bus_id, .stop_idx = stop_idx});
+        [[maybe_unused]] const Graph::EdgeId board_edge_id = graph_.AddEdge({stop_vertex_ids.in, ride_vertex, 0.0});
+        assert(board_edge_id == edges_info_.size() - 1);
+
+        const uint32_t distance = distances.Get(stop_id, stop_ids[stop_idx + 1]);
+        edges_info_.push_back(RideEdgeInfo{});
+        [[maybe_unused]] const Graph::EdgeId ride_edge_id = graph_.AddEdge({
+            ride_vertex, ride_vertex + 1,
+            distance * 1.0 / (routing_settings_.bus_velocity * 1000.0 / 60)  // m / (km/h * 1000 / 60) = min
+        });
+        assert(ride_edge_id == edges_info_.size() - 1);
+      }
+
+      if (stop_idx > 0) {
+        edges_info_.push_back(AlightEdgeInfo{.stop_idx = stop_idx});
+        [[maybe_unused]] const Graph::EdgeId alight_edge_id = graph_.AddEdge({ride_vertex, stop_vertex_ids.out, 0.0});
+        assert(alight_edge_id == edges_info_.size() - 1);
+      }
+    }
+  }
+
+  assert(ride_vertex_id == graph_.GetVertexCount());
+}
+
+void TransportRouter::Serialize(TCProto::TransportRouter& proto, BaseFile::Writer& base_file) const {
   auto& routing_settings_proto = *proto.mutable_routing_settings();
   routing_settings_proto.set_bus_wait_time(routing_settings_.bus_wait_time);
   routing_settings_proto.set_bus_velocity(routing_settings_.bus_velocity);
   routing_settings_proto.set_pedestrian_velocity(routing_settings_.pedestrian_velocity);
+  routing_settings_proto.set_router_mode(
+      static_cast<TCProto::RoutingSettings::RouterMode>(routing_settings_.router_mode));
+  routing_settings_proto.set_graph_model(
+      static_cast<TCProto::RoutingSettings::GraphModel>(routing_settings_.graph_model));
 
-  graph_.Serialize(*proto.mutable_graph());
-  router_->Serialize(*proto.mutable_router());
+  graph_.Serialize(*proto.mutable_graph(), base_file);
+  router_->Serialize(*proto.mutable_router(), base_file);
 
-  for (const auto& [name, vertex_ids] : stops_vertex_ids_) {
+  for (const auto& vertex_ids : stops_vertex_ids_) {
     auto& vertex_ids_proto = *proto.add_stops_vertex_ids();
-    vertex_ids_proto.set_name(name);
     vertex_ids_proto.set_in(vertex_ids.in);
     vertex_ids_proto.set_out(vertex_ids.out);
   }
 
-  for (const auto& [stop_name] : vertices_info_) {
-    proto.add_vertices_info()->set_stop_name(stop_name);
+  for (const auto& [stop_id] : vertices_info_) {
+    proto.add_vertices_info()->set_stop_id(stop_id);
   }
 
   for (const auto& edge_info : edges_info_) {
@@ -102,37 +219,63 @@ void TransportRouter::Serialize(TCProto::TransportRouter& proto) const {
     if (holds_alternative<BusEdgeInfo>(edge_info)) {
       const auto& bus_edge_info = get<BusEdgeInfo>(edge_info);
       auto& bus_edge_info_proto = *edge_info_proto.mutable_bus_data();
-      bus_edge_info_proto.set_bus_name(bus_edge_info.bus_name);
+      bus_edge_info_proto.set_bus_id(bus_edge_info.bus_id);
       bus_edge_info_proto.set_start_stop_idx(bus_edge_info.start_stop_idx);
       bus_edge_info_proto.set_finish_stop_idx(bus_edge_info.finish_stop_idx);
+    } else if (holds_alternative<BoardEdgeInfo>(edge_info)) {
+      const auto& board_edge_info = get<BoardEdgeInfo>(edge_info);
+      auto& board_edge_info_proto = *edge_info_proto.mutable_board_data();
+      board_edge_info_proto.set_bus_id(board_edge_info.bus_id);
+      board_edge_info_proto.set_stop_idx(board_edge_info.stop_idx);
+    } else if (holds_alternative<RideEdgeInfo>(edge_info)) {
+      edge_info_proto.mutable_ride_data();
+    } else if (holds_alternative<AlightEdgeInfo>(edge_info)) {
+      edge_info_proto.mutable_alight_data()->set_stop_idx(get<AlightEdgeInfo>(edge_info).stop_idx);
     } else {
       edge_info_proto.mutable_wait_data();
     }
   }
 }
 
-unique_ptr<TransportRouter> TransportRouter::Deserialize(const TCProto::TransportRouter& proto) {
+unique_ptr<TransportRouter> TransportRouter::Deserialize(const TCProto::TransportRouter& proto,
+                                                      const BaseFile::Reader& base_file,
+                                                      shared_ptr<const CatalogNames> names) {
   unique_ptr<TransportRouter> router_holder(new TransportRouter);  // ctor is private, so can't use make_unique
   TransportRouter& router = *router_holder;
+  router.names_ = move(names);
 
   auto& routing_settings = router.routing_settings_;
   routing_settings.bus_wait_time = proto.routing_settings().bus_wait_time();
   routing_settings.bus_velocity = proto.routing_settings().bus_velocity();
   routing_settings.pedestrian_velocity = proto.routing_settings().pedestrian_velocity();
+  routing_settings.router_mode = static_cast<RouterMode>(proto.routing_settings().router_mode());
+  routing_settings.graph_model = static_cast<GraphModel>(proto.routing_settings().graph_model());
 
-  router.graph_ = BusGraph::Deserialize(proto.graph());
-  router.router_ = Router::Deserialize(proto.router(), router.graph_);
+  router.graph_ = BusGraph::Deserialize(proto.graph(), base_file);
+  switch (routing_settings.router_mode) {
+    case RouterMode::PRECOMPUTED:
+      router.router_ = Graph::PrecomputedRouter<double>::Deserialize(proto.router(), router.graph_, base_file);
+      break;
+    case RouterMode::ON_DEMAND:
+      router.router_ = make_unique<Graph::DijkstraRouter<double>>(router.graph_);
+      break;
+    case RouterMode::CONTRACTION_HIERARCHY:
+      router.router_ =
+          Graph::ContractionHierarchyRouter<double>::Deserialize(proto.router(), router.graph_, base_file);
+      break;
+  }
 
+  router.stops_vertex_ids_.reserve(proto.stops_vertex_ids_size());
   for (const auto& stop_vertex_ids_proto : proto.stops_vertex_ids()) {
-    router.stops_vertex_ids_[stop_vertex_ids_proto.name()] = {
+    router.stops_vertex_ids_.push_back({
         stop_vertex_ids_proto.in(),
         stop_vertex_ids_proto.out(),
-    };
+    });
   }
 
   router.vertices_info_.reserve(proto.vertices_info_size());
   for (const auto& vertex_info_proto : proto.vertices_info()) {
-    router.vertices_info_.emplace_back().stop_name = vertex_info_proto.stop_name();
+    router.vertices_info_.push_back({vertex_info_proto.stop_id()});
   }
 
   router.edges_info_.reserve(proto.edges_info_size());
@@ -141,10 +284,19 @@ unique_ptr<TransportRouter> TransportRouter::Deserialize(const TCProto::Transpor
     if (edge_info_proto.has_bus_data()) {
       const auto& bus_info_proto = edge_info_proto.bus_data();
       edge_info = BusEdgeInfo{
-          bus_info_proto.bus_name(),
+          bus_info_proto.bus_id(),
           bus_info_proto.start_stop_idx(),
           bus_info_proto.finish_stop_idx(),
       };
+    } else if (edge_info_proto.has_board_data()) {
+      edge_info = BoardEdgeInfo{
+          edge_info_proto.board_data().bus_id(),
+          edge_info_proto.board_data().stop_idx(),
+      };
+    } else if (edge_info_proto.has_ride_data()) {
+      edge_info = RideEdgeInfo{};
+    } else if (edge_info_proto.has_alight_data()) {
+      edge_info = AlightEdgeInfo{edge_info_proto.alight_data().stop_idx()};
     } else {
       edge_info = WaitEdgeInfo{};
     }
@@ -153,33 +305,52 @@ unique_ptr<TransportRouter> TransportRouter::Deserialize(const TCProto::Transpor
   return router_holder;
 }
 
-optional<TransportRouter::RouteInfo> TransportRouter::FindRoute(const string& stop_from, const string& stop_to) const {
-  const Graph::VertexId vertex_from = stops_vertex_ids_.at(stop_from).out;
-  const Graph::VertexId vertex_to = stops_vertex_ids_.at(stop_to).out;
+optional<TransportRouter::RouteInfo> TransportRouter::FindRoute(StopId stop_from, StopId stop_to) const {
+  METRICS_SPAN("router: FindRoute");
+  const Graph::VertexId vertex_from = stops_vertex_ids_[stop_from].out;
+  const Graph::VertexId vertex_to = stops_vertex_ids_[stop_to].out;
   const auto route = router_->BuildRoute(vertex_from, vertex_to);
   if (!route) {
     return nullopt;
   }
+  return ExpandRoute(*route);
+}
 
-  RouteInfo route_info = {.total_time = route->weight, .items = {}};
-  route_info.items.reserve(route->edge_count);
-  for (size_t edge_idx = 0; edge_idx < route->edge_count; ++edge_idx) {
-    const Graph::EdgeId edge_id = router_->GetRouteEdge(route->id, edge_idx);
+TransportRouter::RouteInfo TransportRouter::ExpandRoute(const Router::RouteInfo& route) const {
+  RouteInfo route_info = {.total_time = route.weight, .items = {}};
+  route_info.items.reserve(route.edge_count);
+  for (size_t edge_idx = 0; edge_idx < route.edge_count; ++edge_idx) {
+    const Graph::EdgeId edge_id = router_->GetRouteEdge(route.id, edge_idx);
     const auto& edge = graph_.GetEdge(edge_id);
     const auto& edge_info = edges_info_[edge_id];
     if (holds_alternative<BusEdgeInfo>(edge_info)) {
       const BusEdgeInfo& bus_edge_info = get<BusEdgeInfo>(edge_info);
       route_info.items.push_back(RouteInfo::RideBusItem{
-          .bus_name = bus_edge_info.bus_name,
+          .bus_id = bus_edge_info.bus_id,
           .time = edge.weight,
           .start_stop_idx = bus_edge_info.start_stop_idx,
           .finish_stop_idx = bus_edge_info.finish_stop_idx,
           .span_count = bus_edge_info.finish_stop_idx - bus_edge_info.start_stop_idx,
       });
+    } else if (holds_alternative<BoardEdgeInfo>(edge_info)) {
+      const BoardEdgeInfo& board_edge_info = get<BoardEdgeInfo>(edge_info);
+      route_info.items.push_back(RouteInfo::RideBusItem{
+          .bus_id = board_edge_info.bus_id,
+          .time = 0,
+          .start_stop_idx = board_edge_info.stop_idx,
+          .finish_stop_idx = board_edge_info.stop_idx,
+          .span_count = 0,
+      });
+    } else if (holds_alternative<RideEdgeInfo>(edge_info)) {
+      get<RouteInfo::RideBusItem>(route_info.items.back()).time += edge.weight;
+    } else if (holds_alternative<AlightEdgeInfo>(edge_info)) {
+      auto& bus_item = get<RouteInfo::RideBusItem>(route_info.items.back());
+      bus_item.finish_stop_idx = get<AlightEdgeInfo>(edge_info).stop_idx;
+      bus_item.span_count = bus_item.finish_stop_idx - bus_item.start_stop_idx;
     } else {
       const Graph::VertexId vertex_id = edge.from;
       route_info.items.push_back(RouteInfo::WaitBusItem{
-          .stop_name = vertices_info_[vertex_id].stop_name,
+          .stop_id = vertices_info_[vertex_id].stop_id,
           .time = edge.weight,
       });
     }
@@ -187,60 +358,73 @@ optional<TransportRouter::RouteInfo> TransportRouter::FindRoute(const string& st
 
   // Releasing in destructor of some proxy object would be better,
   // but we do not expect exceptions in normal workflow
-  router_->ReleaseRoute(route->id);
+  router_->ReleaseRoute(route.id);
   return route_info;
 }
 
 namespace {
   struct CompanyStop {
     const YellowPages::Company* company_ptr;
-    Graph::VertexId vertex_to;
+    const WeeklySchedule* schedule;
+    StopId stop_id;
     double walk_travel_time;
-    double wait_time;
-    double whole_travel_time;
   };
 }  // namespace
 
 std::optional<TransportRouter::RouteInfo> TransportRouter::FindFastestRouteToAnyCompany(
-    const DateTime& datetime, const std::string& stop_from,
-    const vector<const YellowPages::Company*>& companies) const {
-  const Graph::VertexId vertex_from = stops_vertex_ids_.at(stop_from).out;
+    const DateTime& datetime, StopId stop_from, const vector<const YellowPages::Company*>& companies,
+    const vector<const WeeklySchedule*>& schedules) const {
+  METRICS_SPAN("router: FindFastestRouteToAnyCompany");
+  METRICS_COUNT("router: target companies", companies.size());
+  const Graph::VertexId vertex_from = stops_vertex_ids_[stop_from].out;
   vector<CompanyStop> companies_stops;
-  for (const auto company_ptr : companies) {
+  vector<Graph::VertexId> vertices_to;
+  for (size_t company_idx = 0; company_idx < companies.size(); ++company_idx) {
+    const auto company_ptr = companies[company_idx];
     for (const auto& nearby_stop : company_ptr->nearby_stops()) {
-      const Graph::VertexId vertex_to = stops_vertex_ids_.at(nearby_stop.name()).out;
-      if (auto weight = router_->GetWeight(vertex_from, vertex_to)) {
-        double walk_travel_time = nearby_stop.meters() / (routing_settings_.pedestrian_velocity * 1000.0 / 60.0);
-        auto [travel_minutes, epsilon] = FractionateDouble(*weight + walk_travel_time);
-        double wait_time = CalculateWaitTime(datetime + travel_minutes, company_ptr->working_time());
-        if ( wait_time >= 0.00001 && epsilon >= 0.00001) {
-          wait_time -= epsilon;
-        }
-        double whole_travel_time = *weight + walk_travel_time + wait_time;
-        companies_stops.push_back(CompanyStop{company_ptr, vertex_to, walk_travel_time, wait_time, whole_travel_time});
-      }
+      const StopId stop_id = names_->stops.GetId(nearby_stop.name());
+      companies_stops.push_back(CompanyStop{
+          .company_ptr = company_ptr,
+          .schedule = schedules[company_idx],
+          .stop_id = stop_id,
+          .walk_travel_time = nearby_stop.meters() / (routing_settings_.pedestrian_velocity * 1000.0 / 60.0),
+      });
+      vertices_to.push_back(stops_vertex_ids_[stop_id].out);
     }
   }
 
-  if (companies_stops.empty()) {
+  auto compute_wait_time = [&](const CompanyStop& company_stop, double ride_time) {
+    auto [travel_minutes, epsilon] = FractionateDouble(ride_time + company_stop.walk_travel_time);
+    double wait_time = company_stop.schedule->GetWaitTime(datetime + travel_minutes);
+    if (wait_time >= 0.00001 && epsilon >= 0.00001) {
+      wait_time -= epsilon;
+    }
+    return wait_time;
+  };
+
+  // One search over all nearby stops instead of a query per stop
+  const auto target_route = router_->BuildRouteToBestTarget(
+      vertex_from, vertices_to, [&](size_t target_idx, double ride_time) {
+        const CompanyStop& company_stop = companies_stops[target_idx];
+        return ride_time + company_stop.walk_travel_time + compute_wait_time(company_stop, ride_time);
+      });
+  if (!target_route) {
     return nullopt;
   }
 
-  auto min_path_it = min_element(
-      companies_stops.begin(), companies_stops.end(),
-      [](const CompanyStop& lhs, const CompanyStop& rhs) { return lhs.whole_travel_time < rhs.whole_travel_time; });
-
-  auto route = FindRoute(stop_from, vertices_info_[min_path_it->vertex_to].stop_name);
-  route->total_time = min_path_it->whole_travel_time;
-  route->items.push_back(RouteInfo::WalkToCompanyItem{.company = min_path_it->company_ptr,
-                                                      .stop_name = vertices_info_[min_path_it->vertex_to].stop_name,
-                                                      .time = min_path_it->walk_travel_time});
-  if (min_path_it->wait_time >= 0.00001) {
-    route->items.push_back(RouteInfo::WaitCompanyItem{
-      .company = min_path_it->company_ptr,
-      .time = min_path_it->wait_time
+  const CompanyStop& company_stop = companies_stops[target_route->target_idx];
+  const double wait_time = compute_wait_time(company_stop, target_route->route.weight);
+  RouteInfo route = ExpandRoute(target_route->route);
+  route.total_time = target_route->cost;
+  route.items.push_back(RouteInfo::WalkToCompanyItem{.company = company_stop.company_ptr,
+                                                     .stop_id = company_stop.stop_id,
+                                                     .time = company_stop.walk_travel_time});
+  if (wait_time >= 0.00001) {
+    route.items.push_back(RouteInfo::WaitCompanyItem{
+      .company = company_stop.company_ptr,
+      .time = wait_time
     });
   }
-  
+
   return route;
 }
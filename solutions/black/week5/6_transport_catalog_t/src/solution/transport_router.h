@@ -1,14 +1,19 @@
 #pragma once
 
 #include <memory>
-#include <unordered_map>
 #include <vector>
 
+#include "base_file.h"
 #include "company.pb.h"
+#include "contraction_hierarchy_router.h"
 #include "descriptions.h"
+#include "dijkstra_router.h"
 #include "graph.h"
+#include "interner.h"
 #include "json.h"
+#include "precomputed_router.h"
 #include "router.h"
+#include "stop_distances.h"
 #include "transport_router.pb.h"
 #include "datetime.h"
 
@@ -18,30 +23,35 @@ class TransportRouter {
   using Router = Graph::Router<double>;
 
  public:
-  TransportRouter(const Descriptions::StopsDict& stops_dict, const Descriptions::BusesDict& buses_dict,
-                  const Json::Dict& routing_settings_json);
+  // thread_count bounds the threads used to precompute routes. The precomputed routes of a previous router
+  // are repaired instead when its graph has the same edges, as after changing road distances or the settings.
+  TransportRouter(const Descriptions::BusesDict& buses_dict, std::shared_ptr<const CatalogNames> names,
+                  const StopDistances& distances, const Json::Dict& routing_settings_json, size_t thread_count = 1,
+                  const TransportRouter* previous = nullptr);
 
-  void Serialize(TCProto::TransportRouter& proto) const;
-  static std::unique_ptr<TransportRouter> Deserialize(const TCProto::TransportRouter& proto);
+  void Serialize(TCProto::TransportRouter& proto, BaseFile::Writer& base_file) const;
+  static std::unique_ptr<TransportRouter> Deserialize(const TCProto::TransportRouter& proto,
+                                                      const BaseFile::Reader& base_file,
+                                                      std::shared_ptr<const CatalogNames> names);
 
   struct RouteInfo {
     double total_time;
 
     struct RideBusItem {
-      std::string bus_name;
+      BusId bus_id;
       double time;
       size_t start_stop_idx;
       size_t finish_stop_idx;
       size_t span_count;
     };
     struct WaitBusItem {
-      std::string stop_name;
+      StopId stop_id;
       double time;
     };
 
     struct WalkToCompanyItem {
       const YellowPages::Company* company;
-      std::string stop_name;
+      StopId stop_id;
       double time;
     };
 
@@ -54,47 +64,85 @@ class TransportRouter {
     std::vector<Item> items;
   };
 
-  std::optional<RouteInfo> FindRoute(const std::string& stop_from, const std::string& stop_to) const;
-  std::optional<RouteInfo> FindFastestRouteToAnyCompany(
-      const DateTime& datetime, const std::string& stop_from,
-      const std::vector<const YellowPages::Company*>& companies) const;
+  std::optional<RouteInfo> FindRoute(StopId stop_from, StopId stop_to) const;
+  // Schedules go in the order of the companies
+  std::optional<RouteInfo> FindFastestRouteToAnyCompany(const DateTime& datetime, StopId stop_from,
+                                                        const std::vector<const YellowPages::Company*>& companies,
+                                                        const std::vector<const WeeklySchedule*>& schedules) const;
 
  private:
   TransportRouter() = default;
 
+  // Values match TCProto::RoutingSettings::RouterMode
+  enum class RouterMode {
+    PRECOMPUTED = 0,            // all-pairs table, fast queries but O(V^2) memory
+    ON_DEMAND = 1,              // Dijkstra per query, nothing but the graph is stored
+    CONTRACTION_HIERARCHY = 2,  // shortcuts index, near-linear memory and fast queries
+  };
+
+  // Values match TCProto::RoutingSettings::GraphModel
+  enum class GraphModel {
+    ALL_PAIRS = 0,   // an edge between every two stops of a bus, O(N^2) edges per bus
+    BUS_CHAINS = 1,  // a riding vertex per bus stop chained along the route, O(N) edges per bus
+  };
+
   struct RoutingSettings {
     int bus_wait_time;           // in minutes
     double bus_velocity;         // km/h
     double pedestrian_velocity;  // km/h
+    RouterMode router_mode;
+    GraphModel graph_model;
   };
 
   static RoutingSettings MakeRoutingSettings(const Json::Dict& json);
+  static RouterMode ParseRouterMode(const std::string& mode);
+  static GraphModel ParseGraphModel(const std::string& model);
+
+  void BuildRouter(size_t thread_count, const TransportRouter* previous);
 
-  void FillGraphWithStops(const Descriptions::StopsDict& stops_dict);
+  // Converts the graph route to route items and releases it
+  RouteInfo ExpandRoute(const Router::RouteInfo& route) const;
 
-  void FillGraphWithBuses(const Descriptions::StopsDict& stops_dict, const Descriptions::BusesDict& buses_dict);
+  void FillGraphWithStops();
+
+  void FillGraphWithBuses(const Descriptions::BusesDict& buses_dict, const StopDistances& distances);
+
+  void FillGraphWithBusChains(const Descriptions::BusesDict& buses_dict, const StopDistances& distances);
+
+  // Edge ids change when the graph is finalized, edge infos are reordered to match
+  void FinalizeGraph();
 
   struct StopVertexIds {
     Graph::VertexId in;
     Graph::VertexId out;
   };
   struct VertexInfo {
-    std::string stop_name;
+    StopId stop_id;
   };
 
   struct BusEdgeInfo {
-    std::string bus_name;
+    BusId bus_id;
     size_t start_stop_idx;
     size_t finish_stop_idx;
   };
   struct WaitEdgeInfo {};
-  using EdgeInfo = std::variant<BusEdgeInfo, WaitEdgeInfo>;
+  // Bus chains split a ride into boarding, riding along consecutive stops and alighting
+  struct BoardEdgeInfo {
+    BusId bus_id;
+    size_t stop_idx;
+  };
+  struct RideEdgeInfo {};
+  struct AlightEdgeInfo {
+    size_t stop_idx;
+  };
+  using EdgeInfo = std::variant<BusEdgeInfo, WaitEdgeInfo, BoardEdgeInfo, RideEdgeInfo, AlightEdgeInfo>;
 
   RoutingSettings routing_settings_;
   BusGraph graph_;
   // TODO: Tell about this unique_ptr usage case
   std::unique_ptr<Router> router_;
-  std::unordered_map<std::string, StopVertexIds> stops_vertex_ids_;
+  std::shared_ptr<const CatalogNames> names_;
+  std::vector<StopVertexIds> stops_vertex_ids_;  // indexed by stop id
   std::vector<VertexInfo> vertices_info_;
   std::vector<EdgeInfo> edges_info_;
 };
@@ -1,50 +1,11 @@
 #include "yellow_pages_catalog.h"
-using namespace std;
 
-static bool MatchNames(const YellowPages::Company& company, const vector<string>& names) {
-  if (names.empty()) {
-    return true;
-  }
-  // think about unordered_map_of_names but where should I build it?
-  for (const auto& name : company.names()) {
-    for (const auto& other : names) {
-      if (name.value() == other) {
-        return true;
-      }
-    }
-  }
-  return false;
-}
+#include <algorithm>
+#include <iterator>
 
-static bool MatchRubrics(const YellowPages::Company& company, const vector<uint64_t>& rubrics_ids) {
-  if (rubrics_ids.empty()) {
-    return true;
-  }
-  // think about unordered_map_of_names but where should I build it?
-  for (const auto& rubric_id : company.rubrics()) {
-    for (const auto& other : rubrics_ids) {
-      if (rubric_id == other) {
-        return true;
-      }
-    }
-  }
-  return false;
-}
+#include "metrics.h"
 
-static bool MatchUrls(const YellowPages::Company& company, const vector<string>& urls) {
-  if (urls.empty()) {
-    return true;
-  }
-  // think about unordered_map_of_names but where should I build it?
-  for (const auto& url : company.urls()) {
-    for (const auto& other : urls) {
-      if (url.value() == other) {
-        return true;
-      }
-    }
-  }
-  return false;
-}
+using namespace std;
 
 static bool MatchPhone(const YellowPages::Phone& object, const YellowPages::Phone& phone_template) {
   if (!phone_template.extension().empty() && phone_template.extension() != object.extension()) {
@@ -64,10 +25,6 @@ static bool MatchPhone(const YellowPages::Phone& object, const YellowPages::Phon
 }
 
 static bool MatchPhones(const YellowPages::Company& company, const vector<YellowPages::Phone>& phones) {
-  if (phones.empty()) {
-    return true;
-  }
-  // think about unordered_map_of_names but where should I build it?
   for (const auto& phone : company.phones()) {
     for (const auto& other : phones) {
       if (MatchPhone(phone, other)) {
@@ -78,26 +35,139 @@ static bool MatchPhones(const YellowPages::Company& company, const vector<Yellow
   return false;
 }
 
-vector<const YellowPages::Company*> YellowPagesCatalog::FindCompanies(const CompaniesFilter& filter) const {
-  vector<const YellowPages::Company*> items;
-  vector<uint64_t> rubrics_ids;
+// Companies having any of the keys
+template <typename Index, typename Keys, typename GetKey>
+static vector<uint32_t> UnitePostingLists(const Index& index, const Keys& keys, GetKey get_key) {
+  vector<uint32_t> result;
+  for (const auto& key : keys) {
+    if (const auto it = index.find(get_key(key)); it != index.end()) {
+      result.insert(end(result), begin(it->second), end(it->second));
+    }
+  }
+  if (keys.size() > 1) {
+    sort(begin(result), end(result));
+    result.erase(unique(begin(result), end(result)), end(result));
+  }
+  return result;
+}
+
+// Companies with any of the names, matched as the filter says
+static vector<uint32_t> FindByNames(const NameIndex& index, const vector<string>& names, const CompaniesFilter& filter) {
+  vector<uint32_t> result;
+  for (const string& name : names) {
+    const auto ids = filter.name_match == CompaniesFilter::NameMatch::PREFIX ? index.FindByPrefix(name)
+                                                                             : index.FindFuzzy(name, filter.max_edits);
+    result.insert(end(result), begin(ids), end(ids));
+  }
+  if (names.size() > 1) {
+    sort(begin(result), end(result));
+    result.erase(unique(begin(result), end(result)), end(result));
+  }
+  return result;
+}
 
-  for (auto& str : filter.rubrics) {
-    rubrics_ids.push_back(reversed_rubrics_index_.at(str));
+vector<const YellowPages::Company*> YellowPagesCatalog::FindCompanies(const CompaniesFilter& filter) const {
+  METRICS_SPAN("yellow pages: FindCompanies");
+  const auto same_key = [](const auto& key) -> const auto& { return key; };
+  vector<CompanyIds> matches;
+  if (!filter.names.empty()) {
+    matches.push_back(filter.name_match == CompaniesFilter::NameMatch::EXACT
+                          ? UnitePostingLists(companies_by_name_, filter.names, same_key)
+                          : FindByNames(company_names_index_, filter.names, filter));
+  }
+  if (!filter.rubrics.empty()) {
+    if (filter.name_match == CompaniesFilter::NameMatch::EXACT) {
+      matches.push_back(UnitePostingLists(companies_by_rubric_, filter.rubrics, [this](const string& rubric) {
+        return reversed_rubrics_index_.at(rubric);
+      }));
+    } else {
+      matches.push_back(FindByNames(rubric_names_index_, filter.rubrics, filter));
+    }
   }
-  for (const auto& company : companies_) {
-    bool ok = MatchNames(company, filter.names);
-    ok = ok && MatchRubrics(company, rubrics_ids);
-    ok = ok && MatchUrls(company, filter.urls);
-    ok = ok && MatchPhones(company, filter.phones);
-    if (ok) {
+  if (!filter.urls.empty()) {
+    matches.push_back(UnitePostingLists(companies_by_url_, filter.urls, same_key));
+  }
+  if (!filter.phones.empty()) {
+    CompanyIds ids = UnitePostingLists(companies_by_phone_number_, filter.phones,
+                                       [](const YellowPages::Phone& phone) -> const string& { return phone.number(); });
+    erase_if(ids, [&](CompanyId id) { return !MatchPhones(companies_[id], filter.phones); });
+    matches.push_back(move(ids));
+  }
+
+  vector<const YellowPages::Company*> items;
+  if (matches.empty()) {
+    items.reserve(companies_.size());
+    for (const auto& company : companies_) {
       items.push_back(&company);
     }
+    return items;
+  }
+
+  // Intersect starting from the smallest list, so that it bounds the work
+  sort(begin(matches), end(matches),
+       [](const CompanyIds& lhs, const CompanyIds& rhs) { return lhs.size() < rhs.size(); });
+  CompanyIds& result = matches.front();
+  for (auto it = next(begin(matches)); it != end(matches) && !result.empty(); ++it) {
+    erase_if(result, [&other = *it](CompanyId id) { return !binary_search(begin(other), end(other), id); });
+  }
+
+  items.reserve(result.size());
+  for (const CompanyId id : result) {
+    items.push_back(&companies_[id]);
   }
   return items;
 }
 
 YellowPagesCatalog::YellowPagesCatalog(YellowPages::Database proto) {
+  Load(move(proto));
+
+  vector<pair<string, NameIndex::Id>> company_names;
+  vector<pair<string, NameIndex::Id>> rubric_names;
+  for (CompanyId id = 0; id < companies_.size(); ++id) {
+    AddNameEntries(id, company_names, rubric_names);
+  }
+  company_names_index_ = NameIndex(move(company_names));
+  rubric_names_index_ = NameIndex(move(rubric_names));
+}
+
+YellowPagesCatalog::YellowPagesCatalog(YellowPages::Database yellow_pages,
+                                       const TCProto::YellowPagesIndex& previous_index_proto,
+                                       const BaseFile::Reader& previous_base_file,
+                                       const vector<optional<size_t>>& previous_ids) {
+  Load(move(yellow_pages));
+
+  vector<optional<NameIndex::Id>> new_ids;
+  vector<pair<string, NameIndex::Id>> company_names;
+  vector<pair<string, NameIndex::Id>> rubric_names;
+  for (CompanyId id = 0; id < companies_.size(); ++id) {
+    if (const auto previous_id = previous_ids[id]) {
+      if (new_ids.size() <= *previous_id) {
+        new_ids.resize(*previous_id + 1);
+      }
+      new_ids[*previous_id] = id;
+    } else {
+      AddNameEntries(id, company_names, rubric_names);
+    }
+  }
+  company_names_index_ = NameIndex(NameIndex::Deserialize(previous_index_proto.company_names(), previous_base_file),
+                                   new_ids, move(company_names));
+  rubric_names_index_ = NameIndex(NameIndex::Deserialize(previous_index_proto.rubric_names(), previous_base_file),
+                                  new_ids, move(rubric_names));
+}
+
+void YellowPagesCatalog::AddNameEntries(CompanyId id, vector<pair<string, NameIndex::Id>>& company_names,
+                                        vector<pair<string, NameIndex::Id>>& rubric_names) const {
+  for (const auto& name : companies_[id].names()) {
+    company_names.emplace_back(name.value(), id);
+  }
+  for (const uint64_t rubric_id : companies_[id].rubrics()) {
+    if (const auto it = rubrics_.find(rubric_id); it != rubrics_.end()) {
+      rubric_names.emplace_back(it->second.name(), id);
+    }
+  }
+}
+
+void YellowPagesCatalog::Load(YellowPages::Database proto) {
   companies_.reserve(proto.companies_size());
   for (auto& company : *proto.mutable_companies()) {
     companies_.push_back(move(company));
@@ -107,9 +177,41 @@ YellowPagesCatalog::YellowPagesCatalog(YellowPages::Database proto) {
     reversed_rubrics_index_[map_pair.second.name()] = map_pair.first;
     rubrics_[map_pair.first] = move(map_pair.second);
   }
+
+  schedules_.reserve(companies_.size());
+  for (const auto& company : companies_) {
+    schedules_.emplace_back(company.working_time());
+  }
+
+  BuildIndexes();
 }
 
-void YellowPagesCatalog::Serialize(YellowPages::Database& proto) const {
+void YellowPagesCatalog::BuildIndexes() {
+  // Ids only grow, so lists stay sorted, and a company with a repeated key is added once
+  const auto add = [](CompanyIds& ids, CompanyId id) {
+    if (ids.empty() || ids.back() != id) {
+      ids.push_back(id);
+    }
+  };
+  for (CompanyId id = 0; id < companies_.size(); ++id) {
+    const auto& company = companies_[id];
+    for (const auto& name : company.names()) {
+      add(companies_by_name_[name.value()], id);
+    }
+    for (const auto& url : company.urls()) {
+      add(companies_by_url_[url.value()], id);
+    }
+    for (const uint64_t rubric_id : company.rubrics()) {
+      add(companies_by_rubric_[rubric_id], id);
+    }
+    for (const auto& phone : company.phones()) {
+      add(companies_by_phone_number_[phone.number()], id);
+    }
+  }
+}
+
+void YellowPagesCatalog::Serialize(YellowPages::Database& proto, TCProto::YellowPagesIndex& index_proto,
+                                   BaseFile::Writer& base_file) const {
   for (const auto& company : companies_) {
     *proto.add_companies() = company;
   }
@@ -117,8 +219,17 @@ void YellowPagesCatalog::Serialize(YellowPages::Database& proto) const {
   for (const auto& [id, rubric] : rubrics_) {
     (*proto.mutable_rubrics())[id] = rubric;
   }
+
+  company_names_index_.Serialize(*index_proto.mutable_company_names(), base_file);
+  rubric_names_index_.Serialize(*index_proto.mutable_rubric_names(), base_file);
 }
 
-std::unique_ptr<YellowPagesCatalog> YellowPagesCatalog::Deserialize(YellowPages::Database proto) {
-  return make_unique<YellowPagesCatalog>(move(proto));
+std::unique_ptr<YellowPagesCatalog> YellowPagesCatalog::Deserialize(YellowPages::Database proto,
+                                                                     const TCProto::YellowPagesIndex& index_proto,
+                                                                     const BaseFile::Reader& base_file) {
+  std::unique_ptr<YellowPagesCatalog> catalog(new YellowPagesCatalog);  // ctor is private
+  catalog->Load(move(proto));
+  catalog->company_names_index_ = NameIndex::Deserialize(index_proto.company_names(), base_file);
+  catalog->rubric_names_index_ = NameIndex::Deserialize(index_proto.rubric_names(), base_file);
+  return catalog;
 }
\ No newline at end of file
@@ -1,23 +1,71 @@
 #pragma once
+#include <cstdint>
 #include <memory>
+#include <optional>
+#include <string>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
+#include "base_file.h"
 #include "database.pb.h"
+#include "datetime.h"
 #include "filters.h"
+#include "name_index.h"
+#include "name_index.pb.h"
 
 class YellowPagesCatalog {
  public:
   YellowPagesCatalog(YellowPages::Database yellow_pages);
+  // Takes the name indexes of a previous base with the entries of the companies that have previous ids
+  // remapped, only the rest of the companies are indexed anew. Previous ids go in the order of the companies,
+  // see Descriptions::UpdateYellowPages.
+  YellowPagesCatalog(YellowPages::Database yellow_pages, const TCProto::YellowPagesIndex &previous_index_proto,
+                     const BaseFile::Reader &previous_base_file,
+                     const std::vector<std::optional<size_t>> &previous_ids);
 
   // FIXME not safe for concurency, think about possible refs invalidation!!
   std::vector<const YellowPages::Company *> FindCompanies(const CompaniesFilter &filter) const;
 
-  void Serialize(YellowPages::Database &proto) const;
-  static std::unique_ptr<YellowPagesCatalog> Deserialize(YellowPages::Database proto);
+  // The company must come from this catalog
+  const WeeklySchedule &GetSchedule(const YellowPages::Company &company) const {
+    return schedules_[&company - companies_.data()];
+  }
+
+  // Name indexes for prefix and fuzzy matching go to the base file
+  void Serialize(YellowPages::Database &proto, TCProto::YellowPagesIndex &index_proto,
+                 BaseFile::Writer &base_file) const;
+  // The name indexes are used in place, so the base file must outlive the catalog
+  static std::unique_ptr<YellowPagesCatalog> Deserialize(YellowPages::Database proto,
+                                                         const TCProto::YellowPagesIndex &index_proto,
+                                                         const BaseFile::Reader &base_file);
 
  private:
   YellowPagesCatalog() = default;
+
+  // Positions in companies_, posting lists are sorted
+  using CompanyId = uint32_t;
+  using CompanyIds = std::vector<CompanyId>;
+
+  // Takes the companies and rubrics and builds the exact match indexes
+  void Load(YellowPages::Database proto);
+  void BuildIndexes();
+  // Entries of the company for the name indexes
+  void AddNameEntries(CompanyId id, std::vector<std::pair<std::string, NameIndex::Id>> &company_names,
+                      std::vector<std::pair<std::string, NameIndex::Id>> &rubric_names) const;
+
   std::unordered_map<uint64_t, YellowPages::Rubric> rubrics_;
   std::unordered_map<std::string, uint64_t> reversed_rubrics_index_;
   std::vector<YellowPages::Company> companies_;
+  std::vector<WeeklySchedule> schedules_;  // of companies_, compiled once for routing to companies
+
+  std::unordered_map<std::string, CompanyIds> companies_by_name_;
+  std::unordered_map<std::string, CompanyIds> companies_by_url_;
+  std::unordered_map<uint64_t, CompanyIds> companies_by_rubric_;
+  // Every phone filter has a number, other phone fields are checked on the found companies
+  std::unordered_map<std::string, CompanyIds> companies_by_phone_number_;
+
+  // Company ids by names and by names of their rubrics, for prefix and fuzzy matching
+  NameIndex company_names_index_;
+  NameIndex rubric_names_index_;
 };
@@ -1,8 +1,11 @@
 #include "integration_tests.h"
 
+#include <algorithm>
 #include <filesystem>
 #include <fstream>
+#include <iterator>
 #include <sstream>
+#include <stdexcept>
 
 #include "commands.h"
 #include "json.h"
@@ -47,3 +50,160 @@ void TestIntegration(const string &test_data_folder_name, bool draw_results = fa
 
   ASSERT_EQUAL(result_doc, expected_doc);
 }
+
+void TestServeIntegration(const string &test_data_folder_name) {
+  {
+    ifstream input(test_data_folder_name + "/make_base.json");
+    MakeBase(input);
+  }
+
+  ifstream process_input(test_data_folder_name + "/process_requests.json");
+  const Json::Document process_doc = Json::Load(process_input);
+  const auto &process_map = process_doc.GetRoot().AsMap();
+
+  stringstream input;
+  Json::PrintValue(Json::Dict{{"serialization_settings", process_map.at("serialization_settings")}}, input);
+  input << '\n';
+  for (const auto &request : process_map.at("stat_requests").AsArray()) {
+    Json::PrintNode(request, input);
+    input << '\n';
+  }
+
+  stringstream output;
+  ServeRequests(input, output);
+  Json::Array responses;
+  for (string line; getline(output, line);) {
+    istringstream line_input(line);
+    responses.push_back(Json::Load(line_input).GetRoot());
+  }
+
+  auto expected_doc_input = ifstream(test_data_folder_name + "/expected_output.json");
+  ASSERT_EQUAL(Json::Document(Json::Node(move(responses))), Json::Load(expected_doc_input));
+}
+
+static void RunCommand(void (*command)(istream &), const Json::Dict &input_map) {
+  stringstream input;
+  input.precision(17);  // coordinates must stay the same
+  Json::PrintValue(input_map, input);
+  command(input);
+}
+
+// The base is made without the last bus and the last company but with an extra bus,
+// then updated to the full input: with the companies first, so that the router is reused, and then with the buses
+void TestUpdateIntegration(const string &test_data_folder_name) {
+  ifstream make_base_input(test_data_folder_name + "/make_base.json");
+  const Json::Document make_base_doc = Json::Load(make_base_input);
+  const auto &make_base_map = make_base_doc.GetRoot().AsMap();
+  const auto &serialization_settings = make_base_map.at("serialization_settings");
+
+  Json::Array base_requests = make_base_map.at("base_requests").AsArray();
+  const auto last_bus_it = find_if(base_requests.rbegin(), base_requests.rend(), [](const Json::Node &request) {
+    return request.AsMap().at("type").AsString() == "Bus";
+  });
+  const Json::Node last_bus = *last_bus_it;
+  base_requests.erase(next(last_bus_it).base());
+  Json::Dict extra_bus = last_bus.AsMap();
+  extra_bus["name"] = Json::Node("update test bus"s);
+  base_requests.emplace_back(move(extra_bus));
+
+  Json::Dict yellow_pages = make_base_map.at("yellow_pages").AsMap();
+  Json::Array companies = yellow_pages.at("companies").AsArray();
+  const Json::Node last_company = companies.back();
+  companies.pop_back();
+  yellow_pages["companies"] = Json::Node(move(companies));
+
+  Json::Dict reduced_input = make_base_map;
+  reduced_input["base_requests"] = Json::Node(move(base_requests));
+  reduced_input["yellow_pages"] = Json::Node(move(yellow_pages));
+  RunCommand(MakeBase, reduced_input);
+
+  const Json::Dict companies_changes = {{"companies", Json::Node(Json::Array{last_company})}};
+  RunCommand(UpdateBase, {
+                             {"serialization_settings", serialization_settings},
+                             {"yellow_pages", Json::Node(companies_changes)},
+                         });
+  RunCommand(UpdateBase, {
+                             {"serialization_settings", serialization_settings},
+                             {"base_requests", Json::Node(Json::Array{last_bus})},
+                             {"removed_buses", Json::Node(Json::Array{Json::Node("update test bus"s)})},
+                         });
+
+  ifstream input(test_data_folder_name + "/process_requests.json");
+  stringstream output;
+  ProcessRequests(input, output);
+  auto expected_doc_input = ifstream(test_data_folder_name + "/expected_output.json");
+  ASSERT_EQUAL(Json::Load(output), Json::Load(expected_doc_input));
+}
+
+// Removing a stop that a bus still uses fails and keeps the base. New routing settings give the same answers
+// as a base made with them, though the routes stay the same
+void TestUpdateChecksIntegration(const string &test_data_folder_name) {
+  ifstream make_base_input(test_data_folder_name + "/make_base.json");
+  const Json::Document make_base_doc = Json::Load(make_base_input);
+  const auto &make_base_map = make_base_doc.GetRoot().AsMap();
+  const auto &serialization_settings = make_base_map.at("serialization_settings");
+  RunCommand(MakeBase, make_base_map);
+
+  auto process_requests = [&test_data_folder_name] {
+    ifstream input(test_data_folder_name + "/process_requests.json");
+    stringstream output;
+    ProcessRequests(input, output);
+    return Json::Load(output);
+  };
+  const Json::Document original_output = process_requests();
+
+  const auto &base_requests = make_base_map.at("base_requests").AsArray();
+  const auto bus_it = find_if(base_requests.begin(), base_requests.end(), [](const Json::Node &request) {
+    return request.AsMap().at("type").AsString() == "Bus";
+  });
+  const Json::Node used_stop = bus_it->AsMap().at("stops").AsArray().front();
+  ASSERT_THROWS(RunCommand(UpdateBase,
+                           {
+                               {"serialization_settings", serialization_settings},
+                               {"removed_stops", Json::Node(Json::Array{used_stop})},
+                           }),
+                invalid_argument);
+  ASSERT_EQUAL(process_requests(), original_output);
+
+  Json::Dict routing_settings = make_base_map.at("routing_settings").AsMap();
+  routing_settings["bus_wait_time"] = Json::Node(routing_settings.at("bus_wait_time").AsInt() * 2 + 1);
+  Json::Dict changed_input = make_base_map;
+  changed_input["routing_settings"] = Json::Node(routing_settings);
+  RunCommand(MakeBase, changed_input);
+  const Json::Document changed_output = process_requests();
+  ASSERT(!(changed_output == original_output));
+
+  RunCommand(MakeBase, make_base_map);
+  RunCommand(UpdateBase, {
+                             {"serialization_settings", serialization_settings},
+                             {"routing_settings", Json::Node(routing_settings)},
+                         });
+  ASSERT_EQUAL(process_requests(), changed_output);
+}
+
+// A request for an unknown stop fails process_requests with the same exception whatever the thread count
+void TestFailedRequestIntegration(const string &test_data_folder_name) {
+  {
+    ifstream input(test_data_folder_name + "/make_base.json");
+    MakeBase(input);
+  }
+
+  ifstream process_input(test_data_folder_name + "/process_requests.json");
+  const Json::Document process_doc = Json::Load(process_input);
+  Json::Dict process_map = process_doc.GetRoot().AsMap();
+  Json::Array requests = process_map.at("stat_requests").AsArray();
+  requests.insert(requests.begin() + requests.size() / 2,
+                  Json::Node(Json::Dict{{"id", Json::Node(0)},
+                                        {"type", Json::Node("Route"s)},
+                                        {"from", Json::Node("unknown test stop"s)},
+                                        {"to", Json::Node("unknown test stop"s)}}));
+  process_map["stat_requests"] = Json::Node(move(requests));
+
+  for (const int thread_count : {1, 4}) {
+    process_map["processing_settings"] = Json::Node(Json::Dict{{"thread_count", Json::Node(thread_count)}});
+    stringstream input;
+    Json::PrintValue(process_map, input);
+    stringstream output;
+    ASSERT_THROWS(ProcessRequests(input, output), out_of_range);
+  }
+}
@@ -2,4 +2,8 @@
 
 #include <string>
 
-void TestIntegration(const std::string &testDataFolderName, bool draw_results);
\ No newline at end of file
+void TestIntegration(const std::string &testDataFolderName, bool draw_results);
+void TestServeIntegration(const std::string &testDataFolderName);
+void TestUpdateIntegration(const std::string &testDataFolderName);
+void TestUpdateChecksIntegration(const std::string &testDataFolderName);
+void TestFailedRequestIntegration(const std::string &testDataFolderName);
\ No newline at end of file
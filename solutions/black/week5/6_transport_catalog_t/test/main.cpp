@@ -3,7 +3,16 @@
 #include <unordered_map>
 
 #include "integration_tests.h"
+#include "test_datetime.h"
+#include "test_interner.h"
+#include "test_json.h"
+#include "test_map_grid.h"
+#include "test_name_index.h"
+#include "test_response_cache.h"
+#include "test_router.h"
+#include "test_stop_distances.h"
 #include "test_svg.h"
+#include "test_yellow_pages.h"
 #include "test_runner.h"
 
 using namespace std;
@@ -12,12 +21,25 @@ int main(int argc, char *argv[]) {
   TestRunner tr;
    
   TestSvg::Run(tr);
+  TestJson::Run(tr);
+  TestMapGrid::Run(tr);
+  TestNameIndex::Run(tr);
+  TestInterner::Run(tr);
+  TestRouter::Run(tr);
+  TestStopDistances::Run(tr);
+  TestResponseCache::Run(tr);
+  TestDatetime::Run(tr);
+  TestYellowPages::Run(tr);
 
   if (argc > 1) {
     string test_folder = argv[1];
     //TestIntegration(test_folder, true);
     auto testor = bind(TestIntegration, test_folder, false);
     tr.RunTest(testor, "test from folder: " + test_folder);
+    tr.RunTest(bind(TestServeIntegration, test_folder), "serve test from folder: " + test_folder);
+    tr.RunTest(bind(TestUpdateIntegration, test_folder), "update test from folder: " + test_folder);
+    tr.RunTest(bind(TestUpdateChecksIntegration, test_folder), "update checks test from folder: " + test_folder);
+    tr.RunTest(bind(TestFailedRequestIntegration, test_folder), "failed request test from folder: " + test_folder);
   }
   return 0;
 }
\ No newline at end of file
@@ -0,0 +1,52 @@
+#include "test_datetime.h"
+
+#include <random>
+
+#include "datetime.h"
+
+using namespace std;
+
+namespace TestDatetime {
+  // Sorted disjoint intervals, as working times come in bases
+  static YellowPages::WorkingTime GenerateWorkingTime(mt19937 &generator) {
+    using Day = YellowPages::WorkingTimeInterval::Day;
+    YellowPages::WorkingTime working_time;
+    const bool everyday = generator() % 2;
+    for (int day = everyday ? Day::WorkingTimeInterval_Day_EVERYDAY : Day::WorkingTimeInterval_Day_MONDAY;
+         day <= (everyday ? Day::WorkingTimeInterval_Day_EVERYDAY : Day::WorkingTimeInterval_Day_SUNDAY); ++day) {
+      if (!everyday && generator() % 3 == 0) {
+        continue;  // day off
+      }
+      int minutes = 0;
+      for (int interval_idx = generator() % 3; interval_idx >= 0; --interval_idx) {
+        const int minutes_from = minutes + generator() % 400;
+        const int minutes_to = min(minutes_from + 1 + static_cast<int>(generator() % 600), 1440);
+        if (minutes_from >= 1440) {
+          break;
+        }
+        auto &interval = *working_time.add_intervals();
+        interval.set_day(static_cast<Day>(day));
+        interval.set_minutes_from(minutes_from);
+        interval.set_minutes_to(minutes_to);
+        minutes = minutes_to;
+      }
+    }
+    return working_time;
+  }
+
+  void TestWeeklyScheduleMatchesScan() {
+    mt19937 generator(42);
+    for (int schedule_idx = 0; schedule_idx < 300; ++schedule_idx) {
+      const YellowPages::WorkingTime working_time = GenerateWorkingTime(generator);
+      const WeeklySchedule schedule(working_time);
+      for (int week_day = 0; week_day < 7; ++week_day) {
+        for (int minutes = 0; minutes < 1440; minutes += 7) {
+          const DateTime dt{week_day, minutes / 60, minutes % 60};
+          ASSERT_EQUAL(schedule.GetWaitTime(dt), CalculateWaitTime(dt, working_time));
+        }
+      }
+    }
+  }
+
+  void Run(TestRunner &tr) { RUN_TEST(tr, TestWeeklyScheduleMatchesScan); }
+}  // namespace TestDatetime
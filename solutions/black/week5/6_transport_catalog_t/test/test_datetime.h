@@ -0,0 +1,8 @@
+#pragma once
+
+#include "test_runner.h"
+
+namespace TestDatetime {
+  void TestWeeklyScheduleMatchesScan();
+  void Run(TestRunner &tr);
+}  // namespace TestDatetime
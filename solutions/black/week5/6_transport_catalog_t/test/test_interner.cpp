@@ -0,0 +1,44 @@
+#include "test_interner.h"
+
+#include <stdexcept>
+
+#include "interner.h"
+#include "transport_catalog.pb.h"
+
+using namespace std;
+
+namespace TestInterner {
+  void TestIdsFollowNamesOrder() {
+    const Interner interner({"Marushkino", "Biryulyovo", "Tolstopaltsevo", "Biryulyovo", ""});
+    ASSERT_EQUAL(interner.GetSize(), 4u);
+    ASSERT_EQUAL(interner.GetName(0), "");
+    ASSERT_EQUAL(interner.GetName(1), "Biryulyovo");
+    ASSERT_EQUAL(interner.GetName(3), "Tolstopaltsevo");
+    for (Interner::Id id = 0; id < interner.GetSize(); ++id) {
+      ASSERT_EQUAL(interner.GetId(interner.GetName(id)), id);
+    }
+    ASSERT(!interner.FindId("Biryulyovo Zapadnoye"));
+    ASSERT(!interner.FindId("A"));
+
+    bool thrown = false;
+    try {
+      interner.GetId("Zzz");
+    } catch (const out_of_range &) {
+      thrown = true;
+    }
+    ASSERT(thrown);
+
+    TCProto::TransportCatalog proto;
+    interner.Serialize(*proto.mutable_stop_names());
+    const Interner restored = Interner::Deserialize(proto.stop_names());
+    ASSERT_EQUAL(restored.GetSize(), interner.GetSize());
+    for (Interner::Id id = 0; id < interner.GetSize(); ++id) {
+      ASSERT_EQUAL(restored.GetName(id), interner.GetName(id));
+    }
+    ASSERT_EQUAL(*restored.FindId("Marushkino"), 2u);
+  }
+
+  void Run(TestRunner &tr) {
+    RUN_TEST(tr, TestIdsFollowNamesOrder);
+  }
+}  // namespace TestInterner
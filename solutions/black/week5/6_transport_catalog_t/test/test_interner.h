@@ -0,0 +1,8 @@
+#pragma once
+
+#include "test_runner.h"
+
+namespace TestInterner {
+  void TestIdsFollowNamesOrder();
+  void Run(TestRunner &tr);
+}  // namespace TestInterner
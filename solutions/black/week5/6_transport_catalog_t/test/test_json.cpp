@@ -0,0 +1,125 @@
+#include "test_json.h"
+
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "json.h"
+#include "svg.h"
+
+using namespace std;
+
+namespace TestJson {
+  void TestParseValues() {
+    const auto doc = Json::Load(R"( {"int": -12, "double": 55.611087, "exp": 1e3, "big": 3000000000,
+                                     "bools": [true, false], "empty": {}, "none": []} )");
+    const auto& root = doc.GetRoot().AsMap();
+    ASSERT_EQUAL(root.at("int").AsInt(), -12);
+    ASSERT(root.at("double").IsPureDouble());
+    ASSERT_COMPARE(root.at("double").AsDouble(), 55.611087, 1e-12);
+    ASSERT_COMPARE(root.at("exp").AsDouble(), 1000.0, 1e-12);
+    ASSERT_COMPARE(root.at("big").AsDouble(), 3e9, 1e-3);
+    ASSERT(root.at("bools").AsArray()[0].AsBool());
+    ASSERT(!root.at("bools").AsArray()[1].AsBool());
+    ASSERT(root.at("empty").AsMap().empty());
+    ASSERT(root.at("none").AsArray().empty());
+  }
+
+  void TestParseEscapes() {
+    const auto doc = Json::Load(R"(["a\"b\\c\/d\n", "Мир", "\ud83d\ude00", "\u041c\u0438\u0440"])");
+    const auto& items = doc.GetRoot().AsArray();
+    ASSERT_EQUAL(items[0].AsString(), "a\"b\\c/d\n");
+    ASSERT_EQUAL(items[1].AsString(), "Мир");
+    ASSERT_EQUAL(items[2].AsString(), "\xF0\x9F\x98\x80");
+    ASSERT_EQUAL(items[3].AsString(), "Мир");
+  }
+
+  void TestParseItemByItem() {
+    Json::Parser parser(R"({"items": [{"id": 1}, {"id": 2}, {"id": 3}], "rest": "x"})");
+    vector<int> ids;
+    string rest;
+    parser.ParseDict([&](const string& key) {
+      if (key == "items") {
+        parser.ParseArray([&] { ids.push_back(parser.ParseNode().AsMap().at("id").AsInt()); });
+      } else {
+        rest = parser.ParseNode().AsString();
+      }
+    });
+    ASSERT_EQUAL(ids, (vector<int>{1, 2, 3}));
+    ASSERT_EQUAL(rest, "x");
+    ASSERT(parser.IsEnd());
+  }
+
+  void TestParseErrors() {
+    for (const string input : {R"({"a": )", R"(["abc)", R"({"a" 1})", R"([1 2])", "nul"}) {
+      bool failed = false;
+      try {
+        Json::Load(input);
+      } catch (const invalid_argument&) {
+        failed = true;
+      }
+      ASSERT(failed);
+    }
+  }
+
+  void TestWriterMatchesPrint() {
+    const Json::Node node(Json::Dict{
+        {"a", Json::Node(Json::Array{Json::Node(1), Json::Node(-2.5), Json::Node(1.0 / 3), Json::Node(1234567.0)})},
+        {"b", Json::Node(Json::Dict{})},
+        {"c", Json::Node(true)},
+        {"d", Json::Node("say \"hi\" \\"s)},
+        {"e", Json::Node(Json::EscapedString{"<svg/>"})},
+    });
+    ostringstream expected;
+    Json::PrintNode(node, expected);
+
+    string written;
+    Json::Writer writer(written);
+    writer.BeginDict();
+    writer.Key("a").BeginArray().Value(1).Value(-2.5).Value(1.0 / 3).Value(1234567.0).EndArray();
+    writer.Key("b").BeginDict().EndDict();
+    writer.Key("c").Value(true);
+    writer.Key("d").Value("say \"hi\" \\");
+    writer.Key("e").Value(Json::EscapedString{"<svg/>"});
+    writer.EndDict();
+    ASSERT_EQUAL(written, expected.str());
+  }
+
+  // Every ASCII character, including the control ones, comes back the same from each writer
+  void TestEscapedStringsRoundTrip() {
+    string value;
+    for (int c = 1; c < 0x80; ++c) {
+      value += static_cast<char>(c);
+    }
+    value += "A\nB \xD0\x9C\xD0\xB8\xD1\x80";  // UTF-8 bytes stay as they are
+
+    auto load_string = [](const string &literal) {
+      istringstream input(literal);
+      return Json::Load(input).GetRoot().AsString();
+    };
+
+    ostringstream printed;
+    Json::PrintValue(value, printed);
+    ASSERT_EQUAL(load_string(printed.str()), value);
+
+    string written;
+    Json::Writer(written).Value(value);
+    ASSERT_EQUAL(written, printed.str());
+    ASSERT_EQUAL(load_string(written), value);
+
+    string svg_written = "\"";
+    Svg::Writer(svg_written, Svg::Writer::Escaping::JSON) << value << '\n' << '"';
+    svg_written += '"';
+    ASSERT_EQUAL(load_string(svg_written), value + "\n\"");
+  }
+
+  void Run(TestRunner &tr) {
+    RUN_TEST(tr, TestParseValues);
+    RUN_TEST(tr, TestParseEscapes);
+    RUN_TEST(tr, TestParseItemByItem);
+    RUN_TEST(tr, TestParseErrors);
+    RUN_TEST(tr, TestWriterMatchesPrint);
+    RUN_TEST(tr, TestEscapedStringsRoundTrip);
+  }
+}  // namespace TestJson
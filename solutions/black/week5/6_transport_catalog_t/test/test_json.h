@@ -0,0 +1,13 @@
+#pragma once
+
+#include "test_runner.h"
+
+namespace TestJson {
+  void TestParseValues();
+  void TestParseEscapes();
+  void TestParseItemByItem();
+  void TestParseErrors();
+  void TestWriterMatchesPrint();
+  void TestEscapedStringsRoundTrip();
+  void Run(TestRunner &tr);
+}  // namespace TestJson
@@ -0,0 +1,62 @@
+#include "test_map_grid.h"
+
+#include <algorithm>
+#include <random>
+#include <stdexcept>
+
+#include "map_grid.h"
+#include "requests.h"
+
+using namespace std;
+
+namespace TestMapGrid {
+  void TestFindMatchesFullScan() {
+    mt19937 generator(42);
+    uniform_real_distribution<double> coord(-50, 1050);  // a bit outside the bounds too
+    const auto random_point = [&] { return Svg::Point{coord(generator), coord(generator)}; };
+
+    vector<vector<MapArea>> items(500);
+    MapGrid grid({{0, 0}, {1000, 1000}}, items.size() * 3);
+    for (MapGrid::ItemId item = 0; item < items.size(); ++item) {
+      for (int box_idx = 0; box_idx < 3; ++box_idx) {
+        const Svg::Point point = random_point();
+        const Svg::Point next_point = {point.x + coord(generator) / 20, point.y - coord(generator) / 20};
+        items[item].push_back(MapArea::Around(point, next_point));
+        grid.Insert(item, items[item].back());
+      }
+    }
+
+    for (int query_idx = 0; query_idx < 200; ++query_idx) {
+      const MapArea area = MapArea::Around(random_point(), random_point());
+      vector<MapGrid::ItemId> expected;
+      for (MapGrid::ItemId item = 0; item < items.size(); ++item) {
+        const auto intersects = [&area](const MapArea &box) { return box.Intersects(area); };
+        if (any_of(begin(items[item]), end(items[item]), intersects)) {
+          expected.push_back(item);
+        }
+      }
+      ASSERT_EQUAL(grid.Find(area), expected);
+    }
+  }
+
+  void TestTileRequestsAreChecked() {
+    auto read_tile = [](int zoom, int x, int y) {
+      const Json::Dict tile = {{"zoom", Json::Node(zoom)}, {"x", Json::Node(x)}, {"y", Json::Node(y)}};
+      const auto request = Requests::Read({{"type", Json::Node("Map"s)}, {"tile", Json::Node(tile)}});
+      return get<MapTile>(get<Requests::Map>(request).part);
+    };
+    const MapTile tile = read_tile(2, 3, 1);
+    ASSERT_EQUAL(tile.zoom, 2u);
+    ASSERT_EQUAL(tile.x, 3u);
+    ASSERT_EQUAL(tile.y, 1u);
+    ASSERT_THROWS(read_tile(2, 4, 0), invalid_argument);
+    ASSERT_THROWS(read_tile(2, 0, -1), invalid_argument);
+    ASSERT_THROWS(read_tile(-1, 0, 0), invalid_argument);
+    ASSERT_THROWS(read_tile(MapTile::MAX_ZOOM + 1, 0, 0), invalid_argument);
+  }
+
+  void Run(TestRunner &tr) {
+    RUN_TEST(tr, TestFindMatchesFullScan);
+    RUN_TEST(tr, TestTileRequestsAreChecked);
+  }
+}  // namespace TestMapGrid
@@ -0,0 +1,9 @@
+#pragma once
+
+#include "test_runner.h"
+
+namespace TestMapGrid {
+  void TestFindMatchesFullScan();
+  void TestTileRequestsAreChecked();
+  void Run(TestRunner &tr);
+}  // namespace TestMapGrid
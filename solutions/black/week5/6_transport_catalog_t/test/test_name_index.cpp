@@ -0,0 +1,153 @@
+#include "test_name_index.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <optional>
+#include <random>
+
+#include "name_index.h"
+
+using namespace std;
+
+namespace TestNameIndex {
+  static vector<string> SplitCodePoints(const string &text) {
+    vector<string> result;
+    for (const char c : text) {
+      if ((static_cast<unsigned char>(c) & 0xC0) == 0x80) {
+        result.back() += c;
+      } else {
+        result.emplace_back(1, c);
+      }
+    }
+    return result;
+  }
+
+  static uint32_t ComputeEditDistance(const string &lhs, const string &rhs) {
+    const auto lhs_chars = SplitCodePoints(lhs);
+    const auto rhs_chars = SplitCodePoints(rhs);
+    vector<vector<uint32_t>> distances(lhs_chars.size() + 1, vector<uint32_t>(rhs_chars.size() + 1));
+    for (size_t i = 0; i <= lhs_chars.size(); ++i) {
+      for (size_t j = 0; j <= rhs_chars.size(); ++j) {
+        if (i == 0 || j == 0) {
+          distances[i][j] = i + j;
+        } else {
+          distances[i][j] = min({distances[i - 1][j] + 1, distances[i][j - 1] + 1,
+                                 distances[i - 1][j - 1] + (lhs_chars[i - 1] == rhs_chars[j - 1] ? 0 : 1)});
+        }
+      }
+    }
+    return distances.back().back();
+  }
+
+  void TestPrefixAndFuzzyMatchFullScan() {
+    mt19937 generator(42);
+    const vector<string> letters = {"a", "b", "c", "а", "б", "я"};  // Latin and Cyrillic
+    const auto random_word = [&] {
+      string word;
+      for (size_t length = generator() % 6; length > 0; --length) {
+        word += letters[generator() % letters.size()];
+      }
+      return word;
+    };
+
+    vector<pair<string, NameIndex::Id>> entries;
+    for (NameIndex::Id id = 0; id < 400; ++id) {
+      entries.emplace_back(random_word(), id);
+      entries.emplace_back(random_word(), id);
+    }
+    const NameIndex built_index(entries);
+
+    const string base_file_name = "test_name_index.base";
+    {
+      TCProto::NameIndex proto;
+      BaseFile::Writer writer;
+      built_index.Serialize(proto, writer);
+      ofstream(base_file_name, ios::binary) << writer.Finish(proto);
+    }
+    const auto reader = BaseFile::Reader::Open(base_file_name);
+    TCProto::NameIndex proto;
+    proto.ParseFromArray(reader->GetMessageData().data(), static_cast<int>(reader->GetMessageData().size()));
+    const NameIndex restored_index = NameIndex::Deserialize(proto, *reader);
+
+    for (int query_idx = 0; query_idx < 200; ++query_idx) {
+      const string query = random_word();
+      const uint32_t max_edits = generator() % 3;
+      vector<NameIndex::Id> expected_by_prefix, expected_fuzzy;
+      for (const auto &[key, id] : entries) {
+        if (key.starts_with(query)) {
+          expected_by_prefix.push_back(id);
+        }
+        if (ComputeEditDistance(key, query) <= max_edits) {
+          expected_fuzzy.push_back(id);
+        }
+      }
+      for (auto *ids : {&expected_by_prefix, &expected_fuzzy}) {
+        sort(begin(*ids), end(*ids));
+        ids->erase(unique(begin(*ids), end(*ids)), end(*ids));
+      }
+
+      for (const NameIndex *index : {&built_index, &restored_index}) {
+        ASSERT_EQUAL(index->FindByPrefix(query), expected_by_prefix);
+        ASSERT_EQUAL(index->FindFuzzy(query, max_edits), expected_fuzzy);
+      }
+    }
+    remove(base_file_name.c_str());
+  }
+
+  // Dropping, renumbering and adding ids gives the same index as building it from the resulting entries
+  void TestEditedMatchesBuilt() {
+    mt19937 generator(7);
+    const vector<string> letters = {"a", "b", "я"};
+    const auto random_word = [&] {
+      string word;
+      for (size_t length = generator() % 4; length > 0; --length) {
+        word += letters[generator() % letters.size()];
+      }
+      return word;
+    };
+
+    vector<pair<string, NameIndex::Id>> previous_entries;
+    for (NameIndex::Id id = 0; id < 200; ++id) {
+      previous_entries.emplace_back(random_word(), id);
+      previous_entries.emplace_back(random_word(), id);
+    }
+    const NameIndex previous_index(previous_entries);
+
+    // Every third id goes away, the rest are packed, and new ids follow them
+    vector<optional<NameIndex::Id>> new_ids(200);
+    NameIndex::Id next_id = 0;
+    for (NameIndex::Id id = 0; id < 200; ++id) {
+      if (id % 3 != 0) {
+        new_ids[id] = next_id++;
+      }
+    }
+    vector<pair<string, NameIndex::Id>> entries, added_entries;
+    for (const auto &[key, id] : previous_entries) {
+      if (new_ids[id]) {
+        entries.emplace_back(key, *new_ids[id]);
+      }
+    }
+    for (NameIndex::Id id = next_id; id < next_id + 50; ++id) {
+      added_entries.emplace_back(random_word(), id);
+      added_entries.emplace_back("bbbb", id);  // a key after all the previous ones
+    }
+    entries.insert(end(entries), begin(added_entries), end(added_entries));
+
+    const NameIndex edited_index(previous_index, new_ids, added_entries);
+    const NameIndex built_index(entries);
+    for (const string &query : {""s, "a"s, "b"s, "я"s, "ab"s, "bbbb"s, "яa"s}) {
+      ASSERT_EQUAL(edited_index.FindByPrefix(query), built_index.FindByPrefix(query));
+    }
+    for (int query_idx = 0; query_idx < 100; ++query_idx) {
+      const string query = random_word();
+      ASSERT_EQUAL(edited_index.FindByPrefix(query), built_index.FindByPrefix(query));
+      ASSERT_EQUAL(edited_index.FindFuzzy(query, 1), built_index.FindFuzzy(query, 1));
+    }
+  }
+
+  void Run(TestRunner &tr) {
+    RUN_TEST(tr, TestPrefixAndFuzzyMatchFullScan);
+    RUN_TEST(tr, TestEditedMatchesBuilt);
+  }
+}  // namespace TestNameIndex
@@ -0,0 +1,9 @@
+#pragma once
+
+#include "test_runner.h"
+
+namespace TestNameIndex {
+  void TestPrefixAndFuzzyMatchFullScan();
+  void TestEditedMatchesBuilt();
+  void Run(TestRunner &tr);
+}  // namespace TestNameIndex
@@ -0,0 +1,36 @@
+#include "test_response_cache.h"
+
+#include <memory>
+#include <string>
+
+#include "response_cache.h"
+
+using namespace std;
+
+namespace TestResponseCache {
+  void TestEvictsLeastRecentlyUsed() {
+    ResponseCache cache(10);  // keys and responses below take 4 bytes each
+    cache.Add("a", make_shared<const string>("aaa"));
+    cache.Add("b", make_shared<const string>("bbb"));
+    ASSERT(cache.Find("a"));  // now "b" is the least recently used
+    cache.Add("c", make_shared<const string>("ccc"));
+    cache.Add("d", make_shared<const string>("too long to keep"));
+
+    ASSERT(!cache.Find("b"));
+    ASSERT(!cache.Find("d"));
+    const auto response = cache.Find("a");
+    ASSERT(response);
+    ASSERT_EQUAL(*response, "aaa");
+    ASSERT_EQUAL(*cache.Find("c"), "ccc");
+
+    const auto stats = cache.GetStats();
+    ASSERT_EQUAL(stats.hits, 3u);
+    ASSERT_EQUAL(stats.misses, 2u);
+    ASSERT_EQUAL(stats.entry_count, 2u);
+    ASSERT_EQUAL(stats.size, 8u);
+  }
+
+  void Run(TestRunner &tr) {
+    RUN_TEST(tr, TestEvictsLeastRecentlyUsed);
+  }
+}  // namespace TestResponseCache
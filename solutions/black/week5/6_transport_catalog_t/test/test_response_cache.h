@@ -0,0 +1,8 @@
+#pragma once
+
+#include "test_runner.h"
+
+namespace TestResponseCache {
+  void TestEvictsLeastRecentlyUsed();
+  void Run(TestRunner &tr);
+}  // namespace TestResponseCache
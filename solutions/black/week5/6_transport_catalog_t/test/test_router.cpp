@@ -0,0 +1,323 @@
+#include "test_router.h"
+
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <random>
+
+#include "contraction_hierarchy_router.h"
+#include "dijkstra_router.h"
+#include "precomputed_router.h"
+#include "transport_router.h"
+
+using namespace std;
+
+namespace TestRouter {
+  using BusGraph = Graph::DirectedWeightedGraph<double>;
+
+  static BusGraph MakeRandomGraph(size_t vertex_count, size_t edge_count, unsigned seed) {
+    mt19937 generator(seed);
+    uniform_int_distribution<Graph::VertexId> vertex_distribution(0, vertex_count - 1);
+    uniform_int_distribution<int> weight_distribution(0, 20);
+    BusGraph graph(vertex_count);
+    for (size_t i = 0; i < edge_count; ++i) {
+      graph.AddEdge({vertex_distribution(generator), vertex_distribution(generator),
+                     static_cast<double>(weight_distribution(generator))});
+    }
+    graph.Finalize();
+    return graph;
+  }
+
+  static double ComputeRouteWeight(const BusGraph& graph, Graph::Router<double>& router, Graph::VertexId from,
+                                   Graph::VertexId to) {
+    const auto route = router.BuildRoute(from, to);
+    double weight = 0;
+    Graph::VertexId vertex = from;
+    for (size_t edge_idx = 0; edge_idx < route->edge_count; ++edge_idx) {
+      const auto& edge = graph.GetEdge(router.GetRouteEdge(route->id, edge_idx));
+      ASSERT_EQUAL(edge.from, vertex);
+      vertex = edge.to;
+      weight += edge.weight;
+    }
+    ASSERT_EQUAL(vertex, to);
+    router.ReleaseRoute(route->id);
+    return weight;
+  }
+
+  void TestFinalizedGraphKeepsEdges() {
+    mt19937 generator(11);
+    uniform_int_distribution<Graph::VertexId> vertex_distribution(0, 29);
+    vector<Graph::Edge<double>> added_edges;
+    BusGraph built_graph(30);
+    for (int edge_idx = 0; edge_idx < 200; ++edge_idx) {
+      added_edges.push_back({vertex_distribution(generator), vertex_distribution(generator), edge_idx * 0.5});
+      built_graph.AddEdge(added_edges.back());
+    }
+    const vector<Graph::EdgeId> edge_ids = built_graph.Finalize();
+    ASSERT_EQUAL(edge_ids.size(), added_edges.size());
+
+    const string base_file_name = "test_router_graph.base";
+    {
+      GraphProto::DirectedWeightedGraph proto;
+      BaseFile::Writer writer;
+      built_graph.Serialize(proto, writer);
+      ofstream(base_file_name, ios::binary) << writer.Finish(proto);
+    }
+    const auto reader = BaseFile::Reader::Open(base_file_name);
+    GraphProto::DirectedWeightedGraph proto;
+    proto.ParseFromArray(reader->GetMessageData().data(), static_cast<int>(reader->GetMessageData().size()));
+    const BusGraph restored_graph = BusGraph::Deserialize(proto, *reader);
+
+    for (const BusGraph *graph : {static_cast<const BusGraph *>(&built_graph), &restored_graph}) {
+      ASSERT_EQUAL(graph->GetVertexCount(), 30u);
+      ASSERT_EQUAL(graph->GetEdgeCount(), added_edges.size());
+      for (size_t edge_idx = 0; edge_idx < added_edges.size(); ++edge_idx) {
+        const auto edge = graph->GetEdge(edge_ids[edge_idx]);
+        ASSERT_EQUAL(edge.from, added_edges[edge_idx].from);
+        ASSERT_EQUAL(edge.to, added_edges[edge_idx].to);
+        ASSERT_COMPARE(edge.weight, added_edges[edge_idx].weight, 1e-9);
+      }
+      // Incident edges come in the order they were added
+      for (Graph::VertexId vertex = 0; vertex < graph->GetVertexCount(); ++vertex) {
+        vector<Graph::EdgeId> expected;
+        for (size_t edge_idx = 0; edge_idx < added_edges.size(); ++edge_idx) {
+          if (added_edges[edge_idx].from == vertex) {
+            expected.push_back(edge_ids[edge_idx]);
+          }
+        }
+        vector<Graph::EdgeId> incident_edges;
+        for (const Graph::EdgeId edge_id : graph->GetIncidentEdges(vertex)) {
+          incident_edges.push_back(edge_id);
+        }
+        ASSERT_EQUAL(incident_edges, expected);
+      }
+    }
+    remove(base_file_name.c_str());
+  }
+
+  void TestParallelPrecomputedMatchesSequential() {
+    const BusGraph graph = MakeRandomGraph(45, 140, 23);
+    Graph::PrecomputedRouter<double> sequential(graph);
+    for (size_t thread_count : {2, 4, 7, 100}) {
+      Graph::PrecomputedRouter<double> parallel(graph, thread_count);
+      for (Graph::VertexId from = 0; from < graph.GetVertexCount(); ++from) {
+        for (Graph::VertexId to = 0; to < graph.GetVertexCount(); ++to) {
+          const auto expected = sequential.GetWeight(from, to);
+          ASSERT_EQUAL(parallel.GetWeight(from, to).has_value(), expected.has_value());
+          if (expected) {
+            ASSERT_COMPARE(*parallel.GetWeight(from, to), *expected, 1e-9);
+            ASSERT_COMPARE(ComputeRouteWeight(graph, parallel, from, to), *expected, 1e-9);
+          }
+        }
+      }
+    }
+  }
+
+  void TestOnDemandMatchesPrecomputed() {
+    const BusGraph graph = MakeRandomGraph(40, 120, 17);
+    Graph::PrecomputedRouter<double> precomputed(graph);
+    Graph::DijkstraRouter<double> on_demand(graph);
+
+    for (Graph::VertexId from = 0; from < graph.GetVertexCount(); ++from) {
+      for (Graph::VertexId to = 0; to < graph.GetVertexCount(); ++to) {
+        const auto expected = precomputed.GetWeight(from, to);
+        ASSERT_EQUAL(on_demand.GetWeight(from, to).has_value(), expected.has_value());
+        if (expected) {
+          ASSERT_COMPARE(*on_demand.GetWeight(from, to), *expected, 1e-9);
+          ASSERT_COMPARE(ComputeRouteWeight(graph, on_demand, from, to), *expected, 1e-9);
+        }
+      }
+    }
+  }
+
+  void TestContractionHierarchyMatchesPrecomputed() {
+    for (unsigned seed : {3, 17, 29}) {
+      const BusGraph graph = MakeRandomGraph(60, 200, seed);
+      Graph::PrecomputedRouter<double> precomputed(graph);
+      Graph::ContractionHierarchyRouter<double> hierarchy(graph);
+
+      const string base_file_name = "test_router_hierarchy.base";
+      {
+        GraphProto::Router proto;
+        BaseFile::Writer writer;
+        hierarchy.Serialize(proto, writer);
+        ofstream(base_file_name, ios::binary) << writer.Finish(proto);
+      }
+      const auto reader = BaseFile::Reader::Open(base_file_name);
+      GraphProto::Router proto;
+      proto.ParseFromArray(reader->GetMessageData().data(), static_cast<int>(reader->GetMessageData().size()));
+      const auto restored_hierarchy = Graph::ContractionHierarchyRouter<double>::Deserialize(proto, graph, *reader);
+      ASSERT_EQUAL(restored_hierarchy->GetShortcutCount(), hierarchy.GetShortcutCount());
+
+      for (Graph::VertexId from = 0; from < graph.GetVertexCount(); ++from) {
+        for (Graph::VertexId to = 0; to < graph.GetVertexCount(); ++to) {
+          const auto expected = precomputed.GetWeight(from, to);
+          ASSERT_EQUAL(restored_hierarchy->GetWeight(from, to).has_value(), expected.has_value());
+          if (expected) {
+            ASSERT_COMPARE(*restored_hierarchy->GetWeight(from, to), *expected, 1e-9);
+            ASSERT_COMPARE(ComputeRouteWeight(graph, *restored_hierarchy, from, to), *expected, 1e-9);
+          }
+        }
+      }
+      remove(base_file_name.c_str());
+    }
+  }
+
+  void TestBestTargetMatchesPerTargetQueries() {
+    const BusGraph graph = MakeRandomGraph(50, 150, 11);
+    Graph::PrecomputedRouter<double> precomputed(graph);
+    Graph::DijkstraRouter<double> on_demand(graph);
+    Graph::ContractionHierarchyRouter<double> hierarchy(graph);
+
+    mt19937 generator(5);
+    uniform_int_distribution<Graph::VertexId> vertex_distribution(0, graph.GetVertexCount() - 1);
+    uniform_int_distribution<int> extra_cost_distribution(0, 30);
+    for (Graph::VertexId from = 0; from < graph.GetVertexCount(); ++from) {
+      vector<Graph::VertexId> targets(8);
+      vector<double> extra_costs(targets.size());
+      for (size_t target_idx = 0; target_idx < targets.size(); ++target_idx) {
+        targets[target_idx] = vertex_distribution(generator);
+        extra_costs[target_idx] = extra_cost_distribution(generator);
+      }
+      auto target_cost = [&extra_costs](size_t target_idx, double route_weight) {
+        return route_weight + extra_costs[target_idx];
+      };
+
+      const auto expected = precomputed.BuildRouteToBestTarget(from, targets, target_cost);
+      for (Graph::Router<double> *router : {static_cast<Graph::Router<double> *>(&on_demand),
+                                            static_cast<Graph::Router<double> *>(&hierarchy)}) {
+        const auto actual = router->BuildRouteToBestTarget(from, targets, target_cost);
+        ASSERT_EQUAL(actual.has_value(), expected.has_value());
+        if (!expected) {
+          continue;
+        }
+        ASSERT_EQUAL(actual->target_idx, expected->target_idx);
+        ASSERT_COMPARE(actual->cost, expected->cost, 1e-9);
+        ASSERT_COMPARE(actual->route.weight, expected->route.weight, 1e-9);
+        router->ReleaseRoute(actual->route.id);
+      }
+      if (expected) {
+        precomputed.ReleaseRoute(expected->route.id);
+      }
+    }
+  }
+
+  void TestBusChainsMatchAllPairs() {
+    const vector<string> stop_names = {"A", "B", "C", "D", "E", "F"};
+    vector<Descriptions::Stop> stops;
+    for (const auto& name : stop_names) {
+      stops.push_back({.name = name, .position = {}, .distances = {}});
+    }
+    // Distinct distances so that no two routes tie and both models must pick the same one
+    mt19937 generator(7);
+    uniform_int_distribution<size_t> distance_distribution(100, 5000);
+    for (auto& stop : stops) {
+      for (const auto& name : stop_names) {
+        stop.distances.emplace_back(name, distance_distribution(generator));
+      }
+    }
+    const vector<Descriptions::Bus> buses = {
+        {.name = "circle", .stops = {"A", "B", "C", "D", "E", "F", "A"}, .endpoints = {"A"}},
+        {.name = "line", .stops = {"F", "C", "A", "C", "F"}, .endpoints = {"F", "A"}},
+        {.name = "short", .stops = {"D", "B", "D"}, .endpoints = {"D", "B"}},
+    };
+
+    Descriptions::StopsDict stops_dict;
+    for (const auto& stop : stops) {
+      stops_dict[stop.name] = &stop;
+    }
+    Descriptions::BusesDict buses_dict;
+    vector<string> bus_names;
+    for (const auto& bus : buses) {
+      buses_dict[bus.name] = &bus;
+      bus_names.push_back(bus.name);
+    }
+    const auto names = make_shared<CatalogNames>(CatalogNames{Interner(stop_names), Interner(move(bus_names))});
+    const StopDistances distances(stops_dict, names->stops);
+
+    auto make_router = [&](const string& graph_model) {
+      const Json::Dict settings = {
+          {"bus_wait_time", 3},
+          {"bus_velocity", 30.0},
+          {"pedestrian_velocity", 4.0},
+          {"graph_model", graph_model},
+      };
+      return TransportRouter(buses_dict, names, distances, settings);
+    };
+    const TransportRouter all_pairs = make_router("all_pairs");
+    const TransportRouter bus_chains = make_router("bus_chains");
+
+    using RouteInfo = TransportRouter::RouteInfo;
+    for (StopId from = 0; from < stop_names.size(); ++from) {
+      for (StopId to = 0; to < stop_names.size(); ++to) {
+        const auto expected = all_pairs.FindRoute(from, to);
+        const auto actual = bus_chains.FindRoute(from, to);
+        ASSERT_EQUAL(actual.has_value(), expected.has_value());
+        if (!expected) {
+          continue;
+        }
+        ASSERT_COMPARE(actual->total_time, expected->total_time, 1e-9);
+        ASSERT_EQUAL(actual->items.size(), expected->items.size());
+        for (size_t item_idx = 0; item_idx < expected->items.size(); ++item_idx) {
+          const auto& expected_item = expected->items[item_idx];
+          const auto& actual_item = actual->items[item_idx];
+          ASSERT_EQUAL(actual_item.index(), expected_item.index());
+          if (holds_alternative<RouteInfo::RideBusItem>(expected_item)) {
+            const auto& expected_ride = get<RouteInfo::RideBusItem>(expected_item);
+            const auto& actual_ride = get<RouteInfo::RideBusItem>(actual_item);
+            ASSERT_EQUAL(actual_ride.bus_id, expected_ride.bus_id);
+            ASSERT_EQUAL(actual_ride.start_stop_idx, expected_ride.start_stop_idx);
+            ASSERT_EQUAL(actual_ride.finish_stop_idx, expected_ride.finish_stop_idx);
+            ASSERT_EQUAL(actual_ride.span_count, expected_ride.span_count);
+            ASSERT_COMPARE(actual_ride.time, expected_ride.time, 1e-9);
+          } else if (holds_alternative<RouteInfo::WaitBusItem>(expected_item)) {
+            ASSERT_EQUAL(get<RouteInfo::WaitBusItem>(actual_item).stop_id,
+                         get<RouteInfo::WaitBusItem>(expected_item).stop_id);
+          }
+        }
+      }
+    }
+  }
+
+  // Weights changed both ways give the same routes as the tables built anew
+  void TestRepairedPrecomputedMatchesBuilt() {
+    const BusGraph graph = MakeRandomGraph(40, 130, 31);
+    const Graph::PrecomputedRouter<double> previous(graph);
+    mt19937 generator(5);
+    for (size_t thread_count : {1, 3}) {
+      BusGraph changed_graph(graph.GetVertexCount());
+      for (Graph::EdgeId edge_id = 0; edge_id < graph.GetEdgeCount(); ++edge_id) {
+        auto edge = graph.GetEdge(edge_id);
+        if (generator() % 8 == 0) {
+          edge.weight = static_cast<double>(generator() % 21);
+        }
+        changed_graph.AddEdge(edge);  // edges go by their sources already, so they keep the ids
+      }
+      changed_graph.Finalize();
+      ASSERT(changed_graph.HasSameEdges(graph));
+
+      Graph::PrecomputedRouter<double> repaired(changed_graph, previous, thread_count);
+      const Graph::PrecomputedRouter<double> built(changed_graph);
+      for (Graph::VertexId from = 0; from < graph.GetVertexCount(); ++from) {
+        for (Graph::VertexId to = 0; to < graph.GetVertexCount(); ++to) {
+          const auto expected = built.GetWeight(from, to);
+          ASSERT_EQUAL(repaired.GetWeight(from, to).has_value(), expected.has_value());
+          if (expected) {
+            ASSERT_COMPARE(*repaired.GetWeight(from, to), *expected, 1e-9);
+            ASSERT_COMPARE(ComputeRouteWeight(changed_graph, repaired, from, to), *expected, 1e-9);
+          }
+        }
+      }
+    }
+  }
+
+  void Run(TestRunner &tr) {
+    RUN_TEST(tr, TestFinalizedGraphKeepsEdges);
+    RUN_TEST(tr, TestParallelPrecomputedMatchesSequential);
+    RUN_TEST(tr, TestOnDemandMatchesPrecomputed);
+    RUN_TEST(tr, TestContractionHierarchyMatchesPrecomputed);
+    RUN_TEST(tr, TestBestTargetMatchesPerTargetQueries);
+    RUN_TEST(tr, TestBusChainsMatchAllPairs);
+    RUN_TEST(tr, TestRepairedPrecomputedMatchesBuilt);
+  }
+}  // namespace TestRouter
@@ -0,0 +1,14 @@
+#pragma once
+
+#include "test_runner.h"
+
+namespace TestRouter {
+  void TestFinalizedGraphKeepsEdges();
+  void TestParallelPrecomputedMatchesSequential();
+  void TestOnDemandMatchesPrecomputed();
+  void TestContractionHierarchyMatchesPrecomputed();
+  void TestBestTargetMatchesPerTargetQueries();
+  void TestBusChainsMatchAllPairs();
+  void TestRepairedPrecomputedMatchesBuilt();
+  void Run(TestRunner &tr);
+}  // namespace TestRouter
@@ -0,0 +1,40 @@
+#include "test_stop_distances.h"
+
+#include <stdexcept>
+
+#include "stop_distances.h"
+
+using namespace std;
+
+namespace TestStopDistances {
+  void TestOppositeDirectionFallback() {
+    const vector<Descriptions::Stop> stops = {
+        {.name = "C", .position = {}, .distances = {{"A", 300}, {"B", 200}, {"Unknown", 1}}},
+        {.name = "A", .position = {}, .distances = {{"B", 100}}},
+        {.name = "B", .position = {}, .distances = {{"A", 150}, {"B", 50}}},
+    };
+    Descriptions::StopsDict stops_dict;
+    for (const auto &stop : stops) {
+      stops_dict[stop.name] = &stop;
+    }
+    const Interner stop_names({"A", "B", "C"});
+    const StopDistances distances(stops_dict, stop_names);
+
+    ASSERT_EQUAL(distances.Get(0, 1), 100u);  // A -> B as given
+    ASSERT_EQUAL(distances.Get(1, 0), 150u);  // B -> A as given
+    ASSERT_EQUAL(distances.Get(1, 1), 50u);
+    ASSERT_EQUAL(distances.Get(0, 2), 300u);  // A -> C taken from C -> A
+    ASSERT_EQUAL(distances.Get(1, 2), 200u);
+    ASSERT_EQUAL(distances.GetSegments({0, 1, 2, 0}), vector<uint32_t>({100, 200, 300}));
+
+    bool thrown = false;
+    try {
+      distances.Get(0, 0);
+    } catch (const out_of_range &) {
+      thrown = true;
+    }
+    ASSERT(thrown);
+  }
+
+  void Run(TestRunner &tr) { RUN_TEST(tr, TestOppositeDirectionFallback); }
+}  // namespace TestStopDistances
@@ -0,0 +1,8 @@
+#pragma once
+
+#include "test_runner.h"
+
+namespace TestStopDistances {
+  void TestOppositeDirectionFallback();
+  void Run(TestRunner &tr);
+}  // namespace TestStopDistances
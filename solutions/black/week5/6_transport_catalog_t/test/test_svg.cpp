@@ -20,5 +20,57 @@ namespace TestSvg {
     ASSERT_EQUAL(ss.str(), expected);
   }
 
-  void Run(TestRunner &tr) { RUN_TEST(tr, TestRect); }
+  void TestWriterEscapesForJson() {
+    Svg::Text text;
+    text.SetPoint(Svg::Point{0.1234567, -2})
+        .SetFontSize(12)
+        .SetFillColor(Svg::Rgba{{1, 2, 3}, 0.5})
+        .SetData("\"A\\B\"");
+    string buffer;
+    Svg::Writer writer(buffer, Svg::Writer::Escaping::JSON);
+    text.Render(writer);
+    string expected =
+        "<text x=\\\"0.123457\\\" y=\\\"-2\\\" dx=\\\"0\\\" dy=\\\"0\\\" font-size=\\\"12\\\" "
+        "fill=\\\"rgba(1,2,3,0.5)\\\" stroke=\\\"none\\\" stroke-width=\\\"1\\\" >\\\"A\\\\B\\\"</text>";
+    ASSERT_EQUAL(buffer, expected);
+  }
+
+  void TestDocumentKeepsObjectsOrder() {
+    const auto line =
+        Svg::Polyline{}.AddPoint({0, 0}).AddPoint({1.5, 2}).SetStrokeColor("red").SetStrokeLineCap("round");
+    const auto point = Svg::Circle{}.SetCenter({1.5, 2}).SetRadius(3).SetFillColor("white");
+    const auto label = Svg::Text{}.SetPoint({1.5, 2}).SetFontFamily("Verdana").SetData("A");
+    Svg::Document document;
+    for (int i = 0; i < 2; ++i) {
+      document.Add(line);
+      document.Add(point);
+      document.Add(label);
+    }
+    const Svg::Document document_copy = document;
+
+    stringstream expected, rendered, rendered_copy;
+    expected << Svg::DOCUMENT_HEADER;
+    for (int i = 0; i < 2; ++i) {
+      line.Render(expected);
+      point.Render(expected);
+      label.Render(expected);
+    }
+    expected << Svg::DOCUMENT_FOOTER;
+    document.Render(rendered);
+    document_copy.Render(rendered_copy);
+    ASSERT_EQUAL(rendered.str(), expected.str());
+    ASSERT_EQUAL(rendered_copy.str(), expected.str());
+
+    stringstream polyline;
+    line.Render(polyline);
+    ASSERT_EQUAL(polyline.str(),
+                 "<polyline points=\"0,0 1.5,2 \" fill=\"none\" stroke=\"red\" stroke-width=\"1\" "
+                 "stroke-linecap=\"round\" />");
+  }
+
+  void Run(TestRunner &tr) {
+    RUN_TEST(tr, TestRect);
+    RUN_TEST(tr, TestWriterEscapesForJson);
+    RUN_TEST(tr, TestDocumentKeepsObjectsOrder);
+  }
 }  // namespace TestSvg
\ No newline at end of file
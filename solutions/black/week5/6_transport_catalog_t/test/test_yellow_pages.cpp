@@ -0,0 +1,116 @@
+#include "test_yellow_pages.h"
+
+#include <algorithm>
+#include <random>
+#include <stdexcept>
+
+#include "yellow_pages_catalog.h"
+
+using namespace std;
+
+namespace TestYellowPages {
+  static bool Matches(const YellowPages::Phone &phone, const YellowPages::Phone &phone_template) {
+    return (phone_template.extension().empty() || phone_template.extension() == phone.extension()) &&
+           (phone_template.type() == YellowPages::Phone_Type_UNKNOWN || phone_template.type() == phone.type()) &&
+           (phone_template.country_code().empty() || phone_template.country_code() == phone.country_code()) &&
+           ((phone_template.local_code().empty() && phone_template.country_code().empty()) ||
+            phone_template.local_code() == phone.local_code()) &&
+           phone_template.number() == phone.number();
+  }
+
+  static bool Matches(const YellowPages::Company &company, const CompaniesFilter &filter,
+                      const vector<uint64_t> &rubric_ids) {
+    const auto any = [](const auto &items, const auto &other_items, auto match) {
+      const auto match_any = [&](const auto &item) {
+        return any_of(begin(other_items), end(other_items), [&](const auto &other) { return match(item, other); });
+      };
+      return other_items.empty() || any_of(begin(items), end(items), match_any);
+    };
+    const auto same_value = [](const auto &item, const string &other) { return item.value() == other; };
+    const auto same_phone = [](const auto &phone, const auto &other) { return Matches(phone, other); };
+    return any(company.names(), filter.names, same_value) &&
+           any(company.rubrics(), rubric_ids, [](uint64_t rubric, uint64_t other) { return rubric == other; }) &&
+           any(company.urls(), filter.urls, same_value) &&
+           any(company.phones(), filter.phones, same_phone);
+  }
+
+  void TestIndexesMatchFullScan() {
+    mt19937 generator(42);
+    const auto random_word = [&generator](const string &prefix) {
+      return prefix + to_string(uniform_int_distribution<int>(0, 9)(generator));
+    };
+    const auto random_phone = [&] {
+      YellowPages::Phone phone;
+      phone.set_number(random_word("555-"));
+      if (generator() % 2) {
+        phone.set_local_code(random_word("49"));
+      }
+      if (generator() % 3 == 0) {
+        phone.set_type(generator() % 2 ? YellowPages::Phone_Type_PHONE : YellowPages::Phone_Type_FAX);
+      }
+      return phone;
+    };
+
+    YellowPages::Database database;
+    for (uint64_t rubric_id = 1; rubric_id <= 5; ++rubric_id) {
+      (*database.mutable_rubrics())[rubric_id].set_name("rubric" + to_string(rubric_id));
+    }
+    for (int company_idx = 0; company_idx < 300; ++company_idx) {
+      auto &company = *database.add_companies();
+      for (int i = 0; i < 1 + company_idx % 3; ++i) {
+        company.add_names()->set_value(random_word("name"));
+        company.add_urls()->set_value(random_word("url"));
+        company.add_rubrics(1 + generator() % 5);
+        *company.add_phones() = random_phone();
+      }
+    }
+    const YellowPages::Database database_copy = database;
+    const YellowPagesCatalog catalog(database);
+
+    for (int query_idx = 0; query_idx < 300; ++query_idx) {
+      CompaniesFilter filter;
+      vector<uint64_t> rubric_ids;
+      for (int i = 0; i < 2; ++i) {
+        if (generator() % 2) {
+          filter.names.push_back(random_word("name"));
+        }
+        if (generator() % 3 == 0) {
+          rubric_ids.push_back(1 + generator() % 5);
+          filter.rubrics.push_back("rubric" + to_string(rubric_ids.back()));
+        }
+        if (generator() % 3 == 0) {
+          filter.urls.push_back(random_word("url"));
+        }
+        if (generator() % 3 == 0) {
+          filter.phones.push_back(random_phone());
+        }
+      }
+
+      vector<string> expected;
+      for (const auto &company : database_copy.companies()) {
+        if (Matches(company, filter, rubric_ids)) {
+          expected.push_back(company.names(0).value());
+        }
+      }
+      vector<string> found;
+      for (const auto *company : catalog.FindCompanies(filter)) {
+        found.push_back(company->names(0).value());
+      }
+      ASSERT_EQUAL(found, expected);
+    }
+  }
+
+  void TestFilterLimitsMaxEdits() {
+    auto make_filter = [](int max_edits) {
+      return CompaniesFilter(Json::Dict{{"match", Json::Node("fuzzy"s)}, {"max_edits", Json::Node(max_edits)}});
+    };
+    ASSERT_EQUAL(make_filter(2).max_edits, 2u);
+    ASSERT_EQUAL(make_filter(1000).max_edits, CompaniesFilter::MAX_EDITS);
+    ASSERT_THROWS(make_filter(-1), invalid_argument);
+  }
+
+  void Run(TestRunner &tr) {
+    RUN_TEST(tr, TestIndexesMatchFullScan);
+    RUN_TEST(tr, TestFilterLimitsMaxEdits);
+  }
+}  // namespace TestYellowPages
@@ -0,0 +1,9 @@
+#pragma once
+
+#include "test_runner.h"
+
+namespace TestYellowPages {
+  void TestIndexesMatchFullScan();
+  void TestFilterLimitsMaxEdits();
+  void Run(TestRunner &tr);
+}  // namespace TestYellowPages